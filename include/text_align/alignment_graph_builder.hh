@@ -6,12 +6,16 @@
 #ifndef TEXT_ALIGN_ALIGNMENT_GRAPH_BUILDER_HH
 #define TEXT_ALIGN_ALIGNMENT_GRAPH_BUILDER_HH
 
+#include <climits>
 #include <cstdint>
+#include <iterator>
 #include <libbio/algorithm.hh>
 #include <libbio/assert.hh>
 #include <libbio/int_vector.hh>
-#include <range/v3/view/zip.hpp>
+#include <memory>
+#include <text_align/gap_runs.hh>
 #include <text_align/json_serialize.hh>
+#include <type_traits>
 #include <vector>
 
 
@@ -21,7 +25,8 @@ namespace text_align { namespace alignment_graph {
 	{
 		NONE = 0,
 		COMMON = 1,
-		DISTINCT = 2
+		DISTINCT = 2,
+		MULTIPLE_DISTINCT = 3
 	};
 	
 	
@@ -51,6 +56,9 @@ namespace text_align { namespace alignment_graph {
 		// hence the values need to be static_casted manually.
 		virtual void visit_common_node(node_base &node) = 0;
 		virtual void visit_distinct_node(node_base &node) = 0;
+		
+		// Only needed for graphs built from multiple alignments.
+		virtual void visit_multiple_distinct_node(node_base &node) {}
 	};
 	
 	
@@ -59,6 +67,7 @@ namespace text_align { namespace alignment_graph {
 		virtual ~node_base() {}
 		virtual enum node_type type() const { return node_type::NONE; }
 		virtual void to_json(std::ostream &stream) const override {}
+		virtual void to_json(json::writer &writer) const override {}
 		virtual void visit(node_visitor &visitor) {}
 	};
 	
@@ -77,8 +86,10 @@ namespace text_align { namespace alignment_graph {
 		static constexpr enum node_type node_type() { return node_type::COMMON; }
 		virtual enum node_type type() const override { return this->node_type(); }
 		void add_character(character_type const c) { m_text.push_back(c); }
+		template <typename t_iterator> void add_characters(t_iterator first, t_iterator last) { m_text.insert(m_text.end(), first, last); }
 		vector_type const &characters() const { return m_text; }
 		virtual void to_json(std::ostream &stream) const override;
+		virtual void to_json(json::writer &writer) const override;
 		virtual void visit(node_visitor &visitor) override { visitor.visit_common_node(*this); }
 	};
 	
@@ -99,14 +110,30 @@ namespace text_align { namespace alignment_graph {
 		virtual enum node_type type() const override { return this->node_type(); }
 		void add_character_lhs(character_type const c) { m_lhs.push_back(c); }
 		void add_character_rhs(character_type const c) { m_rhs.push_back(c); }
+		template <typename t_iterator> void add_characters_lhs(t_iterator first, t_iterator last) { m_lhs.insert(m_lhs.end(), first, last); }
+		template <typename t_iterator> void add_characters_rhs(t_iterator first, t_iterator last) { m_rhs.insert(m_rhs.end(), first, last); }
 		vector_type const &characters_lhs() const { return m_lhs; }
 		vector_type const &characters_rhs() const { return m_rhs; }
 		virtual void to_json(std::ostream &stream) const override;
+		virtual void to_json(json::writer &writer) const override;
 		virtual void visit(node_visitor &visitor) override { visitor.visit_distinct_node(*this); }
 	};
 }}
 
 
+namespace text_align { namespace detail {
+	
+	template <typename t_iterator, typename = void>
+	struct is_random_access_iterator : public std::false_type {};
+	
+	template <typename t_iterator>
+	struct is_random_access_iterator <
+		t_iterator,
+		std::enable_if_t <std::is_base_of_v <std::random_access_iterator_tag, typename std::iterator_traits <t_iterator>::iterator_category>>
+	> : public std::true_type {};
+}}
+
+
 namespace text_align {
 	
 	class alignment_graph_builder_base
@@ -121,8 +148,6 @@ namespace text_align {
 			
 	protected:
 		void end_current_segment() { if (m_current_segment) m_text_segments.emplace_back(std::move(m_current_segment)); }
-		bool check_current_segment(enum alignment_graph::node_type const nt);
-		void finalize_graph() { end_current_segment(); }
 		
 	public:
 		node_ptr_vector const &text_segments() const { return m_text_segments; }
@@ -135,10 +160,24 @@ namespace text_align {
 	public:
 		typedef t_character										character_type;
 		typedef alignment_graph::node_traits <character_type>	traits_type;
+		typedef alignment_graph::common_node <character_type>	common_node_type;
+		typedef alignment_graph::distinct_node <character_type>	distinct_node_type;
 		
 	protected:
-		void append_to_common_segment(character_type const c);
-		void append_to_distinct_segment(character_type const lhs, character_type const rhs);
+		// Typed pointers to m_current_segment, at most one of which is non-null.
+		common_node_type										*m_current_common{};
+		distinct_node_type										*m_current_distinct{};
+		
+	protected:
+		inline common_node_type &common_segment();
+		inline distinct_node_type &distinct_segment();
+		inline void end_segment();
+		
+		template <typename t_lhs_it, typename t_lhs_end, typename t_rhs_it, typename t_rhs_end>
+		void handle_aligned_run(t_lhs_it &lhs_it, t_lhs_end const &lhs_end, t_rhs_it &rhs_it, t_rhs_end const &rhs_end, std::size_t const length);
+		
+		template <typename t_iterator, typename t_end>
+		void handle_gap_run(t_iterator &it, t_end const &end, std::size_t const length, bool const is_lhs);
 		
 	public:
 		template <typename t_lhs, typename t_rhs>
@@ -163,6 +202,15 @@ namespace text_align { namespace alignment_graph {
 	}
 	
 	
+	template <typename t_character>
+	void common_node <t_character>::to_json(json::writer &writer) const
+	{
+		writer.write_key_value("type", "common");
+		writer.write(", ");
+		writer.write_key_value("text", m_text);
+	}
+	
+	
 	template <typename t_character>
 	void distinct_node <t_character>::to_json(std::ostream &stream) const
 	{
@@ -172,37 +220,169 @@ namespace text_align { namespace alignment_graph {
 		stream << ", ";
 		json::write(stream, "rhs", m_rhs);
 	}
+	
+	
+	template <typename t_character>
+	void distinct_node <t_character>::to_json(json::writer &writer) const
+	{
+		writer.write_key_value("type", "distinct");
+		writer.write(", ");
+		writer.write_key_value("lhs", m_lhs);
+		writer.write(", ");
+		writer.write_key_value("rhs", m_rhs);
+	}
 }}
 
 
 namespace text_align {
 
 	template <typename t_character>
-	void alignment_graph_builder <t_character>::append_to_common_segment(character_type const cc)
+	auto alignment_graph_builder <t_character>::common_segment() -> common_node_type &
+	{
+		if (!m_current_common)
+		{
+			end_segment();
+			m_current_common = new common_node_type();
+			m_current_segment.reset(m_current_common);
+		}
+		return *m_current_common;
+	}
+	
+	
+	template <typename t_character>
+	auto alignment_graph_builder <t_character>::distinct_segment() -> distinct_node_type &
 	{
-		typedef alignment_graph::common_node <t_character> node_type;
-		if (check_current_segment(node_type::node_type()))
-			m_current_segment.reset(new node_type());
-		static_cast <node_type &>(*this->m_current_segment).add_character(cc);
+		if (!m_current_distinct)
+		{
+			end_segment();
+			m_current_distinct = new distinct_node_type();
+			m_current_segment.reset(m_current_distinct);
+		}
+		return *m_current_distinct;
 	}
 	
 	
 	template <typename t_character>
-	void alignment_graph_builder <t_character>::append_to_distinct_segment(
-		character_type const lhs,
-		character_type const rhs
+	void alignment_graph_builder <t_character>::end_segment()
+	{
+		end_current_segment();
+		m_current_common = nullptr;
+		m_current_distinct = nullptr;
+	}
+	
+	
+	// Handle a run of aligned characters, i.e. one without gaps.
+	template <typename t_character>
+	template <typename t_lhs_it, typename t_lhs_end, typename t_rhs_it, typename t_rhs_end>
+	void alignment_graph_builder <t_character>::handle_aligned_run(
+		t_lhs_it &lhs_it,
+		t_lhs_end const &lhs_end,
+		t_rhs_it &rhs_it,
+		t_rhs_end const &rhs_end,
+		std::size_t const length
 	)
 	{
-		typedef alignment_graph::distinct_node <t_character> node_type;
-		if (check_current_segment(node_type::node_type()))
-			m_current_segment.reset(new node_type());
-		auto &node(static_cast <node_type &>(*this->m_current_segment));
-		
-		if (traits_type::gap_character() != lhs)
-			node.add_character_lhs(lhs);
+		if constexpr (detail::is_random_access_iterator <t_lhs_it>::value && detail::is_random_access_iterator <t_rhs_it>::value)
+		{
+			libbio_always_assert(length <= std::size_t(lhs_end - lhs_it));
+			libbio_always_assert(length <= std::size_t(rhs_end - rhs_it));
+			
+			// Compare and copy spans of characters.
+			auto const lhs_limit(lhs_it + length);
+			while (lhs_it != lhs_limit)
+			{
+				auto const pair(std::mismatch(lhs_it, lhs_limit, rhs_it, [](auto const lhsc, auto const rhsc){
+					return libbio::is_equal(lhsc, rhsc);
+				}));
+				
+				if (lhs_it != pair.first)
+				{
+					common_segment().add_characters(lhs_it, pair.first);
+					lhs_it = pair.first;
+					rhs_it = pair.second;
+				}
+				
+				// Find the end of the distinct span.
+				auto distinct_lhs_end(lhs_it);
+				auto distinct_rhs_end(rhs_it);
+				while (distinct_lhs_end != lhs_limit && !libbio::is_equal(*distinct_lhs_end, *distinct_rhs_end))
+				{
+					++distinct_lhs_end;
+					++distinct_rhs_end;
+				}
+				
+				if (lhs_it != distinct_lhs_end)
+				{
+					auto &node(distinct_segment());
+					node.add_characters_lhs(lhs_it, distinct_lhs_end);
+					node.add_characters_rhs(rhs_it, distinct_rhs_end);
+					lhs_it = distinct_lhs_end;
+					rhs_it = distinct_rhs_end;
+				}
+			}
+		}
+		else
+		{
+			for (std::size_t i(0); i < length; ++i)
+			{
+				libbio_always_assert(lhs_it != lhs_end);
+				libbio_always_assert(rhs_it != rhs_end);
+				
+				auto const lhsc(*lhs_it);
+				auto const rhsc(*rhs_it);
+				++lhs_it;
+				++rhs_it;
+				
+				if (libbio::is_equal(lhsc, rhsc))
+					common_segment().add_character(lhsc);
+				else
+				{
+					auto &node(distinct_segment());
+					node.add_character_lhs(lhsc);
+					node.add_character_rhs(rhsc);
+				}
+			}
+		}
+	}
+	
+	
+	// Handle a run of characters in one text aligned to gaps in the other.
+	template <typename t_character>
+	template <typename t_iterator, typename t_end>
+	void alignment_graph_builder <t_character>::handle_gap_run(
+		t_iterator &it,
+		t_end const &end,
+		std::size_t const length,
+		bool const is_lhs
+	)
+	{
+		auto &node(distinct_segment());
+		if constexpr (detail::is_random_access_iterator <t_iterator>::value)
+		{
+			libbio_always_assert(length <= std::size_t(end - it));
+			auto const limit(it + length);
+			if (is_lhs)
+				node.add_characters_lhs(it, limit);
+			else
+				node.add_characters_rhs(it, limit);
+			it = limit;
+		}
+		else
+		{
+			for (std::size_t i(0); i < length; ++i)
+			{
+				libbio_always_assert(it != end);
+				if (is_lhs)
+					node.add_character_lhs(*it);
+				else
+					node.add_character_rhs(*it);
+				++it;
+			}
+		}
 		
-		if (traits_type::gap_character() != rhs)
-			node.add_character_rhs(rhs);
+		// Reset the current segment at the end of a run of gaps in order to handle
+		// positive similarity for distinct values.
+		end_segment();
 	}
 	
 	
@@ -220,61 +400,27 @@ namespace text_align {
 		auto const lhs_end(lhs.end());
 		auto const rhs_end(rhs.end());
 		
-		// At a given aligned index, if both lhs and rhs have the same character,
-		// append it to a graph node that represents a common segment.
-		// Otherwise, append the characters to a graph node that represents
-		// distinct segments. At the end of a run of gaps reset the current segment
-		// in order to handle positive similarity for distinct values.
-		libbio_assert(lhs_gaps.size() == rhs_gaps.size());
-		{
-			bool prev_lhs_has_gap(false);
-			bool prev_rhs_has_gap(false);
-			for (auto const &tup : ranges::view::zip(lhs_gaps, rhs_gaps))
+		// In a run without gaps, append the characters that are the same in both texts
+		// to a graph node that represents a common segment. Otherwise, append the
+		// characters to a graph node that represents distinct segments.
+		for_each_gap_run(lhs_gaps, rhs_gaps, [&](gap_run_type const run_type, std::size_t const length){
+			switch (run_type)
 			{
-				bool const lhs_has_gap(std::get <0>(tup));
-				bool const rhs_has_gap(std::get <1>(tup));
-			
-				libbio_always_assert(! (lhs_has_gap && rhs_has_gap));
-				
-				if ((prev_lhs_has_gap && !lhs_has_gap) || (prev_rhs_has_gap && !rhs_has_gap))
-					end_current_segment();
-				
-				if (! (lhs_has_gap || rhs_has_gap))
-				{
-					libbio_always_assert(lhs_it != lhs_end);
-					libbio_always_assert(rhs_it != rhs_end);
-				
-					auto const lhsc(*lhs_it);
-					auto const rhsc(*rhs_it);
-					++lhs_it;
-					++rhs_it;
-				
-					if (libbio::is_equal(lhsc, rhsc))
-						append_to_common_segment(lhsc);
-					else
-						append_to_distinct_segment(lhsc, rhsc);
-				}
-				else if (lhs_has_gap)
-				{
-					libbio_always_assert(rhs_it != rhs_end);
-					auto const rhsc(*rhs_it);
-					++rhs_it;
-					append_to_distinct_segment(traits_type::gap_character(), rhsc);
-				}
-				else if (rhs_has_gap)
-				{
-					libbio_always_assert(lhs_it != lhs_end);
-					auto const lhsc(*lhs_it);
-					++lhs_it;
-					append_to_distinct_segment(lhsc, traits_type::gap_character());
-				}
-				
-				prev_lhs_has_gap = lhs_has_gap;
-				prev_rhs_has_gap = rhs_has_gap;
+				case gap_run_type::NONE:
+					handle_aligned_run(lhs_it, lhs_end, rhs_it, rhs_end, length);
+					break;
+					
+				case gap_run_type::LHS:
+					handle_gap_run(rhs_it, rhs_end, length, false);
+					break;
+					
+				case gap_run_type::RHS:
+					handle_gap_run(lhs_it, lhs_end, length, true);
+					break;
 			}
-		}
+		});
 		
-		finalize_graph();
+		end_segment();
 	}
 }
 
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_ALIGNMENT_OPERATION_HH
+#define TEXT_ALIGN_ALIGNMENT_OPERATION_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <libbio/assert.hh>
+#include <string>
+#include <vector>
+
+
+namespace text_align {
+	
+	// The values match the BAM CIGAR operation codes. The left text is considered
+	// the reference, so a gap in it is an insertion.
+	enum alignment_operation : std::uint8_t
+	{
+		OPERATION_INSERTION	= 0x1,
+		OPERATION_DELETION	= 0x2,
+		OPERATION_MATCH		= 0x7,
+		OPERATION_MISMATCH	= 0x8
+	};
+	
+	
+	inline char operation_character(alignment_operation const op)
+	{
+		switch (op)
+		{
+			case OPERATION_INSERTION:	return 'I';
+			case OPERATION_DELETION:	return 'D';
+			case OPERATION_MATCH:		return '=';
+			case OPERATION_MISMATCH:	return 'X';
+			default:
+				libbio_fail("Unexpected alignment operation");
+		}
+		return '?';
+	}
+	
+	
+	struct operation_run
+	{
+		std::size_t				count{};
+		alignment_operation		operation{};
+		
+		operation_run() = default;
+		
+		operation_run(alignment_operation const operation_, std::size_t const count_):
+			count(count_),
+			operation(operation_)
+		{
+		}
+		
+		bool operator==(operation_run const &other) const { return count == other.count && operation == other.operation; }
+	};
+	
+	
+	// Runs of match, mismatch, insertion and deletion, i.e. an extended CIGAR.
+	class operation_run_vector
+	{
+	public:
+		typedef std::vector <operation_run>		run_vector;
+		
+	protected:
+		run_vector	m_runs;
+		
+	public:
+		run_vector const &runs() const { return m_runs; }
+		std::size_t size() const { return m_runs.size(); }
+		bool empty() const { return m_runs.empty(); }
+		
+		inline void push_back(alignment_operation const op, std::size_t const count);
+		void clear() { m_runs.clear(); }
+		void reverse() { std::reverse(m_runs.begin(), m_runs.end()); }
+		
+		inline std::string to_cigar() const;
+		
+		// Append the runs as BAM CIGAR operations (length << 4 | op).
+		// Runs longer than the 28-bit length field are split.
+		inline void to_bam_cigar(std::vector <std::uint32_t> &dst) const;
+		
+		// Write the BAM CIGAR operations in little-endian byte order.
+		inline void write_bam_cigar(std::ostream &stream) const;
+	};
+	
+	
+	void operation_run_vector::push_back(alignment_operation const op, std::size_t const count)
+	{
+		if (0 == count)
+			return;
+		
+		if (!m_runs.empty() && m_runs.back().operation == op)
+			m_runs.back().count += count;
+		else
+			m_runs.emplace_back(op, count);
+	}
+	
+	
+	std::string operation_run_vector::to_cigar() const
+	{
+		std::string retval;
+		for (auto const &run : m_runs)
+		{
+			retval += std::to_string(run.count);
+			retval += operation_character(run.operation);
+		}
+		return retval;
+	}
+	
+	
+	void operation_run_vector::to_bam_cigar(std::vector <std::uint32_t> &dst) const
+	{
+		constexpr std::size_t const max_count((std::size_t(1) << 28) - 1);
+		for (auto const &run : m_runs)
+		{
+			auto count(run.count);
+			while (count)
+			{
+				auto const current(std::min(count, max_count));
+				dst.emplace_back(std::uint32_t(current) << 4 | run.operation);
+				count -= current;
+			}
+		}
+	}
+	
+	
+	void operation_run_vector::write_bam_cigar(std::ostream &stream) const
+	{
+		std::vector <std::uint32_t> ops;
+		to_bam_cigar(ops);
+		for (auto const op : ops)
+		{
+			char const buffer[4]{
+				char(op & 0xff),
+				char((op >> 8) & 0xff),
+				char((op >> 16) & 0xff),
+				char((op >> 24) & 0xff)
+			};
+			stream.write(buffer, 4);
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_ANCHORS_HH
+#define TEXT_ALIGN_ANCHORS_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <libbio/assert.hh>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+namespace text_align {
+	
+	// An exact match of length characters at lhs_pos and rhs_pos.
+	struct anchor
+	{
+		std::size_t	lhs_pos{};
+		std::size_t	rhs_pos{};
+		std::size_t	length{};
+		
+		anchor() = default;
+		
+		anchor(std::size_t const lhs_pos_, std::size_t const rhs_pos_, std::size_t const length_):
+			lhs_pos(lhs_pos_),
+			rhs_pos(rhs_pos_),
+			length(length_)
+		{
+		}
+		
+		std::size_t lhs_end() const { return lhs_pos + length; }
+		std::size_t rhs_end() const { return rhs_pos + length; }
+		
+		bool operator==(anchor const &other) const { return lhs_pos == other.lhs_pos && rhs_pos == other.rhs_pos && length == other.length; }
+	};
+	
+	typedef std::vector <anchor> anchor_vector;
+	
+	
+	struct anchor_parameters
+	{
+		std::size_t	kmer_length{20};
+		std::size_t	window_length{10};	// In k-mers.
+	};
+	
+	
+	// Find the (w, k)-minimizers of text, i.e. the positions of the k-mers with the smallest hash
+	// value in each window of w consecutive k-mers.
+	template <typename t_character>
+	void find_minimizers(
+		std::vector <t_character> const &text,
+		anchor_parameters const &parameters,
+		std::vector <std::pair <std::uint64_t, std::size_t>> &dst	// Out; (hash, position).
+	);
+	
+	// Find the exact matches that extend k-mers that are minimizers in both texts and occur once
+	// among the minimizers of each.
+	template <typename t_character>
+	void find_unique_anchors(
+		std::vector <t_character> const &lhs,
+		std::vector <t_character> const &rhs,
+		anchor_parameters const &parameters,
+		anchor_vector &dst	// Out
+	);
+	
+	// Replace the anchors with the collinear, non-overlapping chain that covers the most characters.
+	inline void chain_anchors(anchor_vector &anchors);
+}
+
+
+namespace text_align { namespace detail {
+	
+	inline std::uint64_t mix_hash(std::uint64_t val)
+	{
+		// Finalizer of MurmurHash3.
+		val ^= val >> 33;
+		val *= 0xff51afd7ed558ccdULL;
+		val ^= val >> 33;
+		val *= 0xc4ceb9fe1a85ec53ULL;
+		val ^= val >> 33;
+		return val;
+	}
+	
+	
+	// Maximum of the values stored at the keys up to the given one.
+	class prefix_max_tree
+	{
+	protected:
+		std::vector <std::pair <std::size_t, std::size_t>>	m_values;	// (value, index)
+	
+	public:
+		prefix_max_tree(std::size_t const size):
+			m_values(1 + size)
+		{
+		}
+		
+		void update(std::size_t key, std::size_t const value, std::size_t const idx)
+		{
+			for (++key; key < m_values.size(); key += key & (~key + 1))
+			{
+				if (m_values[key].first < value)
+					m_values[key] = std::make_pair(value, idx);
+			}
+		}
+		
+		// Return (0, SIZE_MAX) if there are no values.
+		std::pair <std::size_t, std::size_t> find(std::size_t key) const
+		{
+			std::pair <std::size_t, std::size_t> retval(0, SIZE_MAX);
+			for (++key; key; key -= key & (~key + 1))
+			{
+				if (retval.first < m_values[key].first)
+					retval = m_values[key];
+			}
+			return retval;
+		}
+	};
+}}
+
+
+namespace text_align {
+	
+	template <typename t_character>
+	void find_minimizers(
+		std::vector <t_character> const &text,
+		anchor_parameters const &parameters,
+		std::vector <std::pair <std::uint64_t, std::size_t>> &dst
+	)
+	{
+		auto const k(parameters.kmer_length);
+		auto const w(parameters.window_length);
+		libbio_always_assert(0 < k);
+		libbio_always_assert(0 < w);
+		
+		dst.clear();
+		if (text.size() < k)
+			return;
+		
+		// Polynomial rolling hash mod 2^64.
+		std::uint64_t const base(0x100000001b3ULL);
+		std::uint64_t top_power(1);
+		for (std::size_t i(1); i < k; ++i)
+			top_power *= base;
+		
+		std::uint64_t rolling(0);
+		for (std::size_t i(0); i < k; ++i)
+			rolling = rolling * base + std::uint64_t(text[i]);
+		
+		// Monotonic queue of (hash, position) for the sliding window.
+		std::deque <std::pair <std::uint64_t, std::size_t>> window;
+		std::size_t const kmer_count(text.size() - k + 1);
+		for (std::size_t pos(0); pos < kmer_count; ++pos)
+		{
+			if (pos)
+				rolling = (rolling - std::uint64_t(text[pos - 1]) * top_power) * base + std::uint64_t(text[pos + k - 1]);
+			
+			auto const hash(detail::mix_hash(rolling));
+			while (!window.empty() && hash <= window.back().first)
+				window.pop_back();
+			window.emplace_back(hash, pos);
+			
+			if (window.front().second + w <= pos)
+				window.pop_front();
+			
+			if (w <= 1 + pos || 1 + pos == kmer_count)
+			{
+				auto const &min(window.front());
+				if (dst.empty() || dst.back().second != min.second)
+					dst.push_back(min);
+			}
+		}
+	}
+	
+	
+	template <typename t_character>
+	void find_unique_anchors(
+		std::vector <t_character> const &lhs,
+		std::vector <t_character> const &rhs,
+		anchor_parameters const &parameters,
+		anchor_vector &dst
+	)
+	{
+		typedef std::vector <std::pair <std::uint64_t, std::size_t>>	minimizer_vector;
+		typedef std::unordered_map <std::uint64_t, std::size_t>		position_map;
+		
+		auto const k(parameters.kmer_length);
+		dst.clear();
+		
+		minimizer_vector lhs_minimizers, rhs_minimizers;
+		find_minimizers(lhs, parameters, lhs_minimizers);
+		find_minimizers(rhs, parameters, rhs_minimizers);
+		
+		// Store the position of each hash value that occurs once, SIZE_MAX otherwise.
+		auto const make_map([](minimizer_vector const &minimizers, position_map &map){
+			map.reserve(minimizers.size());
+			for (auto const &[hash, pos] : minimizers)
+			{
+				auto const res(map.emplace(hash, pos));
+				if (!res.second)
+					res.first->second = SIZE_MAX;
+			}
+		});
+		
+		position_map lhs_positions, rhs_positions;
+		make_map(lhs_minimizers, lhs_positions);
+		make_map(rhs_minimizers, rhs_positions);
+		
+		for (auto const &[hash, lhs_pos] : lhs_positions)
+		{
+			if (SIZE_MAX == lhs_pos)
+				continue;
+			
+			auto const it(rhs_positions.find(hash));
+			if (rhs_positions.end() == it || SIZE_MAX == it->second)
+				continue;
+			
+			// Check for hash collisions.
+			auto const rhs_pos(it->second);
+			if (!std::equal(lhs.begin() + lhs_pos, lhs.begin() + lhs_pos + k, rhs.begin() + rhs_pos))
+				continue;
+			
+			// Extend the match in both directions.
+			std::size_t left(0);
+			while (left < lhs_pos && left < rhs_pos && lhs[lhs_pos - left - 1] == rhs[rhs_pos - left - 1])
+				++left;
+			
+			std::size_t right(k);
+			while (lhs_pos + right < lhs.size() && rhs_pos + right < rhs.size() && lhs[lhs_pos + right] == rhs[rhs_pos + right])
+				++right;
+			
+			dst.emplace_back(lhs_pos - left, rhs_pos - left, left + right);
+		}
+		
+		// Matches on the same diagonal may have been extended to the same one.
+		std::sort(dst.begin(), dst.end(), [](anchor const &lhs, anchor const &rhs){
+			return std::make_tuple(lhs.lhs_pos, lhs.rhs_pos) < std::make_tuple(rhs.lhs_pos, rhs.rhs_pos);
+		});
+		dst.erase(std::unique(dst.begin(), dst.end()), dst.end());
+	}
+	
+	
+	inline void chain_anchors(anchor_vector &anchors)
+	{
+		if (anchors.empty())
+			return;
+		
+		// Process the anchors in the order of their starting positions in lhs. Before processing
+		// an anchor, make the anchors that end before it in lhs available, keyed by their ends in rhs.
+		// Then the best predecessor is the one with the highest score among those that end before
+		// the anchor in rhs.
+		std::sort(anchors.begin(), anchors.end(), [](anchor const &lhs, anchor const &rhs){
+			return lhs.lhs_pos < rhs.lhs_pos;
+		});
+		
+		auto const count(anchors.size());
+		std::vector <std::size_t> by_lhs_end(count);
+		std::vector <std::size_t> rhs_ends(count);
+		for (std::size_t i(0); i < count; ++i)
+		{
+			by_lhs_end[i] = i;
+			rhs_ends[i] = anchors[i].rhs_end();
+		}
+		std::sort(by_lhs_end.begin(), by_lhs_end.end(), [&anchors](auto const lhs, auto const rhs){
+			return anchors[lhs].lhs_end() < anchors[rhs].lhs_end();
+		});
+		std::sort(rhs_ends.begin(), rhs_ends.end());
+		rhs_ends.erase(std::unique(rhs_ends.begin(), rhs_ends.end()), rhs_ends.end());
+		
+		std::vector <std::size_t> scores(count);
+		std::vector <std::size_t> predecessors(count, SIZE_MAX);
+		detail::prefix_max_tree tree(rhs_ends.size());
+		std::size_t available(0);
+		std::size_t best_idx(0);
+		for (std::size_t i(0); i < count; ++i)
+		{
+			auto const &current(anchors[i]);
+			while (available < count && anchors[by_lhs_end[available]].lhs_end() <= current.lhs_pos)
+			{
+				auto const idx(by_lhs_end[available]);
+				auto const key(std::lower_bound(rhs_ends.begin(), rhs_ends.end(), anchors[idx].rhs_end()) - rhs_ends.begin());
+				tree.update(key, scores[idx], idx);
+				++available;
+			}
+			
+			// Find the predecessors that end at or before the current anchor in rhs.
+			auto const limit(std::upper_bound(rhs_ends.begin(), rhs_ends.end(), current.rhs_pos) - rhs_ends.begin());
+			auto const [prev_score, prev_idx] = (limit ? tree.find(limit - 1) : std::make_pair(std::size_t(0), std::size_t(SIZE_MAX)));
+			scores[i] = prev_score + current.length;
+			predecessors[i] = prev_idx;
+			
+			if (scores[best_idx] < scores[i])
+				best_idx = i;
+		}
+		
+		// Follow the predecessors.
+		anchor_vector chain;
+		for (auto idx(best_idx); SIZE_MAX != idx; idx = predecessors[idx])
+			chain.push_back(anchors[idx]);
+		std::reverse(chain.begin(), chain.end());
+		
+		using std::swap;
+		swap(anchors, chain);
+	}
+}
+
+#endif
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_BINARY_SERIALIZE_HH
+#define TEXT_ALIGN_BINARY_SERIALIZE_HH
+
+#include <cstdint>
+#include <libbio/int_vector.hh>
+#include <libbio/rle_bit_vector.hh>
+#include <text_align/flat_alignment_graph.hh>
+#include <text_align/gap_run_buffer.hh>
+#include <text_align/gap_runs.hh>
+#include <vector>
+
+
+// Binary format for alignment results. Apart from the first six bytes, integers
+// are stored as unsigned LEB128 varints.
+//	magic "TXAL", format version (1 byte), flags (1 byte)
+//	score as a zigzag-encoded varint, if FLAG_HAS_SCORE is set
+//	left gaps and right gaps, each as bit count, value of the first run (1 byte),
+//		run count and run lengths
+//	segment count and for each segment the type (1 byte), left length and right length,
+//		if FLAG_HAS_GRAPH is set; the offsets are the sums of the preceding lengths
+namespace text_align { namespace binary {
+	
+	enum { FORMAT_VERSION = 1 };
+	
+	enum flag_type : std::uint8_t
+	{
+		FLAG_NONE		= 0x0,
+		FLAG_HAS_SCORE	= 0x1,
+		FLAG_HAS_GRAPH	= 0x2
+	};
+	
+	typedef std::vector <std::uint8_t> buffer_type;
+	
+	
+	struct alignment_record
+	{
+		gap_run_buffer							lhs_gaps;
+		gap_run_buffer							rhs_gaps;
+		alignment_graph::flat_segment_vector	segments;
+		std::int64_t							score{};
+		std::uint8_t							flags{};
+		
+		bool has_score() const { return flags & FLAG_HAS_SCORE; }
+		bool has_graph() const { return flags & FLAG_HAS_GRAPH; }
+		void clear();
+	};
+	
+	
+	inline void write_varint(buffer_type &dst, std::uint64_t val)
+	{
+		while (0x7f < val)
+		{
+			dst.push_back(0x80 | (val & 0x7f));
+			val >>= 7;
+		}
+		dst.push_back(val);
+	}
+	
+	void write_header(buffer_type &dst, std::uint8_t const flags);
+	void write_score(buffer_type &dst, std::int64_t const score);
+	void write_gaps(buffer_type &dst, libbio::bit_vector const &gaps);
+	void write_graph(buffer_type &dst, alignment_graph::flat_segment_vector const &segments);
+	
+	template <typename t_count>
+	void write_gaps(buffer_type &dst, libbio::rle_bit_vector <t_count> const &gaps);
+	
+	// Encode the gap vectors and optionally the score and the graph.
+	template <typename t_bit_vector>
+	void encode(
+		buffer_type &dst,
+		t_bit_vector const &lhs_gaps,
+		t_bit_vector const &rhs_gaps,
+		std::int64_t const *score = nullptr,
+		alignment_graph::flat_segment_vector const *segments = nullptr
+	);
+	
+	// Throws std::runtime_error if the input is not valid.
+	void decode(std::uint8_t const *data, std::size_t const size, alignment_record &dst);
+	
+	
+	template <typename t_count>
+	void write_gaps(buffer_type &dst, libbio::rle_bit_vector <t_count> const &gaps)
+	{
+		auto const &runs(gaps.const_runs());
+		std::size_t bit_count(0);
+		for (auto const run : runs)
+			bit_count += run;
+		
+		write_varint(dst, bit_count);
+		dst.push_back(gaps.starts_with_zero() ? 0 : 1);
+		write_varint(dst, runs.size());
+		for (auto const run : runs)
+			write_varint(dst, run);
+	}
+	
+	
+	template <typename t_bit_vector>
+	void encode(
+		buffer_type &dst,
+		t_bit_vector const &lhs_gaps,
+		t_bit_vector const &rhs_gaps,
+		std::int64_t const *score,
+		alignment_graph::flat_segment_vector const *segments
+	)
+	{
+		std::uint8_t const flags((score ? FLAG_HAS_SCORE : FLAG_NONE) | (segments ? FLAG_HAS_GRAPH : FLAG_NONE));
+		write_header(dst, flags);
+		if (score)
+			write_score(dst, *score);
+		write_gaps(dst, lhs_gaps);
+		write_gaps(dst, rhs_gaps);
+		if (segments)
+			write_graph(dst, *segments);
+	}
+}}
+
+#endif
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_CANCELLATION_TOKEN_HH
+#define TEXT_ALIGN_CANCELLATION_TOKEN_HH
+
+#include <atomic>
+#include <memory>
+
+
+namespace text_align {
+	
+	// Copies share the flag, so a copy may be passed to another thread and used for cancelling
+	// a running task. Once cancelled, a token stays cancelled.
+	class cancellation_token
+	{
+	protected:
+		std::shared_ptr <std::atomic_bool>	m_is_cancelled;
+		
+	public:
+		cancellation_token():
+			m_is_cancelled(std::make_shared <std::atomic_bool>(false))
+		{
+		}
+		
+		void cancel() { m_is_cancelled->store(true, std::memory_order_release); }
+		bool is_cancelled() const { return m_is_cancelled->load(std::memory_order_acquire); }
+	};
+}
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_COMMON_AFFIX_HH
+#define TEXT_ALIGN_COMMON_AFFIX_HH
+
+#include <cstddef>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#	include <emmintrin.h>
+#endif
+
+
+namespace text_align { namespace detail {
+	
+	template <typename t_lhs, typename t_rhs>
+	constexpr bool can_compare_bytes()
+	{
+		// Equal characters have equal object representations.
+		return (
+			std::is_same_v <t_lhs, t_rhs> &&
+			std::is_integral_v <t_lhs> &&
+			16 % sizeof(t_lhs) == 0
+		);
+	}
+}}
+
+
+namespace text_align {
+	
+	// Return the length of the common prefix of [lhs, lhs + length) and [rhs, rhs + length).
+	template <typename t_lhs, typename t_rhs>
+	std::size_t common_prefix_length(t_lhs const *lhs, t_rhs const *rhs, std::size_t const length)
+	{
+		std::size_t i(0);
+		
+#if defined(__SSE2__)
+		if constexpr (detail::can_compare_bytes <t_lhs, t_rhs>())
+		{
+			// Compare 16 bytes at a time. The first differing byte is in the first differing character.
+			constexpr std::size_t const count(16 / sizeof(t_lhs));
+			while (i + count <= length)
+			{
+				auto const lhs_val(_mm_loadu_si128(reinterpret_cast <__m128i const *>(lhs + i)));
+				auto const rhs_val(_mm_loadu_si128(reinterpret_cast <__m128i const *>(rhs + i)));
+				auto const mask(0xffff ^ _mm_movemask_epi8(_mm_cmpeq_epi8(lhs_val, rhs_val)));
+				if (mask)
+					return i + __builtin_ctz(mask) / sizeof(t_lhs);
+				i += count;
+			}
+		}
+#endif
+		
+		while (i < length && lhs[i] == rhs[i])
+			++i;
+		
+		return i;
+	}
+	
+	
+	// Return the length of the common suffix of [lhs_end - length, lhs_end) and [rhs_end - length, rhs_end).
+	template <typename t_lhs, typename t_rhs>
+	std::size_t common_suffix_length(t_lhs const *lhs_end, t_rhs const *rhs_end, std::size_t const length)
+	{
+		std::size_t i(0);
+		
+#if defined(__SSE2__)
+		if constexpr (detail::can_compare_bytes <t_lhs, t_rhs>())
+		{
+			// Compare 16 bytes at a time from the end. The last differing byte is in the last differing character.
+			constexpr std::size_t const count(16 / sizeof(t_lhs));
+			while (i + count <= length)
+			{
+				auto const lhs_val(_mm_loadu_si128(reinterpret_cast <__m128i const *>(lhs_end - i - count)));
+				auto const rhs_val(_mm_loadu_si128(reinterpret_cast <__m128i const *>(rhs_end - i - count)));
+				auto const mask(0xffff ^ _mm_movemask_epi8(_mm_cmpeq_epi8(lhs_val, rhs_val)));
+				if (mask)
+				{
+					std::size_t const last_differing(31 - __builtin_clz(mask));
+					return i + (15 - last_differing) / sizeof(t_lhs);
+				}
+				i += count;
+			}
+		}
+#endif
+		
+		while (i < length && lhs_end[-1 - std::ptrdiff_t(i)] == rhs_end[-1 - std::ptrdiff_t(i)])
+			++i;
+		
+		return i;
+	}
+}
+
+#endif
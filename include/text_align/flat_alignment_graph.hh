@@ -0,0 +1,324 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_FLAT_ALIGNMENT_GRAPH_HH
+#define TEXT_ALIGN_FLAT_ALIGNMENT_GRAPH_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <libbio/algorithm.hh>
+#include <libbio/assert.hh>
+#include <libbio/int_vector.hh>
+#include <text_align/alignment_graph_builder.hh>
+#include <text_align/gap_runs.hh>
+#include <text_align/json_serialize.hh>
+#include <type_traits>
+#include <vector>
+
+
+namespace text_align { namespace alignment_graph {
+	
+	// A graph node as offsets to the aligned texts. The offsets and lengths are in characters.
+	struct flat_segment
+	{
+		std::size_t				lhs_offset{};
+		std::size_t				lhs_length{};
+		std::size_t				rhs_offset{};
+		std::size_t				rhs_length{};
+		enum node_type			type{node_type::NONE};
+		
+		flat_segment() = default;
+		
+		flat_segment(enum node_type const type_, std::size_t const lhs_offset_, std::size_t const rhs_offset_):
+			lhs_offset(lhs_offset_),
+			rhs_offset(rhs_offset_),
+			type(type_)
+		{
+		}
+	};
+	
+	typedef std::vector <flat_segment> flat_segment_vector;
+	
+	
+	// Call visitor.visit_common_segment(segment) or visitor.visit_distinct_segment(segment) for each segment.
+	template <typename t_visitor>
+	void visit_segments(flat_segment_vector const &segments, t_visitor &&visitor)
+	{
+		for (auto const &segment : segments)
+		{
+			switch (segment.type)
+			{
+				case node_type::COMMON:
+					visitor.visit_common_segment(segment);
+					break;
+				case node_type::DISTINCT:
+					visitor.visit_distinct_segment(segment);
+					break;
+				default:
+					libbio_fail("Unexpected segment type");
+			}
+		}
+	}
+}}
+
+
+namespace text_align {
+	
+	// Build the alignment graph as a flat vector of segments that refer to the original texts.
+	class flat_alignment_graph_builder
+	{
+	public:
+		typedef alignment_graph::flat_segment			flat_segment;
+		typedef alignment_graph::flat_segment_vector	flat_segment_vector;
+		
+	protected:
+		flat_segment_vector	m_segments;
+		std::size_t			m_lhs_pos{};
+		std::size_t			m_rhs_pos{};
+		bool				m_is_segment_open{};
+		
+	protected:
+		inline flat_segment &current_segment(enum alignment_graph::node_type const type);
+		void end_segment() { m_is_segment_open = false; }
+		
+		template <typename t_lhs_it, typename t_lhs_end, typename t_rhs_it, typename t_rhs_end>
+		void handle_aligned_run(t_lhs_it &lhs_it, t_lhs_end const &lhs_end, t_rhs_it &rhs_it, t_rhs_end const &rhs_end, std::size_t const length);
+		
+		template <typename t_iterator, typename t_end>
+		void skip_characters(t_iterator &it, t_end const &end, std::size_t const length) const;
+		
+	public:
+		flat_segment_vector const &segments() const { return m_segments; }
+		
+		template <typename t_lhs, typename t_rhs>
+		void build_graph(
+			t_lhs const &lhs,
+			t_rhs const &rhs,
+			libbio::bit_vector const &lhs_gaps,
+			libbio::bit_vector const &rhs_gaps
+		);
+	};
+	
+	
+	auto flat_alignment_graph_builder::current_segment(enum alignment_graph::node_type const type) -> flat_segment &
+	{
+		if (! (m_is_segment_open && m_segments.back().type == type))
+		{
+			m_segments.emplace_back(type, m_lhs_pos, m_rhs_pos);
+			m_is_segment_open = true;
+		}
+		return m_segments.back();
+	}
+	
+	
+	template <typename t_lhs_it, typename t_lhs_end, typename t_rhs_it, typename t_rhs_end>
+	void flat_alignment_graph_builder::handle_aligned_run(
+		t_lhs_it &lhs_it,
+		t_lhs_end const &lhs_end,
+		t_rhs_it &rhs_it,
+		t_rhs_end const &rhs_end,
+		std::size_t const length
+	)
+	{
+		auto const add_characters([this](enum alignment_graph::node_type const type, std::size_t const count){
+			auto &segment(current_segment(type));
+			segment.lhs_length += count;
+			segment.rhs_length += count;
+			m_lhs_pos += count;
+			m_rhs_pos += count;
+		});
+		
+		if constexpr (detail::is_random_access_iterator <t_lhs_it>::value && detail::is_random_access_iterator <t_rhs_it>::value)
+		{
+			libbio_always_assert(length <= std::size_t(lhs_end - lhs_it));
+			libbio_always_assert(length <= std::size_t(rhs_end - rhs_it));
+			
+			// Compare spans of characters.
+			auto const lhs_limit(lhs_it + length);
+			while (lhs_it != lhs_limit)
+			{
+				auto const pair(std::mismatch(lhs_it, lhs_limit, rhs_it, [](auto const lhsc, auto const rhsc){
+					return libbio::is_equal(lhsc, rhsc);
+				}));
+				
+				if (lhs_it != pair.first)
+				{
+					add_characters(alignment_graph::node_type::COMMON, pair.first - lhs_it);
+					lhs_it = pair.first;
+					rhs_it = pair.second;
+				}
+				
+				std::size_t count(0);
+				while (lhs_it != lhs_limit && !libbio::is_equal(*lhs_it, *rhs_it))
+				{
+					++lhs_it;
+					++rhs_it;
+					++count;
+				}
+				
+				if (count)
+					add_characters(alignment_graph::node_type::DISTINCT, count);
+			}
+		}
+		else
+		{
+			for (std::size_t i(0); i < length; ++i)
+			{
+				libbio_always_assert(lhs_it != lhs_end);
+				libbio_always_assert(rhs_it != rhs_end);
+				
+				auto const is_common(libbio::is_equal(*lhs_it, *rhs_it));
+				++lhs_it;
+				++rhs_it;
+				add_characters(is_common ? alignment_graph::node_type::COMMON : alignment_graph::node_type::DISTINCT, 1);
+			}
+		}
+	}
+	
+	
+	template <typename t_iterator, typename t_end>
+	void flat_alignment_graph_builder::skip_characters(t_iterator &it, t_end const &end, std::size_t const length) const
+	{
+		if constexpr (detail::is_random_access_iterator <t_iterator>::value)
+		{
+			libbio_always_assert(length <= std::size_t(end - it));
+			it += length;
+		}
+		else
+		{
+			for (std::size_t i(0); i < length; ++i)
+			{
+				libbio_always_assert(it != end);
+				++it;
+			}
+		}
+	}
+	
+	
+	template <typename t_lhs, typename t_rhs>
+	void flat_alignment_graph_builder::build_graph(
+		t_lhs const &lhs,
+		t_rhs const &rhs,
+		libbio::bit_vector const &lhs_gaps,
+		libbio::bit_vector const &rhs_gaps
+	)
+	{
+		m_segments.clear();
+		m_lhs_pos = 0;
+		m_rhs_pos = 0;
+		m_is_segment_open = false;
+		
+		auto lhs_it(lhs.begin());
+		auto rhs_it(rhs.begin());
+		auto const lhs_end(lhs.end());
+		auto const rhs_end(rhs.end());
+		
+		// Follow the rules of alignment_graph_builder but store only the offsets.
+		for_each_gap_run(lhs_gaps, rhs_gaps, [&](gap_run_type const run_type, std::size_t const length){
+			switch (run_type)
+			{
+				case gap_run_type::NONE:
+					handle_aligned_run(lhs_it, lhs_end, rhs_it, rhs_end, length);
+					break;
+					
+				case gap_run_type::LHS:
+				{
+					skip_characters(rhs_it, rhs_end, length);
+					current_segment(alignment_graph::node_type::DISTINCT).rhs_length += length;
+					m_rhs_pos += length;
+					end_segment();
+					break;
+				}
+				
+				case gap_run_type::RHS:
+				{
+					skip_characters(lhs_it, lhs_end, length);
+					current_segment(alignment_graph::node_type::DISTINCT).lhs_length += length;
+					m_lhs_pos += length;
+					end_segment();
+					break;
+				}
+			}
+		});
+		
+		end_segment();
+	}
+}
+
+
+namespace text_align { namespace json {
+	
+	// Output the segments as offsets and lengths.
+	inline void to_json(std::ostream &stream, alignment_graph::flat_segment_vector const &segments)
+	{
+		stream << '[';
+		bool first(true);
+		for (auto const &segment : segments)
+		{
+			if (!first)
+				stream << ", ";
+			
+			stream << "{\"type\": \"" << (alignment_graph::node_type::COMMON == segment.type ? "common" : "distinct") << '"';
+			stream << ", \"lhs\": [" << segment.lhs_offset << ", " << segment.lhs_length << ']';
+			stream << ", \"rhs\": [" << segment.rhs_offset << ", " << segment.rhs_length << "]}";
+			first = false;
+		}
+		stream << ']';
+	}
+	
+	
+	// Output the segments in the same format as the graph nodes. The texts are read once
+	// in order, so forward ranges suffice.
+	template <typename t_lhs, typename t_rhs>
+	void to_json(std::ostream &stream, alignment_graph::flat_segment_vector const &segments, t_lhs const &lhs, t_rhs const &rhs)
+	{
+		typedef std::decay_t <decltype(*lhs.begin())>	lhs_character_type;
+		typedef std::decay_t <decltype(*rhs.begin())>	rhs_character_type;
+		
+		auto lhs_it(lhs.begin());
+		auto rhs_it(rhs.begin());
+		std::vector <lhs_character_type> lhs_buffer;
+		std::vector <rhs_character_type> rhs_buffer;
+		
+		auto const copy_characters([](auto &it, std::size_t const count, auto &dst){
+			dst.clear();
+			for (std::size_t i(0); i < count; ++i)
+			{
+				dst.emplace_back(*it);
+				++it;
+			}
+		});
+		
+		stream << '[';
+		bool first(true);
+		for (auto const &segment : segments)
+		{
+			stream << (first ? "{" : ", {");
+			copy_characters(lhs_it, segment.lhs_length, lhs_buffer);
+			copy_characters(rhs_it, segment.rhs_length, rhs_buffer);
+			
+			if (alignment_graph::node_type::COMMON == segment.type)
+			{
+				write(stream, "type", "common");
+				stream << ", ";
+				write(stream, "text", lhs_buffer);
+			}
+			else
+			{
+				write(stream, "type", "distinct");
+				stream << ", ";
+				write(stream, "lhs", lhs_buffer);
+				stream << ", ";
+				write(stream, "rhs", rhs_buffer);
+			}
+			
+			stream << '}';
+			first = false;
+		}
+		stream << ']';
+	}
+}}
+
+#endif
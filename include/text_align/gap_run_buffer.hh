@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_GAP_RUN_BUFFER_HH
+#define TEXT_ALIGN_GAP_RUN_BUFFER_HH
+
+#include <climits>
+#include <cstdint>
+#include <libbio/assert.hh>
+#include <libbio/int_vector.hh>
+#include <libbio/rle_bit_vector.hh>
+#include <type_traits>
+#include <vector>
+
+
+namespace text_align {
+	
+	struct gap_run
+	{
+		std::size_t	length{};
+		bool		flag{};
+		
+		gap_run() = default;
+		
+		gap_run(bool const flag_, std::size_t const length_):
+			length(length_),
+			flag(flag_)
+		{
+		}
+	};
+	
+	
+	// Collect the runs pushed by the traceback. Since the runs are stored in the order
+	// in which they were pushed, reversing only changes the direction in which they are
+	// read. The bit vectors are written once the final size is known.
+	class gap_run_buffer
+	{
+	protected:
+		std::vector <gap_run>	m_runs;
+		std::size_t				m_size{};
+		bool					m_is_reversed{};
+		
+	public:
+		std::size_t size() const { return m_size; }
+		std::size_t run_count() const { return m_runs.size(); }
+		std::vector <gap_run> const &runs() const { return m_runs; }
+		bool is_reversed() const { return m_is_reversed; }
+		
+		void reserve(std::size_t const count) { m_runs.reserve(count); }
+		inline void push_back(bool const flag, std::size_t const count);
+		inline void clear();
+		void reverse() { m_is_reversed = !m_is_reversed; }
+		
+		// Call fn(flag, length) for each run in the logical order.
+		template <typename t_fn>
+		void visit_runs(t_fn &&fn) const;
+		
+		inline void to_bit_vector(libbio::bit_vector &dst) const;
+		
+		template <typename t_count>
+		void to_rle_bit_vector(libbio::rle_bit_vector <t_count> &dst) const;
+	};
+	
+	
+	void gap_run_buffer::push_back(bool const flag, std::size_t const count)
+	{
+		if (0 == count)
+			return;
+		
+		// Merge with the previous run if possible.
+		m_size += count;
+		if (!m_runs.empty() && m_runs.back().flag == flag)
+			m_runs.back().length += count;
+		else
+			m_runs.emplace_back(flag, count);
+	}
+	
+	
+	void gap_run_buffer::clear()
+	{
+		m_runs.clear();
+		m_size = 0;
+		m_is_reversed = false;
+	}
+	
+	
+	template <typename t_fn>
+	void gap_run_buffer::visit_runs(t_fn &&fn) const
+	{
+		if (m_is_reversed)
+		{
+			for (auto it(m_runs.crbegin()), end(m_runs.crend()); it != end; ++it)
+				fn(it->flag, it->length);
+		}
+		else
+		{
+			for (auto const &run : m_runs)
+				fn(run.flag, run.length);
+		}
+	}
+	
+	
+	void gap_run_buffer::to_bit_vector(libbio::bit_vector &dst) const
+	{
+		typedef std::remove_reference_t <decltype(*dst.word_begin())>	word_type;
+		constexpr std::size_t const word_bits(CHAR_BIT * sizeof(word_type));
+		
+		// Allocate the exact size and fill the runs of ones word by word.
+		dst = libbio::bit_vector(m_size, 0);
+		auto const words(dst.word_begin());
+		std::size_t pos(0);
+		visit_runs([&words, &pos](bool const flag, std::size_t const length){
+			if (flag)
+			{
+				auto const limit(pos + length);
+				while (pos < limit)
+				{
+					auto const word_idx(pos / word_bits);
+					auto const bit_idx(pos % word_bits);
+					auto const count(std::min(word_bits - bit_idx, limit - pos));
+					word_type const mask(word_bits == count ? ~word_type(0) : ((word_type(1) << count) - 1) << bit_idx);
+					words[word_idx] |= mask;
+					pos += count;
+				}
+			}
+			else
+			{
+				pos += length;
+			}
+		});
+		libbio_assert(pos == m_size);
+	}
+	
+	
+	template <typename t_count>
+	void gap_run_buffer::to_rle_bit_vector(libbio::rle_bit_vector <t_count> &dst) const
+	{
+		dst.clear();
+		visit_runs([&dst](bool const flag, std::size_t const length){
+			dst.push_back(flag, length);
+		});
+	}
+}
+
+#endif
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_GAP_RUNS_HH
+#define TEXT_ALIGN_GAP_RUNS_HH
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <libbio/assert.hh>
+#include <libbio/int_vector.hh>
+#include <type_traits>
+
+
+namespace text_align {
+	
+	enum class gap_run_type : std::uint8_t
+	{
+		NONE	= 0,	// Neither text has a gap.
+		LHS		= 1,	// The left text has a gap.
+		RHS		= 2		// The right text has a gap.
+	};
+	
+	
+	// Call fn(gap_run_type, length) for each maximal run in a pair of gap vectors.
+	// The vectors are processed one word at a time, and the run boundaries are found
+	// by counting trailing zeros.
+	template <typename t_fn>
+	void for_each_gap_run(libbio::bit_vector const &lhs_gaps, libbio::bit_vector const &rhs_gaps, t_fn &&fn)
+	{
+		typedef std::remove_cv_t <std::remove_reference_t <decltype(*lhs_gaps.word_begin())>>	word_type;
+		constexpr std::size_t const word_bits(CHAR_BIT * sizeof(word_type));
+		static_assert(word_bits <= CHAR_BIT * sizeof(unsigned long long));
+		
+		libbio_always_assert(lhs_gaps.size() == rhs_gaps.size());
+		auto const size(lhs_gaps.size());
+		auto const lhs_words(lhs_gaps.word_begin());
+		auto const rhs_words(rhs_gaps.word_begin());
+		std::size_t pos(0);
+		
+		while (pos < size)
+		{
+			// Determine the type of the run from its first position.
+			auto const word_idx(pos / word_bits);
+			auto const bit_idx(pos % word_bits);
+			bool const lhs_has_gap((lhs_words[word_idx] >> bit_idx) & 0x1);
+			bool const rhs_has_gap((rhs_words[word_idx] >> bit_idx) & 0x1);
+			libbio_always_assert(! (lhs_has_gap && rhs_has_gap));
+			auto const run_type(lhs_has_gap ? gap_run_type::LHS : (rhs_has_gap ? gap_run_type::RHS : gap_run_type::NONE));
+			
+			// Extend the run one word at a time.
+			std::size_t length(0);
+			while (pos < size)
+			{
+				auto const word_idx(pos / word_bits);
+				auto const bit_idx(pos % word_bits);
+				auto const valid_bits(std::min(word_bits - bit_idx, size - pos));
+				word_type const lhs_word(lhs_words[word_idx] >> bit_idx);
+				word_type const rhs_word(rhs_words[word_idx] >> bit_idx);
+				
+				// Set the bits that end the run.
+				word_type stop_mask{};
+				switch (run_type)
+				{
+					case gap_run_type::NONE:
+						stop_mask = lhs_word | rhs_word;
+						break;
+					case gap_run_type::LHS:
+						stop_mask = word_type(~lhs_word) | rhs_word;
+						break;
+					case gap_run_type::RHS:
+						stop_mask = word_type(~rhs_word) | lhs_word;
+						break;
+				}
+				
+				std::size_t const count(
+					stop_mask
+					? std::min <std::size_t>(__builtin_ctzll(static_cast <unsigned long long>(stop_mask)), valid_bits)
+					: valid_bits
+				);
+				
+				length += count;
+				pos += count;
+				if (count < valid_bits)
+					break;
+			}
+			
+			libbio_assert(length);
+			fn(run_type, length);
+		}
+	}
+	
+	
+	// Call fn(bool, length) for each maximal run of equal bits.
+	template <typename t_fn>
+	void for_each_bit_run(libbio::bit_vector const &vec, t_fn &&fn)
+	{
+		typedef std::remove_cv_t <std::remove_reference_t <decltype(*vec.word_begin())>>	word_type;
+		constexpr std::size_t const word_bits(CHAR_BIT * sizeof(word_type));
+		static_assert(word_bits <= CHAR_BIT * sizeof(unsigned long long));
+		
+		auto const size(vec.size());
+		auto const words(vec.word_begin());
+		std::size_t pos(0);
+		
+		while (pos < size)
+		{
+			bool const flag((words[pos / word_bits] >> (pos % word_bits)) & 0x1);
+			std::size_t length(0);
+			while (pos < size)
+			{
+				auto const bit_idx(pos % word_bits);
+				auto const valid_bits(std::min(word_bits - bit_idx, size - pos));
+				word_type const word(words[pos / word_bits] >> bit_idx);
+				word_type const stop_mask(flag ? word_type(~word) : word);
+				std::size_t const count(
+					stop_mask
+					? std::min <std::size_t>(__builtin_ctzll(static_cast <unsigned long long>(stop_mask)), valid_bits)
+					: valid_bits
+				);
+				
+				length += count;
+				pos += count;
+				if (count < valid_bits)
+					break;
+			}
+			
+			fn(flag, length);
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_GUIDE_TREE_HH
+#define TEXT_ALIGN_GUIDE_TREE_HH
+
+#include <cstdint>
+#include <libbio/assert.hh>
+#include <limits>
+#include <vector>
+
+
+namespace text_align {
+	
+	// Rooted binary tree that determines the order of the pairwise alignments in a progressive
+	// multiple alignment. The leaves are numbered 0, …, leaf_count - 1 and the internal node i
+	// has the number leaf_count + i. The children of each internal node precede it.
+	class guide_tree
+	{
+	public:
+		struct node
+		{
+			std::size_t	lhs{};
+			std::size_t	rhs{};
+		};
+	
+	protected:
+		std::vector <node>	m_nodes;
+		std::size_t			m_leaf_count{};
+	
+	public:
+		guide_tree() = default;
+		
+		std::size_t leaf_count() const { return m_leaf_count; }
+		std::size_t node_count() const { return m_leaf_count + m_nodes.size(); }
+		std::size_t root() const { libbio_assert(m_leaf_count); return node_count() - 1; }
+		bool is_leaf(std::size_t const idx) const { return idx < m_leaf_count; }
+		node const &internal_node(std::size_t const idx) const { libbio_assert(!is_leaf(idx)); return m_nodes[idx - m_leaf_count]; }
+		std::vector <node> const &internal_nodes() const { return m_nodes; }
+		
+		// Build the tree with UPGMA, i.e. join the most similar clusters and use the average
+		// similarity of their members to the others. similarity(lhs_idx, rhs_idx) is called
+		// once for each pair of leaves. Uses quadratic space and cubic time.
+		template <typename t_similarity_fn>
+		void build_upgma(std::size_t const leaf_count, t_similarity_fn &&similarity);
+	};
+	
+	
+	template <typename t_similarity_fn>
+	void guide_tree::build_upgma(std::size_t const leaf_count, t_similarity_fn &&similarity)
+	{
+		libbio_always_assert(0 < leaf_count);
+		
+		m_nodes.clear();
+		m_leaf_count = leaf_count;
+		m_nodes.reserve(leaf_count - 1);
+		
+		// Similarities of the clusters, the nodes that represent them and their sizes.
+		// The slot of the lesser index is reused for the joined cluster.
+		std::vector <double> similarities(leaf_count * leaf_count, 0);
+		std::vector <std::size_t> cluster_nodes(leaf_count);
+		std::vector <std::size_t> cluster_sizes(leaf_count, 1);
+		std::vector <std::size_t> active_clusters(leaf_count);
+		for (std::size_t i(0); i < leaf_count; ++i)
+		{
+			cluster_nodes[i] = i;
+			active_clusters[i] = i;
+			for (std::size_t j(0); j < i; ++j)
+			{
+				double const value(similarity(i, j));
+				similarities[i * leaf_count + j] = value;
+				similarities[j * leaf_count + i] = value;
+			}
+		}
+		
+		while (1 < active_clusters.size())
+		{
+			// Find the most similar pair.
+			std::size_t best_i(0);
+			std::size_t best_j(1);
+			double best_value(-std::numeric_limits <double>::infinity());
+			for (std::size_t i(0), count(active_clusters.size()); i < count; ++i)
+			{
+				for (std::size_t j(i + 1); j < count; ++j)
+				{
+					auto const value(similarities[active_clusters[i] * leaf_count + active_clusters[j]]);
+					if (best_value < value)
+					{
+						best_value = value;
+						best_i = i;
+						best_j = j;
+					}
+				}
+			}
+			
+			// Join.
+			auto const lhs(active_clusters[best_i]);
+			auto const rhs(active_clusters[best_j]);
+			auto const lhs_size(cluster_sizes[lhs]);
+			auto const rhs_size(cluster_sizes[rhs]);
+			for (auto const other : active_clusters)
+			{
+				if (other == lhs || other == rhs)
+					continue;
+				
+				auto const value(
+					(lhs_size * similarities[lhs * leaf_count + other] + rhs_size * similarities[rhs * leaf_count + other]) /
+					(lhs_size + rhs_size)
+				);
+				similarities[lhs * leaf_count + other] = value;
+				similarities[other * leaf_count + lhs] = value;
+			}
+			
+			m_nodes.push_back(node{cluster_nodes[lhs], cluster_nodes[rhs]});
+			cluster_nodes[lhs] = leaf_count + m_nodes.size() - 1;
+			cluster_sizes[lhs] = lhs_size + rhs_size;
+			active_clusters.erase(active_clusters.begin() + best_j);
+		}
+	}
+}
+
+#endif
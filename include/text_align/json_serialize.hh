@@ -11,7 +11,10 @@
 #include <iostream>
 #include <iterator>
 #include <libbio/rle_bit_vector.hh>
+#include <sstream>
 #include <string_view>
+#include <text_align/alignment_operation.hh>
+#include <text_align/json_writer.hh>
 #include <vector>
 
 
@@ -20,9 +23,20 @@ namespace text_align { namespace json {
 	struct serializable
 	{
 		virtual void to_json(std::ostream &stream) const = 0;
+		
+		// Formats with the stream overload by default.
+		virtual inline void to_json(writer &writer) const;
 	};
 	
 	
+	void serializable::to_json(writer &writer) const
+	{
+		std::ostringstream stream;
+		to_json(stream);
+		writer.write(stream.str());
+	}
+	
+	
 	// FIXME: add enable_ifs, vector could also be any sequential container.
 	template <typename t_ptr>
 	void to_json(std::ostream &stream, std::vector <t_ptr> const &nodes)
@@ -44,6 +58,26 @@ namespace text_align { namespace json {
 	}
 	
 	
+	template <typename t_ptr>
+	void to_json(writer &writer, std::vector <t_ptr> const &nodes)
+	{
+		writer.put('[');
+		bool first(true);
+		for (auto const &node_ptr : nodes)
+		{
+			if (first)
+				writer.put('{');
+			else
+				writer.write(", {");
+			
+			node_ptr->to_json(writer);
+			writer.put('}');
+			first = false;
+		}
+		writer.put(']');
+	}
+	
+	
 	template <typename t_count>
 	void to_json(std::ostream &stream, libbio::rle_bit_vector <t_count> const &vec)
 	{
@@ -66,6 +100,47 @@ namespace text_align { namespace json {
 	}
 	
 	
+	template <typename t_count>
+	void to_json(writer &writer, libbio::rle_bit_vector <t_count> const &vec)
+	{
+		writer.write("{\"starts_with_zero\":");
+		writer.write_bool(vec.starts_with_zero());
+		writer.write(",\"runs\":[");
+		
+		bool first(true);
+		for (auto const &val : vec.const_runs())
+		{
+			if (!first)
+				writer.put(',');
+			writer.write_integer(val);
+			first = false;
+		}
+		writer.write("]}");
+	}
+	
+	
+	// Output the runs as an extended CIGAR string.
+	inline void to_json(std::ostream &stream, operation_run_vector const &vec)
+	{
+		stream << '"';
+		for (auto const &run : vec.runs())
+			stream << run.count << operation_character(run.operation);
+		stream << '"';
+	}
+	
+	
+	inline void to_json(writer &writer, operation_run_vector const &vec)
+	{
+		writer.put('"');
+		for (auto const &run : vec.runs())
+		{
+			writer.write_integer(run.count);
+			writer.put(operation_character(run.operation));
+		}
+		writer.put('"');
+	}
+	
+	
 	template <typename t_input_it>
 	void escape_string(std::ostream &ostream, t_input_it it, t_input_it end)
 	{
@@ -84,7 +159,7 @@ namespace text_align { namespace json {
 				default:
 				{
 					if (0x00 <= c && c <= 0x1f)
-						ostream << std::hex << std::setw(4) << std::setfill('0') << +c;
+						ostream << "\\u" << std::hex << std::setw(4) << std::setfill('0') << +c << std::dec;
 					else
 					{
 						std::ostream_iterator <char> it(ostream);
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_JSON_WRITER_HH
+#define TEXT_ALIGN_JSON_WRITER_HH
+
+#include <charconv>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#	include <emmintrin.h>
+#endif
+
+
+namespace text_align { namespace json {
+	
+	// Write JSON to a contiguous buffer. Strings of char are treated as UTF-8 and
+	// copied in spans between the characters that need to be escaped; other
+	// character types are treated as code points and encoded to UTF-8.
+	class writer
+	{
+	public:
+		typedef std::string	buffer_type;
+		
+	protected:
+		buffer_type	m_buffer;
+		
+	protected:
+		static inline std::size_t find_escaped_character(char const *data, std::size_t const size);
+		static bool needs_escape(std::uint32_t const c) { return c < 0x20 || '"' == c || '\\' == c; }
+		inline void write_escape(std::uint32_t const c);
+		inline void write_code_point(std::uint32_t const c);
+		
+	public:
+		buffer_type const &buffer() const { return m_buffer; }
+		buffer_type &buffer() { return m_buffer; }
+		char const *data() const { return m_buffer.data(); }
+		std::size_t size() const { return m_buffer.size(); }
+		void clear() { m_buffer.clear(); }
+		void reserve(std::size_t const size) { m_buffer.reserve(size); }
+		
+		void put(char const c) { m_buffer.push_back(c); }
+		void write(std::string_view const sv) { m_buffer.append(sv); }
+		void write_bool(bool const val) { write(val ? "true" : "false"); }
+		
+		template <typename t_integer>
+		void write_integer(t_integer const val);
+		
+		// Write the contents of a JSON string without the quotation marks.
+		inline void write_escaped(std::string_view const sv);
+		
+		template <typename t_iterator, typename t_end>
+		void write_escaped(t_iterator it, t_end const end);
+		
+		template <typename t_range>
+		void write_string(t_range const &range);
+		
+		inline void write_string(char const *str) { write_string(std::string_view(str)); }
+		
+		// Write "key": "value".
+		template <typename t_value>
+		void write_key_value(std::string_view const key, t_value const &val);
+	};
+	
+	
+	std::size_t writer::find_escaped_character(char const *data, std::size_t const size)
+	{
+		std::size_t i(0);
+		
+#if defined(__SSE2__)
+		// Compare 16 bytes at a time.
+		auto const quote(_mm_set1_epi8('"'));
+		auto const backslash(_mm_set1_epi8('\\'));
+		auto const control_max(_mm_set1_epi8(0x1f));
+		while (i + 16 <= size)
+		{
+			auto const chars(_mm_loadu_si128(reinterpret_cast <__m128i const *>(data + i)));
+			auto const is_control(_mm_cmpeq_epi8(_mm_min_epu8(chars, control_max), chars));
+			auto const is_special(_mm_or_si128(_mm_cmpeq_epi8(chars, quote), _mm_cmpeq_epi8(chars, backslash)));
+			auto const mask(_mm_movemask_epi8(_mm_or_si128(is_control, is_special)));
+			if (mask)
+				return i + __builtin_ctz(mask);
+			i += 16;
+		}
+#endif
+		
+		for (; i < size; ++i)
+		{
+			if (needs_escape(static_cast <unsigned char>(data[i])))
+				return i;
+		}
+		return size;
+	}
+	
+	
+	void writer::write_escape(std::uint32_t const c)
+	{
+		switch (c)
+		{
+			case '"':	write("\\\""); break;
+			case '\\':	write("\\\\"); break;
+			case '\b':	write("\\b"); break;
+			case '\f':	write("\\f"); break;
+			case '\n':	write("\\n"); break;
+			case '\r':	write("\\r"); break;
+			case '\t':	write("\\t"); break;
+			default:
+			{
+				char const *hex("0123456789abcdef");
+				char const buffer[6]{'\\', 'u', '0', '0', hex[(c >> 4) & 0xf], hex[c & 0xf]};
+				m_buffer.append(buffer, 6);
+			}
+		}
+	}
+	
+	
+	void writer::write_code_point(std::uint32_t const c)
+	{
+		if (c < 0x80)
+		{
+			if (needs_escape(c))
+				write_escape(c);
+			else
+				m_buffer.push_back(char(c));
+		}
+		else if (c < 0x800)
+		{
+			char const buffer[2]{char(0xc0 | (c >> 6)), char(0x80 | (c & 0x3f))};
+			m_buffer.append(buffer, 2);
+		}
+		else if (c < 0x10000)
+		{
+			char const buffer[3]{char(0xe0 | (c >> 12)), char(0x80 | ((c >> 6) & 0x3f)), char(0x80 | (c & 0x3f))};
+			m_buffer.append(buffer, 3);
+		}
+		else
+		{
+			char const buffer[4]{
+				char(0xf0 | ((c >> 18) & 0x7)),
+				char(0x80 | ((c >> 12) & 0x3f)),
+				char(0x80 | ((c >> 6) & 0x3f)),
+				char(0x80 | (c & 0x3f))
+			};
+			m_buffer.append(buffer, 4);
+		}
+	}
+	
+	
+	template <typename t_integer>
+	void writer::write_integer(t_integer const val)
+	{
+		char buffer[24];
+		auto const res(std::to_chars(buffer, buffer + sizeof(buffer), val));
+		m_buffer.append(buffer, res.ptr);
+	}
+	
+	
+	void writer::write_escaped(std::string_view const sv)
+	{
+		auto const *data(sv.data());
+		auto const size(sv.size());
+		std::size_t i(0);
+		while (i < size)
+		{
+			auto const count(find_escaped_character(data + i, size - i));
+			m_buffer.append(data + i, count);
+			i += count;
+			
+			if (i < size)
+			{
+				write_escape(static_cast <unsigned char>(data[i]));
+				++i;
+			}
+		}
+	}
+	
+	
+	template <typename t_iterator, typename t_end>
+	void writer::write_escaped(t_iterator it, t_end const end)
+	{
+		typedef std::decay_t <decltype(*it)> character_type;
+		if constexpr (std::is_same_v <character_type, char>)
+		{
+			if constexpr (std::is_pointer_v <t_iterator> && std::is_same_v <t_iterator, t_end>)
+			{
+				write_escaped(std::string_view(it, end - it));
+				return;
+			}
+		}
+		
+		if constexpr (std::is_base_of_v <std::random_access_iterator_tag, typename std::iterator_traits <t_iterator>::iterator_category>)
+			m_buffer.reserve(m_buffer.size() + (end - it));
+		
+		for (; it != end; ++it)
+		{
+			if constexpr (std::is_same_v <character_type, char>)
+			{
+				// Pass the UTF-8 code units through.
+				auto const c(*it);
+				if (needs_escape(static_cast <unsigned char>(c)))
+					write_escape(static_cast <unsigned char>(c));
+				else
+					m_buffer.push_back(c);
+			}
+			else
+			{
+				write_code_point(static_cast <std::uint32_t>(*it));
+			}
+		}
+	}
+	
+	
+	template <typename t_range>
+	void writer::write_string(t_range const &range)
+	{
+		m_buffer.push_back('"');
+		if constexpr (std::is_convertible_v <t_range const &, std::string_view>)
+			write_escaped(std::string_view(range));
+		else
+			write_escaped(range.begin(), range.end());
+		m_buffer.push_back('"');
+	}
+	
+	
+	template <typename t_value>
+	void writer::write_key_value(std::string_view const key, t_value const &val)
+	{
+		write_string(key);
+		write(": ");
+		write_string(val);
+	}
+}}
+
+#endif
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_MULTIPLE_ALIGNMENT_GRAPH_BUILDER_HH
+#define TEXT_ALIGN_MULTIPLE_ALIGNMENT_GRAPH_BUILDER_HH
+
+#include <libbio/assert.hh>
+#include <libbio/int_vector.hh>
+#include <text_align/alignment_graph_builder.hh>
+#include <text_align/gap_runs.hh>
+#include <utility>
+#include <vector>
+
+
+namespace text_align { namespace alignment_graph {
+	
+	// Segment in which the texts of a multiple alignment differ. Contains the characters of each text.
+	template <typename t_character>
+	class multiple_distinct_node final : public node_base
+	{
+	public:
+		typedef t_character						character_type;
+		typedef std::vector <character_type>	vector_type;
+	
+	protected:
+		std::vector <vector_type>				m_texts;
+	
+	public:
+		multiple_distinct_node(std::size_t const text_count):
+			m_texts(text_count)
+		{
+		}
+		
+		static constexpr enum node_type node_type() { return node_type::MULTIPLE_DISTINCT; }
+		virtual enum node_type type() const override { return this->node_type(); }
+		void add_character(std::size_t const text_idx, character_type const c) { m_texts[text_idx].push_back(c); }
+		template <typename t_iterator> void add_characters(std::size_t const text_idx, t_iterator first, t_iterator last) { m_texts[text_idx].insert(m_texts[text_idx].end(), first, last); }
+		std::vector <vector_type> const &texts() const { return m_texts; }
+		virtual void to_json(std::ostream &stream) const override;
+		virtual void to_json(json::writer &writer) const override;
+		virtual void visit(node_visitor &visitor) override { visitor.visit_multiple_distinct_node(*this); }
+	};
+}}
+
+
+namespace text_align { namespace alignment_graph {
+	
+	template <typename t_character>
+	void multiple_distinct_node <t_character>::to_json(std::ostream &stream) const
+	{
+		json::write(stream, "type", "multiple_distinct");
+		stream << ", \"texts\": [";
+		bool first(true);
+		for (auto const &text : m_texts)
+		{
+			if (!first)
+				stream << ", ";
+			stream << '"';
+			json::escape_string(stream, text);
+			stream << '"';
+			first = false;
+		}
+		stream << ']';
+	}
+	
+	
+	template <typename t_character>
+	void multiple_distinct_node <t_character>::to_json(json::writer &writer) const
+	{
+		writer.write_key_value("type", "multiple_distinct");
+		writer.write(", \"texts\": [");
+		bool first(true);
+		for (auto const &text : m_texts)
+		{
+			if (!first)
+				writer.write(", ");
+			writer.write_string(text);
+			first = false;
+		}
+		writer.put(']');
+	}
+}}
+
+
+namespace text_align {
+	
+	// Build a graph of common and distinct segments from a multiple alignment given as a gap vector
+	// for each text. All texts need to have a character in a column for it to be common.
+	template <typename t_character>
+	class multiple_alignment_graph_builder final : public alignment_graph_builder_base
+	{
+	public:
+		typedef t_character													character_type;
+		typedef alignment_graph::common_node <character_type>				common_node_type;
+		typedef alignment_graph::multiple_distinct_node <character_type>	distinct_node_type;
+	
+	protected:
+		// Position in a text and in its gap vector.
+		struct row_cursor
+		{
+			std::vector <std::pair <bool, std::size_t>>	gap_runs;
+			std::size_t									run_idx{};
+			std::size_t									remaining{};
+			std::size_t									text_idx{};
+		};
+	
+	protected:
+		// Typed pointers to m_current_segment, at most one of which is non-null.
+		common_node_type	*m_current_common{};
+		distinct_node_type	*m_current_distinct{};
+	
+	protected:
+		inline common_node_type &common_segment();
+		inline distinct_node_type &distinct_segment(std::size_t const text_count);
+		inline void end_segment();
+	
+	public:
+		template <typename t_text>
+		void build_graph(
+			std::vector <t_text> const &texts,
+			std::vector <libbio::bit_vector> const &gaps
+		);
+	};
+	
+	
+	// Walk the gap vectors one column at a time.
+	template <typename t_character>
+	template <typename t_text>
+	void multiple_alignment_graph_builder <t_character>::build_graph(
+		std::vector <t_text> const &texts,
+		std::vector <libbio::bit_vector> const &gaps
+	)
+	{
+		libbio_always_assert(texts.size() == gaps.size());
+		if (texts.empty())
+			return;
+		
+		auto const text_count(texts.size());
+		auto const column_count(gaps.front().size());
+		std::vector <row_cursor> cursors(text_count);
+		for (std::size_t i(0); i < text_count; ++i)
+		{
+			auto &cursor(cursors[i]);
+			libbio_always_assert(gaps[i].size() == column_count);
+			for_each_bit_run(gaps[i], [&cursor](bool const is_gap, std::size_t const length){
+				cursor.gap_runs.emplace_back(is_gap, length);
+			});
+			if (!cursor.gap_runs.empty())
+				cursor.remaining = cursor.gap_runs.front().second;
+		}
+		
+		// Characters of the current column and whether each text has a gap in it.
+		std::vector <character_type> column(text_count);
+		std::vector <bool> column_gaps(text_count);
+		for (std::size_t col(0); col < column_count; ++col)
+		{
+			bool is_common(true);
+			for (std::size_t i(0); i < text_count; ++i)
+			{
+				auto &cursor(cursors[i]);
+				while (!cursor.remaining)
+					cursor.remaining = cursor.gap_runs[++cursor.run_idx].second;
+				--cursor.remaining;
+				
+				column_gaps[i] = cursor.gap_runs[cursor.run_idx].first;
+				if (column_gaps[i])
+					is_common = false;
+				else
+				{
+					libbio_always_assert(cursor.text_idx < texts[i].size());
+					column[i] = texts[i][cursor.text_idx++];
+					if (0 < i && is_common && !libbio::is_equal(column[0], column[i]))
+						is_common = false;
+				}
+			}
+			
+			if (is_common)
+				common_segment().add_character(column[0]);
+			else
+			{
+				auto &node(distinct_segment(text_count));
+				for (std::size_t i(0); i < text_count; ++i)
+				{
+					if (!column_gaps[i])
+						node.add_character(i, column[i]);
+				}
+			}
+		}
+		
+		end_segment();
+	}
+	
+	
+	template <typename t_character>
+	auto multiple_alignment_graph_builder <t_character>::common_segment() -> common_node_type &
+	{
+		if (!m_current_common)
+		{
+			end_segment();
+			m_current_common = new common_node_type();
+			m_current_segment.reset(m_current_common);
+		}
+		return *m_current_common;
+	}
+	
+	
+	template <typename t_character>
+	auto multiple_alignment_graph_builder <t_character>::distinct_segment(std::size_t const text_count) -> distinct_node_type &
+	{
+		if (!m_current_distinct)
+		{
+			end_segment();
+			m_current_distinct = new distinct_node_type(text_count);
+			m_current_segment.reset(m_current_distinct);
+		}
+		return *m_current_distinct;
+	}
+	
+	
+	template <typename t_character>
+	void multiple_alignment_graph_builder <t_character>::end_segment()
+	{
+		end_current_segment();
+		m_current_common = nullptr;
+		m_current_distinct = nullptr;
+	}
+}
+
+#endif
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_PAIR_SCORE_FILE_HH
+#define TEXT_ALIGN_PAIR_SCORE_FILE_HH
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <libbio/assert.hh>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+
+namespace text_align {
+	
+	// Memory-mapped strictly lower triangular matrix of the scores of the pairs of a collection of texts.
+	// A bitmap of the completed pairs is stored before the scores, so an interrupted computation may be
+	// resumed by opening the file again with the same text count and fingerprint. The fingerprint should
+	// identify the texts and the scoring parameters, e.g. by hashing them.
+	template <typename t_score>
+	class pair_score_file
+	{
+	protected:
+		struct header
+		{
+			char			magic[8]{'T', 'A', 'P', 'A', 'I', 'R', 'S', '\0'};
+			std::uint32_t	version{2};
+			std::uint32_t	score_size{sizeof(t_score)};
+			std::uint64_t	text_count{};
+			std::uint64_t	fingerprint{};
+		};
+	
+	protected:
+		void			*m_data{};
+		std::size_t		m_size{};
+		std::size_t		m_text_count{};
+		std::uint64_t	m_fingerprint{};
+		std::uint64_t	*m_completed{};	// Bitmap.
+		t_score			*m_scores{};
+		int				m_fd{-1};
+	
+	public:
+		pair_score_file() = default;
+		~pair_score_file() { close(); }
+		
+		pair_score_file(pair_score_file const &) = delete;
+		pair_score_file &operator=(pair_score_file const &) = delete;
+		
+		// Open the file, or create it if it does not exist or was made for different texts.
+		void open(std::string const &path, std::size_t const text_count, std::uint64_t const fingerprint);
+		void close();
+		
+		// Write the mapped pages to the file, asynchronously if should_wait is false.
+		void sync(bool const should_wait = true);
+		
+		bool is_open() const { return nullptr != m_data; }
+		std::size_t text_count() const { return m_text_count; }
+		std::uint64_t fingerprint() const { return m_fingerprint; }
+		std::size_t pair_count() const { return m_text_count * (m_text_count - 1) / 2; }
+		std::size_t completed_count() const;
+		
+		static inline std::size_t pair_index(std::size_t lhs_idx, std::size_t rhs_idx);
+		
+		bool is_completed(std::size_t const lhs_idx, std::size_t const rhs_idx) const;
+		t_score score(std::size_t const lhs_idx, std::size_t const rhs_idx) const { return m_scores[pair_index(lhs_idx, rhs_idx)]; }
+		
+		// Store the score and then mark the pair completed. Not thread-safe.
+		void set_score(std::size_t const lhs_idx, std::size_t const rhs_idx, t_score const score);
+	
+	protected:
+		static std::size_t bitmap_words(std::size_t const text_count) { return (text_count * (text_count - 1) / 2 + 63) / 64; }
+		static std::size_t scores_offset(std::size_t const text_count) { return sizeof(header) + sizeof(std::uint64_t) * bitmap_words(text_count); }
+		[[noreturn]] static void throw_error(char const *message);
+	};
+	
+	
+	template <typename t_score>
+	void pair_score_file <t_score>::throw_error(char const *message)
+	{
+		throw std::runtime_error(std::string(message) + ": " + std::strerror(errno));
+	}
+	
+	
+	template <typename t_score>
+	std::size_t pair_score_file <t_score>::pair_index(std::size_t lhs_idx, std::size_t rhs_idx)
+	{
+		libbio_assert(lhs_idx != rhs_idx);
+		if (lhs_idx < rhs_idx)
+			std::swap(lhs_idx, rhs_idx);
+		
+		// Row lhs_idx has lhs_idx elements.
+		return lhs_idx * (lhs_idx - 1) / 2 + rhs_idx;
+	}
+	
+	
+	template <typename t_score>
+	void pair_score_file <t_score>::open(std::string const &path, std::size_t const text_count, std::uint64_t const fingerprint)
+	{
+		libbio_always_assert(1 < text_count);
+		close();
+		
+		m_fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+		if (-1 == m_fd)
+			throw_error("Unable to open the score file");
+		
+		auto const size(scores_offset(text_count) + sizeof(t_score) * text_count * (text_count - 1) / 2);
+		
+		// Check whether the file can be resumed.
+		header const expected;
+		header existing;
+		bool can_resume(false);
+		{
+			struct stat sb;
+			if (-1 == ::fstat(m_fd, &sb))
+				throw_error("Unable to stat the score file");
+			
+			if (std::size_t(sb.st_size) == size && sizeof(header) == ::pread(m_fd, &existing, sizeof(header), 0))
+			{
+				can_resume = (
+					0 == std::memcmp(existing.magic, expected.magic, sizeof(expected.magic)) &&
+					existing.version == expected.version &&
+					existing.score_size == expected.score_size &&
+					existing.text_count == text_count &&
+					existing.fingerprint == fingerprint
+				);
+			}
+		}
+		
+		// Zero-fill a new file.
+		if (!can_resume)
+		{
+			if (-1 == ::ftruncate(m_fd, 0) || -1 == ::ftruncate(m_fd, size))
+				throw_error("Unable to resize the score file");
+		}
+		
+		m_data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+		if (MAP_FAILED == m_data)
+		{
+			m_data = nullptr;
+			throw_error("Unable to map the score file");
+		}
+		
+		m_size = size;
+		m_text_count = text_count;
+		m_fingerprint = fingerprint;
+		m_completed = reinterpret_cast <std::uint64_t *>(static_cast <char *>(m_data) + sizeof(header));
+		m_scores = reinterpret_cast <t_score *>(static_cast <char *>(m_data) + scores_offset(text_count));
+		
+		if (!can_resume)
+		{
+			header hh;
+			hh.text_count = text_count;
+			hh.fingerprint = fingerprint;
+			std::memcpy(m_data, &hh, sizeof(header));
+		}
+	}
+	
+	
+	template <typename t_score>
+	void pair_score_file <t_score>::close()
+	{
+		if (m_data)
+		{
+			::munmap(m_data, m_size);
+			m_data = nullptr;
+			m_completed = nullptr;
+			m_scores = nullptr;
+			m_size = 0;
+			m_text_count = 0;
+			m_fingerprint = 0;
+		}
+		
+		if (-1 != m_fd)
+		{
+			::close(m_fd);
+			m_fd = -1;
+		}
+	}
+	
+	
+	template <typename t_score>
+	void pair_score_file <t_score>::sync(bool const should_wait)
+	{
+		if (m_data && -1 == ::msync(m_data, m_size, should_wait ? MS_SYNC : MS_ASYNC))
+			throw_error("Unable to write the score file");
+	}
+	
+	
+	template <typename t_score>
+	std::size_t pair_score_file <t_score>::completed_count() const
+	{
+		std::size_t retval(0);
+		for (std::size_t i(0), count(bitmap_words(m_text_count)); i < count; ++i)
+			retval += __builtin_popcountll(m_completed[i]);
+		return retval;
+	}
+	
+	
+	template <typename t_score>
+	bool pair_score_file <t_score>::is_completed(std::size_t const lhs_idx, std::size_t const rhs_idx) const
+	{
+		auto const idx(pair_index(lhs_idx, rhs_idx));
+		return (m_completed[idx / 64] >> (idx % 64)) & 0x1;
+	}
+	
+	
+	template <typename t_score>
+	void pair_score_file <t_score>::set_score(std::size_t const lhs_idx, std::size_t const rhs_idx, t_score const score)
+	{
+		auto const idx(pair_index(lhs_idx, rhs_idx));
+		m_scores[idx] = score;
+		m_completed[idx / 64] |= (std::uint64_t(1) << (idx % 64));
+	}
+}
+
+#endif
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_QGRAM_FILTER_HH
+#define TEXT_ALIGN_QGRAM_FILTER_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <libbio/assert.hh>
+#include <limits>
+#include <text_align/anchors.hh>
+#include <unordered_map>
+#include <vector>
+
+
+namespace text_align {
+	
+	// Multiset of the hashes of the q-grams of a text.
+	class qgram_profile
+	{
+	protected:
+		std::unordered_map <std::uint64_t, std::uint32_t>	m_counts;
+		std::size_t											m_text_length{};
+		std::size_t											m_qgram_length{};
+	
+	public:
+		qgram_profile() = default;
+		
+		template <typename t_range>
+		qgram_profile(t_range const &text, std::size_t const qgram_length)
+		{
+			assign(text, qgram_length);
+		}
+		
+		std::size_t text_length() const { return m_text_length; }
+		std::size_t qgram_length() const { return m_qgram_length; }
+		
+		template <typename t_range>
+		void assign(t_range const &text, std::size_t const qgram_length);
+		
+		// Size of the multiset intersection. Hash collisions may only increase the count.
+		std::size_t count_common(qgram_profile const &other) const;
+	};
+	
+	
+	// By the q-gram lemma, each edit operation affects at most q of the q-grams of either text.
+	inline std::size_t edit_distance_lower_bound(
+		std::size_t const lhs_len,
+		std::size_t const rhs_len,
+		std::size_t const common_qgrams,
+		std::size_t const qgram_length
+	);
+	
+	// Upper bound for the score of a global alignment with at least min_edits mismatches and gap positions.
+	// If the scores do not penalize the edit operations, return the maximum value of t_score.
+	template <typename t_score>
+	t_score alignment_score_upper_bound(
+		std::size_t const lhs_len,
+		std::size_t const rhs_len,
+		std::size_t const min_edits,
+		t_score const identity_score,
+		t_score const mismatch_penalty,
+		t_score const gap_start_penalty,
+		t_score const gap_penalty
+	);
+	
+	
+	template <typename t_range>
+	void qgram_profile::assign(t_range const &text, std::size_t const qgram_length)
+	{
+		libbio_always_assert(0 < qgram_length);
+		
+		m_counts.clear();
+		m_text_length = 0;
+		m_qgram_length = qgram_length;
+		
+		// Polynomial rolling hash mod 2^64 over a ring buffer of the last q characters.
+		std::uint64_t const base(0x100000001b3ULL);
+		std::uint64_t top_power(1);
+		for (std::size_t i(1); i < qgram_length; ++i)
+			top_power *= base;
+		
+		std::vector <std::uint64_t> window(qgram_length, 0);
+		std::uint64_t rolling(0);
+		
+		// The end iterator may have a different type from that of begin.
+		auto it(text.begin());
+		auto const end(text.end());
+		for (; it != end; ++it)
+		{
+			std::uint64_t const c(*it);
+			auto &slot(window[m_text_length % qgram_length]);
+			if (qgram_length <= m_text_length)
+				rolling -= slot * top_power;
+			rolling = rolling * base + c;
+			slot = c;
+			++m_text_length;
+			
+			if (qgram_length <= m_text_length)
+				++m_counts[detail::mix_hash(rolling)];
+		}
+	}
+	
+	
+	inline std::size_t qgram_profile::count_common(qgram_profile const &other) const
+	{
+		libbio_assert(m_qgram_length == other.m_qgram_length);
+		
+		// Iterate the smaller map.
+		auto const &lhs(m_counts.size() <= other.m_counts.size() ? m_counts : other.m_counts);
+		auto const &rhs(m_counts.size() <= other.m_counts.size() ? other.m_counts : m_counts);
+		std::size_t retval(0);
+		for (auto const &[hash, count] : lhs)
+		{
+			auto const it(rhs.find(hash));
+			if (rhs.end() != it)
+				retval += std::min(count, it->second);
+		}
+		return retval;
+	}
+	
+	
+	std::size_t edit_distance_lower_bound(
+		std::size_t const lhs_len,
+		std::size_t const rhs_len,
+		std::size_t const common_qgrams,
+		std::size_t const qgram_length
+	)
+	{
+		libbio_assert(0 < qgram_length);
+		
+		auto const max_len(std::max(lhs_len, rhs_len));
+		auto const length_difference(max_len - std::min(lhs_len, rhs_len));
+		
+		// The longer text has max_len - q + 1 q-grams, of which at least that minus kq are shared.
+		if (max_len < qgram_length || max_len - qgram_length + 1 <= common_qgrams)
+			return length_difference;
+		
+		auto const missing(max_len - qgram_length + 1 - common_qgrams);
+		return std::max(length_difference, (missing + qgram_length - 1) / qgram_length);
+	}
+	
+	
+	template <typename t_score>
+	t_score alignment_score_upper_bound(
+		std::size_t const lhs_len,
+		std::size_t const rhs_len,
+		std::size_t const min_edits,
+		t_score const identity_score,
+		t_score const mismatch_penalty,
+		t_score const gap_start_penalty,
+		t_score const gap_penalty
+	)
+	{
+		if (! (0 <= identity_score && mismatch_penalty <= 0 && gap_start_penalty <= 0 && gap_penalty <= 0))
+			return std::numeric_limits <t_score>::max();
+		
+		// With M matches and E edit operations, lhs_len + rhs_len >= 2M + E. Each edit operation
+		// scores at most the greater of the penalties.
+		auto const total_len(lhs_len + rhs_len);
+		auto const edits(std::min(min_edits, total_len));
+		auto const max_matches(std::min({lhs_len, rhs_len, (total_len - edits) / 2}));
+		auto const max_penalty(std::max(mismatch_penalty, gap_penalty));
+		t_score retval(t_score(max_matches) * identity_score + t_score(edits) * max_penalty);
+		
+		// Texts of different lengths need at least one gap.
+		if (lhs_len != rhs_len)
+			retval += gap_start_penalty;
+		
+		return retval;
+	}
+}
+
+#endif
@@ -8,17 +8,29 @@
 
 #include <libbio/algorithm.hh>
 
+#include <algorithm>
 #include <atomic>
 #include <boost/asio.hpp>
+#include <chrono>
+#include <functional>
 #include <libbio/int_vector.hh>
 #include <libbio/matrix.hh>
+#include <limits>
 #include <memory>
 #include <range/v3/all.hpp>
+#include <stdexcept>
+#include <text_align/alignment_operation.hh>
+#include <text_align/cancellation_token.hh>
+#include <text_align/common_affix.hh>
+#include <text_align/qgram_filter.hh>
 #include <text_align/smith_waterman/aligner_base.hh>
 #include <text_align/smith_waterman/aligner_data.hh>
 #include <text_align/smith_waterman/aligner_impl.hh>
 #include <text_align/smith_waterman/aligner_parameters.hh>
 #include <text_align/smith_waterman/aligner_sample.hh>
+#include <text_align/smith_waterman/aligner_trimmed_impl.hh>
+#include <text_align/smith_waterman/sample_matrix.hh>
+#include <text_align/unique_function.hh>
 
 // FIXME: move to a compatibility header.
 #include <experimental/type_traits>
@@ -38,9 +50,12 @@ namespace text_align { namespace smith_waterman {
 	public:
 		typedef t_delegate								delegate_type;
 		typedef boost::asio::io_context					context_type;
+		typedef unique_function <void(aligner &)>		completion_handler_type;
+		typedef std::chrono::steady_clock				clock_type;
 
 	protected:
 		typedef aligner_base::arrow_type arrow_type;
+		typedef aligner_base::status_type status_type;
 		
 		static constexpr t_score const SCORE_MIN = std::numeric_limits <t_score>::min();
 
@@ -48,8 +63,8 @@ namespace text_align { namespace smith_waterman {
 		typedef t_score										score_type;
 		typedef std::vector <score_type>					score_vector;
 		typedef libbio::matrix <score_type>					score_matrix;
+		typedef detail::sample_matrix <score_type>			score_sample_matrix;
 		typedef libbio::packed_matrix <2, word_type>		traceback_matrix;
-		typedef libbio::packed_matrix <2, word_type>		gap_start_position_matrix;
 		typedef libbio::packed_matrix <1, word_type>		flag_matrix;
 
 		typedef detail::aligner_impl_base <aligner>			impl_base_type;
@@ -61,14 +76,26 @@ namespace text_align { namespace smith_waterman {
 		context_type										*m_ctx{nullptr};
 		t_delegate											*m_delegate{nullptr};
 		std::unique_ptr <impl_base_type>					m_aligner_impl;
+		completion_handler_type								m_completion_handler;
+		cancellation_token									m_cancellation_token;
+		std::atomic_bool									m_is_cancelled{false};		// Set by cancel(), cleared when an alignment starts.
+		clock_type::time_point								m_deadline{clock_type::time_point::max()};
 		
 		detail::aligner_sample <aligner>					m_lhs; // Vertical vectors.
 		detail::aligner_sample <aligner>					m_rhs; // Horizontal vectors.
 		detail::aligner_parameters <score_type>				m_parameters;
+		detail::aligner_parameters <score_type>				m_retained_parameters;	// Of the alignment whose samples are retained.
 		detail::aligner_data <aligner>						m_data;
 		
 		score_type											m_alignment_score{0};
+		score_type											m_min_score{0};
+		std::size_t											m_prefix_length{0};	// Common prefix not passed to the implementation.
+		std::size_t											m_suffix_length{0};
+		status_type											m_status{status_type::STATUS_NONE};
 		bool												m_reverses_texts{};
+		bool												m_trims_common_affixes{};
+		bool												m_has_min_score{};
+		bool												m_has_retained_samples{};
 		
 	protected:
 		// Delegate member functions.
@@ -78,18 +105,65 @@ namespace text_align { namespace smith_waterman {
 			&t_class::did_calculate_score
 		>;
 		
+		template <typename t_class>
+		using did_fill_block_t = std::integral_constant <
+			void (t_class::*)(aligner_base &, std::size_t, std::size_t),
+			&t_class::did_fill_block
+		>;
+		
+		template <typename t_class>
+		using did_advance_traceback_t = std::integral_constant <
+			void (t_class::*)(aligner_base &, std::size_t, std::size_t),
+			&t_class::did_advance_traceback
+		>;
+		
+		template <typename t_class>
+		using push_operation_t = std::integral_constant <
+			void (t_class::*)(alignment_operation, std::size_t),
+			&t_class::push_operation
+		>;
+		
 		inline void did_calculate_score(std::size_t const row, std::size_t const column, score_result_type const &result, bool const initial);
+		inline void did_fill_block(std::size_t const filled, std::size_t const total);
+		inline void did_advance_traceback(std::size_t const processed, std::size_t const total);
 		inline void push_lhs(bool const flag, std::size_t const count) { this->m_delegate->push_lhs(flag, count); }
 		inline void push_rhs(bool const flag, std::size_t const count) { this->m_delegate->push_rhs(flag, count); }
+		inline void push_operation(alignment_operation const op, std::size_t const count);
 		inline void reverse_gaps() { if (!m_reverses_texts) this->m_delegate->reverse_gaps(); }
+		inline void push_common_run(std::size_t const count);
+		inline void finish_traceback();
 		inline void finish(score_type const final_score);
+		inline void finish_cancelled();
+		void clear_cancellation() { m_is_cancelled.store(false, std::memory_order_relaxed); }
+		inline void finish_below_threshold();
+		inline void call_completion_handler();
+		inline bool should_stop() const;
+		inline bool can_trim_common_affixes() const;
+		inline bool can_prune_blocks(std::size_t const lhs_len, std::size_t const rhs_len) const;
+		inline std::uintmax_t max_sample_step() const;
+		inline bool can_realign(text_edit const &edit, std::size_t const lhs_len, std::size_t const rhs_len) const;
+		
+		void init_parameters(std::size_t const lhs_len, std::size_t const rhs_len);
+		void init_samples();
+		void init_alignment(std::size_t const lhs_len, std::size_t const rhs_len);
+		void init_realignment(
+			text_edit const &edit,
+			std::size_t const lhs_len,
+			std::size_t const rhs_len,
+			std::size_t &lhs_block_idx,
+			std::size_t &rhs_block_idx
+		);
+		void start_alignment(impl_base_type *impl_ptr, std::size_t const lhs_block_idx = 0, std::size_t const rhs_block_idx = 0);
 		
 		template <typename t_lhs, typename t_rhs>
-		void do_align(
+		void do_align(t_lhs const &lhs, t_rhs const &rhs);
+		
+		template <typename t_lhs, typename t_rhs>
+		void do_align_trimmed(
 			t_lhs const &lhs,
 			t_rhs const &rhs,
-			std::size_t const segments_along_y,
-			std::size_t const segments_along_x
+			std::size_t const lhs_len,
+			std::size_t const rhs_len
 		);
 		
 	public:
@@ -112,7 +186,25 @@ namespace text_align { namespace smith_waterman {
 		bool prints_values_converted_to_utf8() const { return m_parameters.prints_values_converted_to_utf8; }
 		std::size_t lhs_size() const { return m_parameters.lhs_length; }
 		std::size_t rhs_size() const { return m_parameters.rhs_length; }
+		std::size_t trimmed_prefix_length() const { return m_prefix_length; }
+		std::size_t trimmed_suffix_length() const { return m_suffix_length; }
 		bool reverses_texts() const { return m_reverses_texts; }
+		bool trims_common_affixes() const { return m_trims_common_affixes; }
+		bool computes_traceback() const { return m_parameters.computes_traceback; }
+		bool records_gap_starts() const { return m_parameters.records_gap_starts; }
+		bool has_min_score() const { return m_has_min_score; }
+		score_type min_score() const { return m_min_score; }
+		bool has_retained_samples() const { return m_has_retained_samples; }
+		std::string const &sample_file_directory() const { return m_lhs.score_samples.file_directory(); }
+		
+		// Optional delegate member functions.
+		static constexpr bool reports_block_progress() { return std::is_detected_v <did_fill_block_t, t_delegate>; }
+		static constexpr bool reports_traceback_progress() { return std::is_detected_v <did_advance_traceback_t, t_delegate>; }
+		static constexpr bool reports_operations() { return std::is_detected_v <push_operation_t, t_delegate>; }
+		
+		status_type status() const override { return m_status; }
+		cancellation_token const &get_cancellation_token() const { return m_cancellation_token; }
+		clock_type::time_point deadline() const { return m_deadline; }
 		
 		context_type &execution_context() { return *m_ctx; }
 		
@@ -125,6 +217,45 @@ namespace text_align { namespace smith_waterman {
 		void set_prints_values_converted_to_utf8(bool const should_print) { m_parameters.prints_values_converted_to_utf8 = should_print; }
 		void set_reverses_texts(bool const flag) { m_reverses_texts = flag; }
 		
+		// Align only the part of the texts that remains after removing the common prefix and suffix.
+		// The score is the same as without trimming but if there are several optimal alignments,
+		// a different one may be returned. Not done if equivalence cannot be guaranteed with the scores.
+		void set_trims_common_affixes(bool const flag) { m_trims_common_affixes = flag; }
+		
+		// Store the score and traceback samples in memory-mapped temporary files in the given directory
+		// instead of memory, starting from the next alignment. Empty for memory.
+		void set_sample_file_directory(std::string const &path) { m_lhs.set_file_directory(path); m_rhs.set_file_directory(path); }
+		
+		// Store the score samples as differences, starting from the next alignment. Decreases the memory
+		// needed for the samples if the differences of the scores of adjacent cells are small.
+		void set_sample_encoding(enum sample_encoding const encoding) { m_lhs.set_encoding(encoding); m_rhs.set_encoding(encoding); }
+		enum sample_encoding sample_encoding() const { return m_lhs.score_samples.encoding(); }
+		
+		// The number of encoded samples that did not fit the encoding in the previous alignment.
+		std::size_t escaped_sample_count() const { return m_lhs.escaped_count() + m_rhs.escaped_count(); }
+		
+		// If false, only the score is calculated and the delegate receives no gaps.
+		void set_computes_traceback(bool const flag) { m_parameters.computes_traceback = flag; }
+		
+		// Record the last gap start position in each row and column of each block while filling the blocks,
+		// so that the traceback of a long gap can skip the blocks in which the gap does not start.
+		// The records are stored like the samples, in two bytes each unless the segments are very long.
+		void set_records_gap_starts(bool const flag) { m_parameters.records_gap_starts = flag; }
+		
+		// Stop with STATUS_BELOW_THRESHOLD instead of producing an alignment with a lower score.
+		// If the scores permit, the blocks through which no path can reach the minimum are not filled.
+		void set_min_score(score_type const score) { m_min_score = score; m_has_min_score = true; }
+		void clear_min_score() { m_has_min_score = false; }
+		
+		// The token is checked between blocks; the alignment is then stopped with STATUS_CANCELLED.
+		// Since a token stays cancelled, a new one needs to be set before the next alignment.
+		void set_cancellation_token(cancellation_token const &token) { m_cancellation_token = token; }
+		
+		// Cancel the alignment in progress. Unlike the token set above, does not affect later alignments.
+		void cancel() { m_is_cancelled.store(true, std::memory_order_relaxed); }
+		void set_deadline(clock_type::time_point const deadline) { m_deadline = deadline; }
+		void clear_deadline() { m_deadline = clock_type::time_point::max(); }
+		
 		template <typename t_lhs, typename t_rhs>
 		void align(t_lhs const &lhs, t_rhs const &rhs);
 		
@@ -136,6 +267,52 @@ namespace text_align { namespace smith_waterman {
 			std::size_t const rhs_len
 		);
 		
+		// Align without blocking; the execution context is run by the caller. The handler is called
+		// with the aligner after the delegate’s finish(). The texts need to stay valid until then.
+		template <typename t_lhs, typename t_rhs, typename t_handler>
+		void align_async(t_lhs const &lhs, t_rhs const &rhs, t_handler &&handler);
+		
+		template <typename t_lhs, typename t_rhs, typename t_handler>
+		void align_async(
+			t_lhs const &lhs,
+			t_rhs const &rhs,
+			std::size_t const lhs_len,
+			std::size_t const rhs_len,
+			t_handler &&handler
+		);
+		
+		// Align the texts after one of the previously aligned texts has been edited. The samples of the blocks
+		// that precede the edit are reused and only the remaining blocks are filled. Falls back to align() if
+		// the samples of the previous alignment were not retained, i.e. it did not finish, the common affixes
+		// were trimmed, the blocks were pruned or the scores or the segment length have been changed since.
+		// A scoring function provided by the delegate is assumed not to have changed.
+		template <typename t_lhs, typename t_rhs>
+		void realign(t_lhs const &lhs, t_rhs const &rhs, text_edit const &edit);
+		
+		template <typename t_lhs, typename t_rhs>
+		void realign(
+			t_lhs const &lhs,
+			t_rhs const &rhs,
+			std::size_t const lhs_len,
+			std::size_t const rhs_len,
+			text_edit const &edit
+		);
+		
+		template <typename t_lhs, typename t_rhs, typename t_handler>
+		void realign_async(
+			t_lhs const &lhs,
+			t_rhs const &rhs,
+			std::size_t const lhs_len,
+			std::size_t const rhs_len,
+			text_edit const &edit,
+			t_handler &&handler
+		);
+		
+		// Upper bound for the alignment score computed from the q-gram profiles of the texts in linear time.
+		// If it is less than the required score, the texts need not be aligned.
+		template <typename t_lhs, typename t_rhs>
+		score_type qgram_score_upper_bound(t_lhs const &lhs, t_rhs const &rhs, std::size_t const qgram_length) const;
+		
 		score_type alignment_score() const { return m_alignment_score; };
 	};
 	
@@ -154,12 +331,260 @@ namespace text_align { namespace smith_waterman {
 	}
 	
 	
+	template <typename t_score, typename t_word, typename t_delegate>
+	void aligner <t_score, t_word, t_delegate>::push_operation(alignment_operation const op, std::size_t const count)
+	{
+		if constexpr (reports_operations())
+			m_delegate->push_operation(op, count);
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_delegate>
+	void aligner <t_score, t_word, t_delegate>::did_fill_block(std::size_t const filled, std::size_t const total)
+	{
+		if constexpr (reports_block_progress())
+			m_delegate->did_fill_block(*this, filled, total);
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_delegate>
+	void aligner <t_score, t_word, t_delegate>::did_advance_traceback(std::size_t const processed, std::size_t const total)
+	{
+		if constexpr (reports_traceback_progress())
+			m_delegate->did_advance_traceback(*this, processed, total);
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_delegate>
+	void aligner <t_score, t_word, t_delegate>::push_common_run(std::size_t const count)
+	{
+		if (count)
+		{
+			push_lhs(0, count);
+			push_rhs(0, count);
+			push_operation(OPERATION_MATCH, count);
+		}
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_delegate>
+	void aligner <t_score, t_word, t_delegate>::finish_traceback()
+	{
+		// The traceback proceeds from the end of the texts, so the common prefix comes last.
+		push_common_run(m_prefix_length);
+		reverse_gaps();
+	}
+	
+	
+	// final_score does not include the trimmed prefix and suffix.
 	template <typename t_score, typename t_word, typename t_delegate>
 	void aligner <t_score, t_word, t_delegate>::finish(score_type const final_score)
 	{
-		m_alignment_score = final_score;
+		m_alignment_score = final_score + score_type(m_prefix_length + m_suffix_length) * m_parameters.identity_score;
+		if (m_has_min_score && m_alignment_score < m_min_score)
+		{
+			finish_below_threshold();
+			return;
+		}
+		
+		if (!m_parameters.computes_traceback)
+			m_delegate->clear_gaps(); // Remove the common suffix.
+		
+		// The samples may be reused if they were calculated from the complete texts.
+		if (m_aligner_impl && 0 == m_prefix_length && 0 == m_suffix_length && !m_parameters.prunes_blocks)
+		{
+			m_retained_parameters = m_parameters;
+			m_has_retained_samples = true;
+		}
+		
+		m_status = status_type::STATUS_FINISHED;
+		m_aligner_impl.reset();
+		m_delegate->finish(*this);
+		call_completion_handler();
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_delegate>
+	void aligner <t_score, t_word, t_delegate>::finish_cancelled()
+	{
+		m_alignment_score = 0;
+		m_status = status_type::STATUS_CANCELLED;
+		m_aligner_impl.reset();
+		m_delegate->clear_gaps(); // Remove a partial traceback.
+		m_delegate->finish(*this);
+		call_completion_handler();
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_delegate>
+	void aligner <t_score, t_word, t_delegate>::finish_below_threshold()
+	{
+		m_alignment_score = 0;
+		m_status = status_type::STATUS_BELOW_THRESHOLD;
 		m_aligner_impl.reset();
+		m_delegate->clear_gaps(); // Remove the common prefix and suffix.
 		m_delegate->finish(*this);
+		call_completion_handler();
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_delegate>
+	void aligner <t_score, t_word, t_delegate>::call_completion_handler()
+	{
+		// Move the handler out first so that it may start another alignment.
+		if (m_completion_handler)
+		{
+			auto handler(std::move(m_completion_handler));
+			m_completion_handler = nullptr;
+			handler(*this);
+		}
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_delegate>
+	bool aligner <t_score, t_word, t_delegate>::should_stop() const
+	{
+		if (m_cancellation_token.is_cancelled() || m_is_cancelled.load(std::memory_order_relaxed))
+			return true;
+		
+		if (clock_type::time_point::max() != m_deadline && m_deadline <= clock_type::now())
+			return true;
+		
+		return false;
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_delegate>
+	template <typename t_lhs, typename t_rhs>
+	auto aligner <t_score, t_word, t_delegate>::qgram_score_upper_bound(
+		t_lhs const &lhs,
+		t_rhs const &rhs,
+		std::size_t const qgram_length
+	) const -> score_type
+	{
+		if constexpr (t_delegate::uses_scoring_function())
+			return std::numeric_limits <score_type>::max();
+		else
+		{
+			qgram_profile const lhs_profile(lhs, qgram_length);
+			qgram_profile const rhs_profile(rhs, qgram_length);
+			auto const lhs_len(lhs_profile.text_length());
+			auto const rhs_len(rhs_profile.text_length());
+			auto const min_edits(edit_distance_lower_bound(lhs_len, rhs_len, lhs_profile.count_common(rhs_profile), qgram_length));
+			return alignment_score_upper_bound(
+				lhs_len,
+				rhs_len,
+				min_edits,
+				m_parameters.identity_score,
+				m_parameters.mismatch_penalty,
+				m_parameters.gap_start_penalty,
+				m_parameters.gap_penalty
+			);
+		}
+	}
+	
+	
+	// The retained samples may be reused if they were calculated with the same parameters and
+	// without a minimum score. An edit that does not match the lengths of the texts is an error.
+	template <typename t_score, typename t_word, typename t_delegate>
+	bool aligner <t_score, t_word, t_delegate>::can_realign(
+		text_edit const &edit,
+		std::size_t const lhs_len,
+		std::size_t const rhs_len
+	) const
+	{
+		if (!m_has_retained_samples || m_has_min_score || 0 == lhs_len || 0 == rhs_len)
+			return false;
+		
+		auto const &prev(m_retained_parameters);
+		if (! (
+			prev.identity_score == m_parameters.identity_score &&
+			prev.mismatch_penalty == m_parameters.mismatch_penalty &&
+			prev.gap_start_penalty == m_parameters.gap_start_penalty &&
+			prev.gap_penalty == m_parameters.gap_penalty &&
+			prev.segment_length == m_parameters.segment_length
+		))
+			return false;
+		
+		auto const prev_len(edit.is_lhs ? prev.lhs_length : prev.rhs_length);
+		auto const len(edit.is_lhs ? lhs_len : rhs_len);
+		auto const prev_other_len(edit.is_lhs ? prev.rhs_length : prev.lhs_length);
+		auto const other_len(edit.is_lhs ? rhs_len : lhs_len);
+		if (! (
+			edit.position + edit.removed_length <= prev_len &&
+			prev_len - edit.removed_length + edit.inserted_length == len &&
+			prev_other_len == other_len
+		))
+			throw std::runtime_error("The edit does not match the lengths of the texts");
+		
+		return true;
+	}
+	
+	
+	// Let A be an optimal alignment of texts that begin with the same character c. If A does not
+	// align the first characters with each other, moving the first character that is aligned
+	// with a gap to a (c, c) column does not decrease the score if the conditions below hold.
+	// Hence there is an optimal alignment that begins with the common prefix, and by symmetry one
+	// that ends with the common suffix.
+	template <typename t_score, typename t_word, typename t_delegate>
+	bool aligner <t_score, t_word, t_delegate>::can_trim_common_affixes() const
+	{
+		if constexpr (t_delegate::uses_scoring_function())
+			return false;
+		else
+		{
+			return (
+				0 <= m_parameters.identity_score &&
+				m_parameters.mismatch_penalty <= m_parameters.identity_score &&
+				m_parameters.gap_start_penalty <= 0 &&
+				m_parameters.gap_penalty <= 0
+			);
+		}
+	}
+	
+	
+	// In addition to the conditions of trimming, SKIPPED_SCORE needs to be out of reach of the calculated
+	// scores, and adding to it the penalties along any path must not overflow. Not the case for e.g. std::int8_t
+	// unless the texts are very short.
+	template <typename t_score, typename t_word, typename t_delegate>
+	bool aligner <t_score, t_word, t_delegate>::can_prune_blocks(std::size_t const lhs_len, std::size_t const rhs_len) const
+	{
+		if (!can_trim_common_affixes())
+			return false;
+		
+		std::intmax_t const step(std::min({
+			std::intmax_t(0),
+			std::intmax_t(m_parameters.mismatch_penalty),
+			std::intmax_t(m_parameters.gap_start_penalty) + m_parameters.gap_penalty
+		}));
+		if (0 == step)
+			return true;
+		
+		// The distance of SKIPPED_SCORE from both zero and the lowest value needs to exceed the sum of the penalties.
+		std::intmax_t const skipped(impl_base_type::SKIPPED_SCORE);
+		std::intmax_t const lowest(std::numeric_limits <score_type>::lowest());
+		auto const limit(std::min(-skipped, skipped - lowest));
+		return lhs_len + rhs_len < std::uintmax_t(limit / -step);
+	}
+	
+	
+	// Bound the difference of the samples of adjacent cells, other than SKIPPED_SCORE, for choosing
+	// the intervals of the values stored as is when the samples are encoded. With the conditions of trimming,
+	// the scores of adjacent cells differ by at most the greater of the gap opening penalty and identity_score
+	// minus it, and the stored gap scores, which are not maximised over all three edit operations,
+	// by at most identity_score - mismatch_penalty - gap_start_penalty more. Zero if not known.
+	template <typename t_score, typename t_word, typename t_delegate>
+	std::uintmax_t aligner <t_score, t_word, t_delegate>::max_sample_step() const
+	{
+		if (!can_trim_common_affixes())
+			return 0;
+		
+		std::intmax_t const identity_score(m_parameters.identity_score);
+		std::intmax_t const mismatch_penalty(m_parameters.mismatch_penalty);
+		std::intmax_t const gap_start_penalty(m_parameters.gap_start_penalty);
+		std::intmax_t const gap_penalty(m_parameters.gap_penalty);
+		std::intmax_t const score_step(std::max(-gap_start_penalty - gap_penalty, identity_score - gap_start_penalty - gap_penalty));
+		return score_step + identity_score - mismatch_penalty - gap_start_penalty;
 	}
 	
 	
@@ -183,10 +608,42 @@ namespace text_align { namespace smith_waterman {
 	)
 	{
 		m_delegate->clear_gaps();
+		m_status = status_type::STATUS_NONE;
+		m_prefix_length = 0;
+		m_suffix_length = 0;
+		m_has_retained_samples = false;
+		clear_cancellation();
+		
+		if (m_trims_common_affixes && can_trim_common_affixes())
+		{
+			do_align_trimmed(lhs, rhs, lhs_len, rhs_len);
+			return;
+		}
 		
+		init_alignment(lhs_len, rhs_len);
+		do_align(lhs, rhs);
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_delegate>
+	void aligner <t_score, t_word, t_delegate>::init_alignment(std::size_t const lhs_len, std::size_t const rhs_len)
+	{
+		init_parameters(lhs_len, rhs_len);
+		init_samples();
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_delegate>
+	void aligner <t_score, t_word, t_delegate>::init_parameters(std::size_t const lhs_len, std::size_t const rhs_len)
+	{
 		m_parameters.lhs_length = lhs_len;
 		m_parameters.rhs_length = rhs_len;
 		
+		// The trimmed prefix and suffix consist of matches.
+		m_parameters.has_min_score = m_has_min_score;
+		m_parameters.prunes_blocks = m_has_min_score && can_prune_blocks(lhs_len, rhs_len);
+		m_parameters.min_score = m_min_score - score_type(m_prefix_length + m_suffix_length) * m_parameters.identity_score;
+		
 		// Set the segment length.
 		if (0 == m_parameters.segment_length)
 		{
@@ -202,54 +659,286 @@ namespace text_align { namespace smith_waterman {
 		
 		m_parameters.lhs_segments = segments_along_y;
 		m_parameters.rhs_segments = segments_along_x;
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_delegate>
+	void aligner <t_score, t_word, t_delegate>::init_samples()
+	{
+		auto const lhs_len(m_parameters.lhs_length);
+		auto const rhs_len(m_parameters.rhs_length);
+		auto const segments_along_y(m_parameters.lhs_segments);
+		auto const segments_along_x(m_parameters.rhs_segments);
+		
+		// Store SKIPPED_SCORE with the reserved code if the samples are encoded, and the other values
+		// as differences if they are small enough.
+		m_lhs.set_reserved_value(impl_base_type::SKIPPED_SCORE);
+		m_rhs.set_reserved_value(impl_base_type::SKIPPED_SCORE);
+		
+		auto const max_step(max_sample_step());
+		m_lhs.set_max_step(max_step);
+		m_rhs.set_max_step(max_step);
 		
 		m_lhs.init(
 			lhs_len,
 			segments_along_x,
+			m_parameters.segment_length,
 			arrow_type::ARROW_UP,
 			gap_start_position_type::GSP_RIGHT,
 			m_parameters.gap_penalty,
-			m_parameters.gap_start_penalty
+			m_parameters.gap_start_penalty,
+			m_parameters.records_gap_starts
 		);
 		m_rhs.init(
 			rhs_len,
 			segments_along_y,
+			m_parameters.segment_length,
 			arrow_type::ARROW_LEFT,
 			gap_start_position_type::GSP_DOWN,
 			m_parameters.gap_penalty,
-			m_parameters.gap_start_penalty
+			m_parameters.gap_start_penalty,
+			m_parameters.records_gap_starts
 		);
 		m_data.init(lhs_len, m_parameters.segment_length, segments_along_y, segments_along_x);
 		
 		m_lhs.copy_first_sample_values(m_rhs, m_parameters.segment_length, segments_along_x);
 		m_rhs.copy_first_sample_values(m_lhs, m_parameters.segment_length, segments_along_y);
+	}
+	
+	
+	// The cells above the row that corresponds to the edited character (in case of lhs) do not depend on it,
+	// so the blocks that only contain such cells need not be filled again. Their samples, including the final
+	// row of the last such block row, are retained.
+	template <typename t_score, typename t_word, typename t_delegate>
+	void aligner <t_score, t_word, t_delegate>::init_realignment(
+		text_edit const &edit,
+		std::size_t const lhs_len,
+		std::size_t const rhs_len,
+		std::size_t &lhs_block_idx,
+		std::size_t &rhs_block_idx
+	)
+	{
+		auto const segment_length(m_parameters.segment_length);
+		auto const first_block_idx(edit.position / segment_length);
+		auto const retained_length(1 + first_block_idx * segment_length);
+		
+		typename detail::aligner_sample <aligner>::retained_values lhs_values;
+		typename detail::aligner_sample <aligner>::retained_values rhs_values;
+		if (edit.is_lhs)
+		{
+			lhs_block_idx = first_block_idx;
+			rhs_block_idx = 0;
+			m_lhs.retain_values(retained_length, 1 + m_parameters.rhs_segments, lhs_values);
+			m_rhs.retain_values(1 + m_parameters.rhs_length, 1 + first_block_idx, rhs_values);
+		}
+		else
+		{
+			lhs_block_idx = 0;
+			rhs_block_idx = first_block_idx;
+			m_lhs.retain_values(1 + m_parameters.lhs_length, 1 + first_block_idx, lhs_values);
+			m_rhs.retain_values(retained_length, 1 + m_parameters.lhs_segments, rhs_values);
+		}
+		
+		init_parameters(lhs_len, rhs_len);
+		init_samples();
+		m_data.set_first_block(lhs_block_idx, rhs_block_idx);
 		
-		// Instantiate the implementation.
-		do_align(lhs, rhs, segments_along_y, segments_along_x);
+		m_lhs.restore_values(lhs_values);
+		m_rhs.restore_values(rhs_values);
+	}
+		
+	
+	// Align the given strings asynchronously.
+	template <typename t_score, typename t_word, typename t_delegate>
+	template <typename t_lhs, typename t_rhs, typename t_handler>
+	void aligner <t_score, t_word, t_delegate>::align_async(t_lhs const &lhs, t_rhs const &rhs, t_handler &&handler)
+	{
+		align_async(lhs, rhs, lhs.size(), rhs.size(), std::forward <t_handler>(handler));
 	}
 	
 	
+	// Align the given strings asynchronously.
+	template <typename t_score, typename t_word, typename t_delegate>
+	template <typename t_lhs, typename t_rhs, typename t_handler>
+	void aligner <t_score, t_word, t_delegate>::align_async(
+		t_lhs const &lhs,
+		t_rhs const &rhs,
+		std::size_t const lhs_len,
+		std::size_t const rhs_len,
+		t_handler &&handler
+	)
+	{
+		// Only one alignment may be in progress at a time.
+		libbio_assert(!m_aligner_impl);
+		m_completion_handler = std::forward <t_handler>(handler);
+		align(lhs, rhs, lhs_len, rhs_len);
+	}
+	
+	
+	// Realign the given strings.
+	template <typename t_score, typename t_word, typename t_delegate>
+	template <typename t_lhs, typename t_rhs>
+	void aligner <t_score, t_word, t_delegate>::realign(t_lhs const &lhs, t_rhs const &rhs, text_edit const &edit)
+	{
+		realign(lhs, rhs, lhs.size(), rhs.size(), edit);
+	}
+	
+	
+	// Realign the given strings.
 	template <typename t_score, typename t_word, typename t_delegate>
 	template <typename t_lhs, typename t_rhs>
-	void aligner <t_score, t_word, t_delegate>::do_align(
+	void aligner <t_score, t_word, t_delegate>::realign(
 		t_lhs const &lhs,
 		t_rhs const &rhs,
-		std::size_t const segments_along_y,
-		std::size_t const segments_along_x
+		std::size_t const lhs_len,
+		std::size_t const rhs_len,
+		text_edit const &edit
 	)
 	{
-		// g++ 8 cannot deduce the argument types; give them explicitly.
+		if (!can_realign(edit, lhs_len, rhs_len))
+		{
+			align(lhs, rhs, lhs_len, rhs_len);
+			return;
+		}
+		
+		m_delegate->clear_gaps();
+		m_status = status_type::STATUS_NONE;
+		m_prefix_length = 0;
+		m_suffix_length = 0;
+		m_has_retained_samples = false;
+		clear_cancellation();
+		
+		std::size_t lhs_block_idx(0);
+		std::size_t rhs_block_idx(0);
+		init_realignment(edit, lhs_len, rhs_len, lhs_block_idx, rhs_block_idx);
+		
+		// The iterators of the retained blocks are not set while filling.
 		typedef std::remove_reference_t <decltype(*this)> owner_type;
 		auto *impl_ptr(
-			new detail::aligner_impl <owner_type, t_lhs, t_rhs>(*this, lhs, rhs, segments_along_y, segments_along_x)
+			new detail::aligner_impl <owner_type, t_lhs, t_rhs>(*this, lhs, rhs, m_parameters.lhs_segments, m_parameters.rhs_segments)
 		);
+		impl_ptr->set_block_iterators();
+		impl_ptr->set_filled_blocks(lhs_block_idx * m_parameters.rhs_segments + rhs_block_idx * m_parameters.lhs_segments);
+		start_alignment(impl_ptr, lhs_block_idx, rhs_block_idx);
+	}
+	
+	
+	// Realign the given strings asynchronously.
+	template <typename t_score, typename t_word, typename t_delegate>
+	template <typename t_lhs, typename t_rhs, typename t_handler>
+	void aligner <t_score, t_word, t_delegate>::realign_async(
+		t_lhs const &lhs,
+		t_rhs const &rhs,
+		std::size_t const lhs_len,
+		std::size_t const rhs_len,
+		text_edit const &edit,
+		t_handler &&handler
+	)
+	{
+		libbio_assert(!m_aligner_impl);
+		m_completion_handler = std::forward <t_handler>(handler);
+		realign(lhs, rhs, lhs_len, rhs_len, edit);
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_delegate>
+	void aligner <t_score, t_word, t_delegate>::start_alignment(
+		impl_base_type *impl_ptr,
+		std::size_t const lhs_block_idx,
+		std::size_t const rhs_block_idx
+	)
+	{
 		m_aligner_impl.reset(impl_ptr); // noexcept.
 		
 		// Start the alignment tasks.
-		boost::asio::post(*m_ctx, [impl_ptr](){
-			impl_ptr->align_block(0, 0);
+		boost::asio::post(*m_ctx, [impl_ptr, lhs_block_idx, rhs_block_idx](){
+			impl_ptr->align_block(lhs_block_idx, rhs_block_idx);
 		});
 	}
+	
+	
+	template <typename t_score, typename t_word, typename t_delegate>
+	template <typename t_lhs, typename t_rhs>
+	void aligner <t_score, t_word, t_delegate>::do_align(t_lhs const &lhs, t_rhs const &rhs)
+	{
+		// g++ 8 cannot deduce the argument types; give them explicitly.
+		typedef std::remove_reference_t <decltype(*this)> owner_type;
+		start_alignment(
+			new detail::aligner_impl <owner_type, t_lhs, t_rhs>(*this, lhs, rhs, m_parameters.lhs_segments, m_parameters.rhs_segments)
+		);
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_delegate>
+	template <typename t_lhs, typename t_rhs>
+	void aligner <t_score, t_word, t_delegate>::do_align_trimmed(
+		t_lhs const &lhs,
+		t_rhs const &rhs,
+		std::size_t const lhs_len,
+		std::size_t const rhs_len
+	)
+	{
+		typedef std::remove_reference_t <decltype(*this)>			owner_type;
+		typedef std::decay_t <decltype(*lhs.begin())>				lhs_char_type;
+		typedef std::decay_t <decltype(*rhs.begin())>				rhs_char_type;
+		typedef detail::trimmed_texts <lhs_char_type, rhs_char_type>	texts_type;
+		
+		// Decode the texts once and compare the code points.
+		texts_type texts;
+		texts.assign(lhs, rhs, lhs_len, rhs_len);
+		
+		auto const *lhs_data(texts.lhs_buffer.data());
+		auto const *rhs_data(texts.rhs_buffer.data());
+		auto const min_len(std::min(lhs_len, rhs_len));
+		m_prefix_length = common_prefix_length(lhs_data, rhs_data, min_len);
+		m_suffix_length = common_suffix_length(lhs_data + lhs_len, rhs_data + rhs_len, min_len - m_prefix_length);
+		texts.set_trimmed_lengths(m_prefix_length, m_suffix_length);
+		
+		// The traceback proceeds from the end of the texts, so push the common suffix first.
+		push_common_run(m_suffix_length);
+		
+		auto const trimmed_lhs_len(texts.lhs.size());
+		auto const trimmed_rhs_len(texts.rhs.size());
+		if (0 == trimmed_lhs_len || 0 == trimmed_rhs_len)
+		{
+			// Only one alignment of the remaining parts is possible.
+			score_type score(0);
+			if (trimmed_lhs_len)
+			{
+				push_lhs(0, trimmed_lhs_len);
+				push_rhs(1, trimmed_lhs_len);
+				push_operation(OPERATION_DELETION, trimmed_lhs_len);
+				score = m_parameters.gap_start_penalty + score_type(trimmed_lhs_len) * m_parameters.gap_penalty;
+			}
+			else if (trimmed_rhs_len)
+			{
+				push_lhs(1, trimmed_rhs_len);
+				push_rhs(0, trimmed_rhs_len);
+				push_operation(OPERATION_INSERTION, trimmed_rhs_len);
+				score = m_parameters.gap_start_penalty + score_type(trimmed_rhs_len) * m_parameters.gap_penalty;
+			}
+			
+			m_parameters.lhs_length = trimmed_lhs_len;
+			m_parameters.rhs_length = trimmed_rhs_len;
+			finish_traceback();
+			
+			// Finish from the execution context as in the general case.
+			boost::asio::post(*m_ctx, [this, score](){
+				finish(score);
+			});
+			return;
+		}
+		
+		init_alignment(trimmed_lhs_len, trimmed_rhs_len);
+		start_alignment(
+			new detail::aligner_trimmed_impl <owner_type, lhs_char_type, rhs_char_type>(
+				*this,
+				std::move(texts),
+				m_parameters.lhs_segments,
+				m_parameters.rhs_segments
+			)
+		);
+	}
 }}
 
 #endif
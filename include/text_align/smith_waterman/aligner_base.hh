@@ -12,6 +12,16 @@
 
 namespace text_align { namespace smith_waterman {
 	
+	// Replacement of removed_length characters at position in lhs or rhs with inserted_length characters.
+	struct text_edit
+	{
+		std::size_t	position{};
+		std::size_t	removed_length{};
+		std::size_t	inserted_length{};
+		bool		is_lhs{};
+	};
+	
+	
 	struct aligner_base
 	{
 	public:
@@ -33,9 +43,18 @@ namespace text_align { namespace smith_waterman {
 			GSP_MASK		= 0x3
 		};
 		
+		enum status_type : std::uint8_t
+		{
+			STATUS_NONE				= 0x0,
+			STATUS_FINISHED			= 0x1,
+			STATUS_CANCELLED		= 0x2,
+			STATUS_BELOW_THRESHOLD	= 0x3	// The score would have been less than the minimum.
+		};
+		
 		virtual ~aligner_base() {}
 		virtual void set_segment_length(std::uint32_t const length) = 0;
 		virtual void set_prints_debugging_information(bool const should_print) = 0;
+		virtual status_type status() const = 0;
 	};
 	
 	inline aligner_base::gap_start_position_type operator|(aligner_base::gap_start_position_type lhs, aligner_base::gap_start_position_type rhs)
@@ -7,6 +7,7 @@
 #define TEXT_ALIGN_SMITH_WATERMAN_ALIGNER_DATA_HH
 
 #include <libbio/packed_matrix.hh>
+#include <text_align/smith_waterman/traceback_cell_matrix.hh>
 
 
 namespace text_align { namespace smith_waterman { namespace detail {
@@ -16,16 +17,13 @@ namespace text_align { namespace smith_waterman { namespace detail {
 	{
 		typedef typename t_aligner::flag_matrix					flag_matrix;
 		typedef typename t_aligner::score_vector				score_vector;
-		typedef typename t_aligner::traceback_matrix			traceback_matrix;
-		typedef typename t_aligner::gap_start_position_matrix	gap_start_position_matrix;
 
 		flag_matrix					flags;
 		score_vector				score_buffer_1;			// Source score buffer.
 		score_vector				score_buffer_2;			// Destination score buffer.
 		score_vector				gap_scores_lhs;			// Buffer for lhs gap scores.
 		
-		traceback_matrix			traceback;
-		gap_start_position_matrix	gap_start_positions;	// For finding the gap start in case gap was considered for the position.
+		traceback_cell_matrix		traceback;				// Also the gap start positions for finding the gap start in case gap was considered for the position.
 		
 		void init(
 			std::size_t const lhs_len,
@@ -33,6 +31,9 @@ namespace text_align { namespace smith_waterman { namespace detail {
 			std::size_t const segments_along_y,
 			std::size_t const segments_along_x
 		);
+		
+		// Mark the blocks above the given row and to the left of the given column as filled.
+		void set_first_block(std::size_t const lhs_block_idx, std::size_t const rhs_block_idx);
 	};
 	
 	
@@ -63,11 +64,19 @@ namespace text_align { namespace smith_waterman { namespace detail {
 		libbio::resize_and_zero(score_buffer_2, 1 + lhs_len);	// Vertical.
 		libbio::resize_and_zero(gap_scores_lhs, 1 + lhs_len);	// Vertical.
 		
-		libbio::matrices::initialize_atomic(traceback, segment_len, segment_len);
-		std::fill(traceback.word_begin(), traceback.word_end(), 0);
-		
-		libbio::matrices::initialize_atomic(gap_start_positions, segment_len, segment_len);
-		std::fill(gap_start_positions.word_begin(), gap_start_positions.word_end(), 0);
+		traceback.resize(segment_len, segment_len);
+		traceback.clear();
+	}
+	
+	
+	template <typename t_aligner>
+	void aligner_data <t_aligner>::set_first_block(std::size_t const lhs_block_idx, std::size_t const rhs_block_idx)
+	{
+		// As in init(), the blocks in the given row and column then only wait for the other preceding block.
+		auto column(flags.column(rhs_block_idx));
+		auto row(flags.row(lhs_block_idx));
+		std::for_each(column.begin(), column.end(),	[](auto ref){ ref.fetch_or(0x1); });
+		std::for_each(row.begin(), row.end(),		[](auto ref){ ref.fetch_or(0x1); });
 	}
 }}}
 
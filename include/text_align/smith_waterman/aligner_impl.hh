@@ -6,6 +6,7 @@
 #ifndef TEXT_ALIGN_SMITH_WATERMAN_ALIGNER_IMPL_HH
 #define TEXT_ALIGN_SMITH_WATERMAN_ALIGNER_IMPL_HH
 
+#include <atomic>
 #include <text_align/smith_waterman/aligner_impl_base.hh>
 #include <text_align/smith_waterman/matrix_printer.hh>
 
@@ -30,6 +31,8 @@ namespace text_align { namespace smith_waterman { namespace detail {
 		typedef typename superclass::score_vector				score_vector;
 		typedef typename superclass::score_matrix				score_matrix;
 		typedef typename superclass::score_result_type			score_result_type;
+		typedef aligner_sample <t_owner>						sample_type;
+		typedef typename sample_type::gap_start_record_matrix	gap_start_record_matrix;
 		
 		typedef decltype(std::declval <t_lhs>().begin())		lhs_const_iterator;
 		typedef decltype(std::declval <t_rhs>().begin())		rhs_const_iterator;
@@ -81,6 +84,9 @@ namespace text_align { namespace smith_waterman { namespace detail {
 		
 		void align_block(std::size_t const lhs_block_idx, std::size_t const rhs_block_idx) override;
 		
+		// Set the text iterators of all blocks, needed if the first filled block is not the initial one.
+		void set_block_iterators();
+		
 	protected:
 		inline bool can_continue_in_direction(
 			std::size_t const j,
@@ -102,6 +108,17 @@ namespace text_align { namespace smith_waterman { namespace detail {
 			std::size_t &steps
 		) const;
 		
+		// Move to the previous block after find_gap_start_x or find_gap_start_y has reached the first column
+		// or row of the current one. If the gap starts have been recorded, move directly to the gap start instead.
+		inline void skip_to_gap_start(
+			gap_start_record_matrix const &records,
+			std::size_t const idx,						// Row (lhs) or column (rhs) of the gap.
+			std::size_t const seg_len,
+			std::size_t &block_idx,
+			std::size_t &pos,
+			std::size_t &steps
+		) const;
+		
 		inline void copy_to_score_buffer(
 			score_vector const &src,
 			std::size_t const column_idx,
@@ -134,9 +151,26 @@ namespace text_align { namespace smith_waterman { namespace detail {
 			score_type &gap_score_rhs					// Out
 		);
 		
+		inline score_type reachable_score(score_type const score, std::size_t const row, std::size_t const column) const;
+		inline score_type reachable_gap_score(score_type const gap_score, std::size_t const row, std::size_t const column) const;
 		inline void update_lhs_samples(std::size_t const row_idx, std::size_t const block_idx, score_result_type const &result);
 		inline void update_rhs_samples(std::size_t const column_idx, std::size_t const block_idx, score_result_type const &result);
 		
+		inline void clear_gap_start_records(
+			std::size_t const lhs_block_idx,
+			std::size_t const rhs_block_idx,
+			std::size_t const lhs_limit,
+			std::size_t const rhs_limit
+		);
+		
+		inline void update_gap_start_records(
+			std::size_t const row_idx,
+			std::size_t const column_idx,
+			std::size_t const lhs_block_idx,
+			std::size_t const rhs_block_idx,
+			std::uint8_t const gsp
+		);
+		
 		template <bool t_initial>
 		void fill_block(
 			std::size_t const lhs_block_idx,
@@ -144,7 +178,20 @@ namespace text_align { namespace smith_waterman { namespace detail {
 			score_matrix *output_score_buffer = nullptr
 		);
 		
-		void fill_traceback();
+		// Store SKIPPED_SCORE to the samples that fill_block would have calculated.
+		void skip_block(std::size_t const lhs_block_idx, std::size_t const rhs_block_idx);
+		
+		// Copy the characters that correspond to the rows or columns of a traceback block.
+		template <typename t_iterator, typename t_sentinel, typename t_char>
+		void copy_block_characters(
+			std::vector <t_iterator> const &iterators,
+			t_sentinel const end,
+			std::size_t const block_idx,
+			std::size_t const seg_len,
+			std::vector <t_char> &dst
+		) const;
+		
+		bool fill_traceback();
 	};
 	
 	
@@ -272,23 +319,82 @@ namespace text_align { namespace smith_waterman { namespace detail {
 	}
 	
 	
+	// When pruning, store SKIPPED_SCORE instead of the scores from which the minimum score cannot be reached.
+	// Such scores may have been calculated from SKIPPED_SCORE, in which case they would not fit the encoding
+	// of the samples, and they do not affect the scores of the cells on the paths that reach the minimum.
+	template <typename t_owner, typename t_lhs, typename t_rhs>
+	auto aligner_impl <t_owner, t_lhs, t_rhs>::reachable_score(score_type const score, std::size_t const row, std::size_t const column) const -> score_type
+	{
+		if (this->m_parameters->prunes_blocks && !this->can_reach_min_score(score, row, column))
+			return this->SKIPPED_SCORE;
+		return score;
+	}
+	
+	
+	// The gap score already includes gap_penalty for the next cell in the direction of the gap.
+	template <typename t_owner, typename t_lhs, typename t_rhs>
+	auto aligner_impl <t_owner, t_lhs, t_rhs>::reachable_gap_score(score_type const gap_score, std::size_t const row, std::size_t const column) const -> score_type
+	{
+		if (this->m_parameters->prunes_blocks && !this->can_reach_min_score(gap_score - this->m_parameters->gap_penalty, row, column))
+			return this->SKIPPED_SCORE;
+		return gap_score;
+	}
+	
+	
 	template <typename t_owner, typename t_lhs, typename t_rhs>
 	void aligner_impl <t_owner, t_lhs, t_rhs>::update_lhs_samples(std::size_t const row_idx, std::size_t const block_idx, score_result_type const &result)
 	{
-		this->m_lhs->score_samples(row_idx, block_idx)		= result.score;													// Vertical
-		this->m_lhs->gap_score_samples(row_idx, block_idx)	= result.gap_score_lhs;											// Vertical
-		libbio_do_and_assert_eq(this->m_lhs->traceback_samples(row_idx, block_idx).fetch_or(result.max_idx), 0);					// Vertical, values same as arrow_type::*
-		libbio_do_and_assert_eq(this->m_lhs->gap_start_position_samples(row_idx, block_idx).fetch_or(result.did_start_gap), 0);	// Vertical
+		auto const column_idx(std::min(std::size_t(block_idx * this->m_parameters->segment_length), this->m_parameters->rhs_length));
+		this->m_lhs->score_samples.store(row_idx, block_idx, reachable_score(result.score, row_idx, column_idx));					// Vertical
+		this->m_lhs->gap_score_samples.store(row_idx, block_idx, reachable_gap_score(result.gap_score_lhs, row_idx, column_idx));	// Vertical
+		libbio_assert(0 == this->m_lhs->traceback_samples.load(row_idx, block_idx));
+		this->m_lhs->traceback_samples.store(row_idx, block_idx, result.max_idx, result.did_start_gap);								// Vertical, values same as arrow_type::*
 	}
 	
 	
 	template <typename t_owner, typename t_lhs, typename t_rhs>
 	void aligner_impl <t_owner, t_lhs, t_rhs>::update_rhs_samples(std::size_t const column_idx, std::size_t const block_idx, score_result_type const &result)
 	{
-		this->m_rhs->score_samples(column_idx, block_idx)		= result.score;												// Horizontal
-		this->m_rhs->gap_score_samples(column_idx, block_idx)	= result.gap_score_rhs;										// Horizontal
-		libbio_do_and_assert_eq(this->m_rhs->traceback_samples(column_idx, block_idx).fetch_or(result.max_idx), 0);				// Horizontal, values same as arrow_type::*
-		libbio_do_and_assert_eq(this->m_rhs->gap_start_position_samples(column_idx, block_idx).fetch_or(result.did_start_gap), 0);	// Horizontal
+		auto const row_idx(std::min(std::size_t(block_idx * this->m_parameters->segment_length), this->m_parameters->lhs_length));
+		this->m_rhs->score_samples.store(column_idx, block_idx, reachable_score(result.score, row_idx, column_idx));					// Horizontal
+		this->m_rhs->gap_score_samples.store(column_idx, block_idx, reachable_gap_score(result.gap_score_rhs, row_idx, column_idx));	// Horizontal
+		libbio_assert(0 == this->m_rhs->traceback_samples.load(column_idx, block_idx));
+		this->m_rhs->traceback_samples.store(column_idx, block_idx, result.max_idx, result.did_start_gap);								// Horizontal, values same as arrow_type::*
+	}
+	
+	
+	// Mark the rows and columns calculated in the block as having no gap starts.
+	template <typename t_owner, typename t_lhs, typename t_rhs>
+	void aligner_impl <t_owner, t_lhs, t_rhs>::clear_gap_start_records(
+		std::size_t const lhs_block_idx,
+		std::size_t const rhs_block_idx,
+		std::size_t const lhs_limit,	// Past the last calculated row.
+		std::size_t const rhs_limit		// Past the last calculated column.
+	)
+	{
+		auto const segment_length(this->m_owner->segment_length());
+		for (std::size_t j(1 + segment_length * lhs_block_idx); j < lhs_limit; ++j)
+			this->m_lhs->gap_start_records.store(j, rhs_block_idx, gap_start_record_matrix::GAP_START_NONE);
+		for (std::size_t i(1 + segment_length * rhs_block_idx); i < rhs_limit; ++i)
+			this->m_rhs->gap_start_records.store(i, lhs_block_idx, gap_start_record_matrix::GAP_START_NONE);
+	}
+	
+	
+	// The cells are calculated in increasing order of row and column, so the last offset stored is the greatest.
+	template <typename t_owner, typename t_lhs, typename t_rhs>
+	void aligner_impl <t_owner, t_lhs, t_rhs>::update_gap_start_records(
+		std::size_t const row_idx,
+		std::size_t const column_idx,
+		std::size_t const lhs_block_idx,
+		std::size_t const rhs_block_idx,
+		std::uint8_t const gsp
+	)
+	{
+		auto const segment_length(this->m_owner->segment_length());
+		if (gsp & gap_start_position_type::GSP_RIGHT)
+			this->m_lhs->gap_start_records.store(row_idx, rhs_block_idx, column_idx - segment_length * rhs_block_idx);
+		if (gsp & gap_start_position_type::GSP_DOWN)
+			this->m_rhs->gap_start_records.store(column_idx, lhs_block_idx, row_idx - segment_length * lhs_block_idx);
 	}
 	
 	
@@ -323,31 +429,29 @@ namespace text_align { namespace smith_waterman { namespace detail {
 		libbio_assert(lhs_limit - lhs_idx <= segment_length);
 		libbio_assert(rhs_limit - rhs_idx <= segment_length);
 		
+		bool const records_gap_starts(t_initial && this->m_parameters->records_gap_starts);
+		if (records_gap_starts)
+			clear_gap_start_records(lhs_block_idx, rhs_block_idx, lhs_limit + should_calculate_final_row, rhs_limit + should_calculate_final_column);
+		
 		// Score buffers.
 		auto *src_buffer_ptr(&this->m_data->score_buffer_1);
 		auto *dst_buffer_ptr(&this->m_data->score_buffer_2);
 		
-		// Fill the first column up to what is needed.
-		{
-			auto const column(this->m_lhs->score_samples.column(rhs_block_idx));
-			auto const it(column.begin());
-			std::copy(
-				it + lhs_idx,
-				it + lhs_limit,
-				src_buffer_ptr->begin() + lhs_idx
-			);
-		}
+		// Fill the first column up to what is needed. The samples are decoded if needed.
+		this->m_lhs->score_samples.copy(
+			rhs_block_idx,
+			lhs_idx,
+			lhs_limit,
+			src_buffer_ptr->begin() + lhs_idx
+		);
 		
 		// Fill the part of lhs gap scores. The first row is not needed here but the final row is.
-		{
-			auto const column(this->m_lhs->gap_score_samples.column(rhs_block_idx));
-			auto const it(column.begin());
-			std::copy(
-				it + lhs_idx + 1,
-				it + lhs_limit + should_calculate_final_row,
-				this->m_data->gap_scores_lhs.begin() + lhs_idx + 1
-			);
-		}
+		this->m_lhs->gap_score_samples.copy(
+			rhs_block_idx,
+			lhs_idx + 1,
+			lhs_limit + should_calculate_final_row,
+			this->m_data->gap_scores_lhs.begin() + lhs_idx + 1
+		);
 		
 		// Find the correct text position.
 		auto lhs_it(m_lhs_iterators[lhs_block_idx]);
@@ -359,8 +463,8 @@ namespace text_align { namespace smith_waterman { namespace detail {
 		
 		// Fill the block. Initialize the result with the final value of the first column in case
 		// it is the only column to fill.
-		auto const &topmost_row(this->m_rhs->score_samples.column(lhs_block_idx));			// Horizontal.
-		auto const &gap_scores_rhs(this->m_rhs->gap_score_samples.column(lhs_block_idx));	// Horizontal.
+		auto const &topmost_row(this->m_rhs->score_samples);			// Horizontal, column lhs_block_idx.
+		auto const &gap_scores_rhs(this->m_rhs->gap_score_samples);	// Horizontal, column lhs_block_idx.
 		score_result_type result((*src_buffer_ptr)[lhs_limit - 1]);
 		auto lhs_it_2(lhs_it); // Copy, needed to store the iterator after the loop.
 		for (std::size_t i(rhs_idx); i < rhs_limit - 1; ++i) // Column
@@ -369,23 +473,25 @@ namespace text_align { namespace smith_waterman { namespace detail {
 			
 			auto const rhs_c(*rhs_it);
 			lhs_it_2 = lhs_it;
-			score_type gap_score_rhs(gap_scores_rhs[1 + i]);
+			score_type gap_score_rhs(gap_scores_rhs.load(1 + i, lhs_block_idx));
 			
 			// Fill the first row, needed for the first value of prev_diag_score on the next iteration.
-			(*dst_buffer_ptr)[lhs_idx] = topmost_row[1 + i];
+			(*dst_buffer_ptr)[lhs_idx] = topmost_row.load(1 + i, lhs_block_idx);
 			
 			for (std::size_t j(lhs_idx); j < lhs_limit - 1; ++j) // Row
 			{
 				calculate_score_and_update_gap_scores <t_initial>(j, i, lhs_it_2, rhs_c, src_buffer_ptr, result, gap_score_rhs);
 				(*dst_buffer_ptr)[1 + j] = result.score;
+				if (records_gap_starts)
+					update_gap_start_records(1 + j, 1 + i, lhs_block_idx, rhs_block_idx, result.did_start_gap);
 				
 				// Store the traceback value if needed.
 				if constexpr (!t_initial)
 				{
 					auto const y(1 + j - lhs_idx);
 					auto const x(1 + i - rhs_idx);
-					libbio_do_and_assert_eq(this->m_data->traceback(y, x).fetch_or(result.max_idx), 0);
-					libbio_do_and_assert_eq(this->m_data->gap_start_positions(y, x).fetch_or(result.did_start_gap), 0);
+					libbio_assert(0 == this->m_data->traceback.load(y, x));
+					this->m_data->traceback.store(y, x, result.max_idx, result.did_start_gap);
 				}
 
 				++lhs_it_2;
@@ -396,6 +502,8 @@ namespace text_align { namespace smith_waterman { namespace detail {
 			{
 				calculate_score_and_update_gap_scores <t_initial>(lhs_limit - 1, i, lhs_it_2, rhs_c, src_buffer_ptr, result, gap_score_rhs);
 				update_rhs_samples(1 + i, 1 + lhs_block_idx, result);
+				if (records_gap_starts)
+					update_gap_start_records(lhs_limit, 1 + i, lhs_block_idx, rhs_block_idx, result.did_start_gap);
 			}
 			
 			// Copy to output_score_buffer if needed. For these columns, the value of the final row is relevant (hence lhs_limit, not -1).
@@ -428,12 +536,14 @@ namespace text_align { namespace smith_waterman { namespace detail {
 			
 			auto const rhs_c(*rhs_it);
 			auto lhs_it_2(lhs_it);
-			score_type gap_score_rhs(gap_scores_rhs[1 + column_idx]);
+			score_type gap_score_rhs(gap_scores_rhs.load(1 + column_idx, lhs_block_idx));
 			
 			for (std::size_t j(lhs_idx); j < lhs_limit - 1; ++j) // Row
 			{
 				calculate_score_and_update_gap_scores <t_initial>(j, column_idx, lhs_it_2, rhs_c, src_buffer_ptr, result, gap_score_rhs);
 				update_lhs_samples(1 + j, 1 + rhs_block_idx, result);
+				if (records_gap_starts)
+					update_gap_start_records(1 + j, 1 + column_idx, lhs_block_idx, rhs_block_idx, result.did_start_gap);
 				++lhs_it_2;
 			}
 			
@@ -444,6 +554,8 @@ namespace text_align { namespace smith_waterman { namespace detail {
 				calculate_score_and_update_gap_scores <t_initial>(row_idx, column_idx, lhs_it_2, rhs_c, src_buffer_ptr, result, gap_score_rhs);
 				update_lhs_samples(1 + row_idx, 1 + rhs_block_idx, result);
 				update_rhs_samples(1 + column_idx, 1 + lhs_block_idx, result);
+				if (records_gap_starts)
+					update_gap_start_records(1 + row_idx, 1 + column_idx, lhs_block_idx, rhs_block_idx, result.did_start_gap);
 			}
 			
 			// Store the right iterator if needed.
@@ -467,6 +579,74 @@ namespace text_align { namespace smith_waterman { namespace detail {
 	}
 	
 	
+	template <typename t_owner, typename t_lhs, typename t_rhs>
+	void aligner_impl <t_owner, t_lhs, t_rhs>::skip_block(
+		std::size_t const lhs_block_idx,
+		std::size_t const rhs_block_idx
+	)
+	{
+		// Determine the limits as in fill_block.
+		auto const segment_length(this->m_owner->segment_length());
+		auto const lhs_idx(segment_length * lhs_block_idx);
+		auto const rhs_idx(segment_length * rhs_block_idx);
+		auto const lhs_limits(libbio::make_array <std::size_t>(1 + this->m_parameters->lhs_length, lhs_idx + segment_length));
+		auto const rhs_limits(libbio::make_array <std::size_t>(1 + this->m_parameters->rhs_length, rhs_idx + segment_length));
+		bool const should_calculate_final_row(libbio::argmin_element(lhs_limits.begin(), lhs_limits.end()));
+		bool const should_calculate_final_column(libbio::argmin_element(rhs_limits.begin(), rhs_limits.end()));
+		auto const lhs_limit(lhs_limits[should_calculate_final_row]);
+		auto const rhs_limit(rhs_limits[should_calculate_final_column]);
+		
+		score_result_type result(this->SKIPPED_SCORE);
+		result.gap_score_lhs = this->SKIPPED_SCORE;
+		result.gap_score_rhs = this->SKIPPED_SCORE;
+		
+		if (should_calculate_final_row)
+		{
+			for (std::size_t i(rhs_idx); i < rhs_limit - 1; ++i)
+				update_rhs_samples(1 + i, 1 + lhs_block_idx, result);
+			
+			// Store the left iterator if needed.
+			if (0 == rhs_block_idx)
+			{
+				auto lhs_it(m_lhs_iterators[lhs_block_idx]);
+				for (std::size_t j(lhs_idx); j < lhs_limit; ++j)
+					++lhs_it;
+				
+				auto const it_idx(1 + lhs_block_idx);
+				libbio_assert(it_idx < m_lhs_iterators.size());
+				m_lhs_iterators[it_idx] = lhs_it;
+			}
+		}
+		
+		if (should_calculate_final_column)
+		{
+			for (std::size_t j(lhs_idx); j < lhs_limit - 1; ++j)
+				update_lhs_samples(1 + j, 1 + rhs_block_idx, result);
+			
+			// Consider the corner.
+			if (should_calculate_final_row)
+			{
+				update_lhs_samples(lhs_limit, 1 + rhs_block_idx, result);
+				update_rhs_samples(rhs_limit, 1 + lhs_block_idx, result);
+			}
+			
+			// Store the right iterator if needed.
+			if (0 == lhs_block_idx)
+			{
+				auto rhs_it(m_rhs_iterators[rhs_block_idx]);
+				for (std::size_t i(rhs_idx); i < rhs_limit; ++i)
+					++rhs_it;
+				
+				auto const it_idx(1 + rhs_block_idx);
+				libbio_assert(it_idx < m_rhs_iterators.size());
+				m_rhs_iterators[it_idx] = rhs_it;
+			}
+		}
+		
+		this->m_block_score = this->SKIPPED_SCORE;
+	}
+	
+	
 	template <typename t_owner, typename t_lhs, typename t_rhs>
 	bool aligner_impl <t_owner, t_lhs, t_rhs>::can_continue_in_direction(
 		std::size_t const j,
@@ -474,7 +654,7 @@ namespace text_align { namespace smith_waterman { namespace detail {
 		gap_start_position_type const given_gsp
 	) const
 	{
-		auto const gsp(static_cast <gap_start_position_type>(this->m_data->gap_start_positions.load(j, i)));
+		auto const gsp(this->m_data->traceback.gap_start_position(j, i));
 		return (0 != (given_gsp & gsp));
 	}
 	
@@ -534,8 +714,94 @@ namespace text_align { namespace smith_waterman { namespace detail {
 	
 	
 	template <typename t_owner, typename t_lhs, typename t_rhs>
-	void aligner_impl <t_owner, t_lhs, t_rhs>::fill_traceback()
+	void aligner_impl <t_owner, t_lhs, t_rhs>::skip_to_gap_start(
+		gap_start_record_matrix const &records,
+		std::size_t const idx,
+		std::size_t const seg_len,
+		std::size_t &block_idx,
+		std::size_t &pos,
+		std::size_t &steps
+	) const
+	{
+		libbio_assert(block_idx);
+		if (!this->m_parameters->records_gap_starts)
+		{
+			--block_idx;
+			pos = seg_len - 1;
+			return;
+		}
+		
+		// The record of block b covers (seg_len * b, seg_len * (b + 1)]. The first position of the
+		// current block has already been checked. If no gap start is found, the gap starts from
+		// the first row or column of the matrix.
+		auto const first(seg_len * block_idx);
+		auto target(std::size_t(0));
+		for (auto b(block_idx); b; )
+		{
+			--b;
+			auto const rec(records.load(idx, b));
+			if (gap_start_record_matrix::GAP_START_UNKNOWN == rec)
+			{
+				// Continue from the last position not covered by the records.
+				target = libbio::min_ct(first - 1, seg_len * (1 + b));
+				break;
+			}
+			
+			if (gap_start_record_matrix::GAP_START_NONE != rec)
+			{
+				target = seg_len * b + rec;
+				break;
+			}
+		}
+		
+		libbio_assert(target < first);
+		steps += first - 1 - target;
+		block_idx = target / seg_len;
+		pos = target % seg_len;
+	}
+	
+	
+	template <typename t_owner, typename t_lhs, typename t_rhs>
+	template <typename t_iterator, typename t_sentinel, typename t_char>
+	void aligner_impl <t_owner, t_lhs, t_rhs>::copy_block_characters(
+		std::vector <t_iterator> const &iterators,
+		t_sentinel const end,
+		std::size_t const block_idx,
+		std::size_t const seg_len,
+		std::vector <t_char> &dst
+	) const
+	{
+		// Row j of the block corresponds to character seg_len * block_idx + j - 1.
+		dst.clear();
+		if (0 == block_idx)
+		{
+			// The first row has no character.
+			dst.emplace_back();
+			auto it(iterators[0]);
+			for (std::size_t k(1); k < seg_len && it != end; ++k, ++it)
+				dst.emplace_back(*it);
+		}
+		else
+		{
+			auto it(iterators[block_idx - 1]);
+			for (std::size_t k(1); k < seg_len; ++k)
+			{
+				libbio_assert(it != end);
+				++it;
+			}
+			
+			for (std::size_t k(0); k < seg_len && it != end; ++k, ++it)
+				dst.emplace_back(*it);
+		}
+	}
+	
+	
+	template <typename t_owner, typename t_lhs, typename t_rhs>
+	bool aligner_impl <t_owner, t_lhs, t_rhs>::fill_traceback()
 	{
+		typedef std::decay_t <decltype(*std::declval <lhs_const_iterator>())>	lhs_char_type;
+		typedef std::decay_t <decltype(*std::declval <rhs_const_iterator>())>	rhs_char_type;
+		
 		arrow_type dir{};
 		
 		// Variables from the owner object.
@@ -546,13 +812,16 @@ namespace text_align { namespace smith_waterman { namespace detail {
 		auto const prints_values_converted_to_utf8(this->m_owner->prints_values_converted_to_utf8());
 		
 		auto &traceback(this->m_data->traceback);
-		auto &gap_start_positions(this->m_data->gap_start_positions);
 		
 		std::size_t lhs_block_idx(this->m_parameters->lhs_segments - 1);
 		std::size_t rhs_block_idx(this->m_parameters->rhs_segments - 1);
 		libbio::matrix <score_type> score_buffer;
 		libbio::matrix <score_type> *score_buffer_ptr(nullptr);
 		
+		// Characters of the current block for determining matches if the delegate needs them.
+		std::vector <lhs_char_type> lhs_characters;
+		std::vector <rhs_char_type> rhs_characters;
+		
 		// Scoring matrix indices.
 		// lhs_idx and rhs_idx point to the upper left corner of the final block, that is, the bottom-right one.
 		auto const lhs_idx(seg_len * lhs_block_idx);
@@ -578,35 +847,37 @@ namespace text_align { namespace smith_waterman { namespace detail {
 		while (true)
 		{
 			// Initialize the block to calculate the traceback.
-			std::fill(traceback.word_begin(), traceback.word_end(), 0);
-			std::fill(gap_start_positions.word_begin(), gap_start_positions.word_end(), 0);
+			traceback.clear();
 			
-			// Fill the first rows and columns of the matrices used in traceback.
+			// Fill the first row and column of the matrix used in traceback. The corner is combined
+			// from both since only one of them has been set in the blocks next to the edges.
 			auto const lhs_first(seg_len * lhs_block_idx);
 			auto const rhs_first(seg_len * rhs_block_idx);
 			{
 				auto const lhs_limit(libbio::min_ct(1 + lhs_len, seg_len * (1 + lhs_block_idx)));
 				auto const rhs_limit(libbio::min_ct(1 + rhs_len, seg_len * (1 + rhs_block_idx)));
+				auto const &lhs_samples(*this->m_lhs);
+				auto const &rhs_samples(*this->m_rhs);
 				
-				libbio::matrices::copy_to_word_aligned(
-					this->m_lhs->traceback_samples.column(rhs_block_idx, lhs_first, lhs_limit),
-					traceback.column(0)
-				);
-				libbio::matrices::copy_to_word_aligned(
-					this->m_lhs->gap_start_position_samples.column(rhs_block_idx, lhs_first, lhs_limit),
-					gap_start_positions.column(0)
-				);
+				for (std::size_t k(lhs_first); k < lhs_limit; ++k)
+					traceback.merge(k - lhs_first, 0, lhs_samples.traceback_samples.load(k, rhs_block_idx));
 				
-				libbio::matrices::transpose_column_to_row(this->m_rhs->traceback_samples.column(lhs_block_idx, rhs_first, rhs_limit), traceback.row(0));
-				libbio::matrices::transpose_column_to_row(this->m_rhs->gap_start_position_samples.column(lhs_block_idx, rhs_first, rhs_limit), this->m_data->gap_start_positions.row(0));
+				for (std::size_t k(rhs_first); k < rhs_limit; ++k)
+					traceback.merge(0, k - rhs_first, rhs_samples.traceback_samples.load(k, lhs_block_idx));
 			}
 			
 			// The first row and column are now filled, run the filling algorithm.
 			std::fill(score_buffer.begin(), score_buffer.end(), 0);
 			fill_block <false>(lhs_block_idx, rhs_block_idx, score_buffer_ptr);
 			
+			if constexpr (t_owner::reports_operations())
+			{
+				copy_block_characters(m_lhs_iterators, m_lhs_text->end(), lhs_block_idx, seg_len, lhs_characters);
+				copy_block_characters(m_rhs_iterators, m_rhs_text->end(), rhs_block_idx, seg_len, rhs_characters);
+			}
+			
 			// If this is the last block, check that the corner is marked.
-			libbio_assert((! (0 == lhs_block_idx && 0 == rhs_block_idx)) || traceback(0, 0) == arrow_type::ARROW_FINISH);
+			libbio_assert((! (0 == lhs_block_idx && 0 == rhs_block_idx)) || traceback.arrow(0, 0) == arrow_type::ARROW_FINISH);
 			
 			// Continue finding the gap starting position if needed.
 			{
@@ -616,30 +887,28 @@ namespace text_align { namespace smith_waterman { namespace detail {
 					case find_gap_type::LEFT:
 					{
 						bool const res(find_gap_start_x <true>(j, i, steps));
+						if (!res)
+							skip_to_gap_start(this->m_lhs->gap_start_records, lhs_first + j, seg_len, rhs_block_idx, i, steps);
+						
 						this->push_lhs(1, steps);
 						this->push_rhs(0, steps);
+						this->push_operation(OPERATION_INSERTION, steps);
 						if (!res)
-						{
-							libbio_assert(rhs_block_idx);
-							--rhs_block_idx;
-							i = seg_len - 1;
 							goto continue_loop;
-						}
 						break;
 					}
 					
 					case find_gap_type::UP:
 					{
 						bool const res(find_gap_start_y <true>(j, i, steps));
+						if (!res)
+							skip_to_gap_start(this->m_rhs->gap_start_records, rhs_first + i, seg_len, lhs_block_idx, j, steps);
+						
 						this->push_lhs(0, steps);
 						this->push_rhs(1, steps);
+						this->push_operation(OPERATION_DELETION, steps);
 						if (!res)
-						{
-							libbio_assert(lhs_block_idx);
-							--lhs_block_idx;
-							j = seg_len - 1;
 							goto continue_loop;
-						}
 						break;
 					}
 					
@@ -652,7 +921,7 @@ namespace text_align { namespace smith_waterman { namespace detail {
 			mode = find_gap_type::UNSET;
 			while (true)
 			{
-				dir = static_cast <arrow_type>(traceback(j, i).load());
+				dir = traceback.arrow(j, i);
 				std::size_t steps(0);
 				
 				switch (dir)
@@ -662,6 +931,14 @@ namespace text_align { namespace smith_waterman { namespace detail {
 						this->push_lhs(0, 1);
 						this->push_rhs(0, 1);
 						
+						if constexpr (t_owner::reports_operations())
+						{
+							libbio_assert(j < lhs_characters.size());
+							libbio_assert(i < rhs_characters.size());
+							auto const is_match(libbio::is_equal(lhs_characters[j], rhs_characters[i]));
+							this->push_operation(is_match ? OPERATION_MATCH : OPERATION_MISMATCH, 1);
+						}
+						
 						// If either co-ordinate is zero, move to the adjacent block.
 						if (! (i && j))
 						{
@@ -703,13 +980,14 @@ namespace text_align { namespace smith_waterman { namespace detail {
 					{
 						// Move left as long as possible and to the adjacent block if needed.
 						bool const res(this->find_gap_start_x <false>(j, i, steps));
+						if (!res)
+							skip_to_gap_start(this->m_lhs->gap_start_records, lhs_first + j, seg_len, rhs_block_idx, i, steps);
+						
 						this->push_lhs(1, steps);
 						this->push_rhs(0, steps);
+						this->push_operation(OPERATION_INSERTION, steps);
 						if (!res)
 						{
-							libbio_assert(rhs_block_idx);
-							--rhs_block_idx;
-							i = seg_len - 1;
 							next_i_limit = seg_len;
 							mode = find_gap_type::LEFT;
 							goto continue_loop;
@@ -721,13 +999,14 @@ namespace text_align { namespace smith_waterman { namespace detail {
 					{
 						// Move up as long as possible and to the adjacent block if needed.
 						bool const res(this->find_gap_start_y <false>(j, i, steps));
+						if (!res)
+							skip_to_gap_start(this->m_rhs->gap_start_records, rhs_first + i, seg_len, lhs_block_idx, j, steps);
+						
 						this->push_lhs(0, steps);
 						this->push_rhs(1, steps);
+						this->push_operation(OPERATION_DELETION, steps);
 						if (!res)
 						{
-							libbio_assert(lhs_block_idx);
-							--lhs_block_idx;
-							j = seg_len - 1;
 							next_j_limit = seg_len;
 							mode = find_gap_type::UP;
 							goto continue_loop;
@@ -770,6 +1049,15 @@ namespace text_align { namespace smith_waterman { namespace detail {
 			i_limit = next_i_limit;
 			prev_j = j;
 			prev_i = i;
+			
+			this->did_advance_traceback(
+				libbio::min_ct(lhs_len, seg_len * lhs_block_idx + j),
+				libbio::min_ct(rhs_len, seg_len * rhs_block_idx + i)
+			);
+			
+			// Check for cancellation before refilling the next block.
+			if (this->should_stop())
+				return false;
 		}
 		
 	exit_loop:
@@ -793,8 +1081,22 @@ namespace text_align { namespace smith_waterman { namespace detail {
 			std::cerr << '\n';
 		}
 		
-		// Reverse the paths.
-		this->reverse_gaps();
+		this->did_advance_traceback(0, 0);
+		
+		// Add the trimmed prefix if any and reverse the paths.
+		this->finish_traceback();
+		return true;
+	}
+	
+	
+	template <typename t_owner, typename t_lhs, typename t_rhs>
+	void aligner_impl <t_owner, t_lhs, t_rhs>::set_block_iterators()
+	{
+		auto const segment_length(this->m_parameters->segment_length);
+		for (std::size_t i(1); i < m_lhs_iterators.size(); ++i)
+			m_lhs_iterators[i] = std::next(m_lhs_iterators[i - 1], segment_length);
+		for (std::size_t i(1); i < m_rhs_iterators.size(); ++i)
+			m_rhs_iterators[i] = std::next(m_rhs_iterators[i - 1], segment_length);
 	}
 	
 	
@@ -805,7 +1107,11 @@ namespace text_align { namespace smith_waterman { namespace detail {
 		std::size_t const rhs_block_idx
 	)
 	{
-		fill_block <true>(lhs_block_idx, rhs_block_idx);
+		if (this->m_parameters->prunes_blocks && !this->can_reach_min_score(lhs_block_idx, rhs_block_idx))
+			skip_block(lhs_block_idx, rhs_block_idx);
+		else
+			fill_block <true>(lhs_block_idx, rhs_block_idx);
+		this->did_fill_block();
 		
 		// Considering the folliwing blocks:
 		//  A B
@@ -818,16 +1124,37 @@ namespace text_align { namespace smith_waterman { namespace detail {
 		auto const rhs_segments(this->m_parameters->rhs_segments);
 		if (1 + lhs_block_idx == lhs_segments && 1 + rhs_block_idx == rhs_segments)
 		{
-			this->fill_traceback();
-			this->finish();
+			// The finish functions release this object, so return immediately afterwards.
+			// The traceback is not needed if the score is too low.
+			if (this->should_stop())
+				this->finish_cancelled();
+			else if (this->m_parameters->has_min_score && this->m_block_score < this->m_parameters->min_score)
+				this->finish_below_threshold();
+			else if (!this->m_parameters->computes_traceback)
+				this->finish();
+			else if (this->fill_traceback())
+				this->finish();
+			else
+				this->finish_cancelled();
+			return;
 		}
-		else
+		
+		// Don't start any new blocks if the alignment should be stopped.
+		if (!this->should_stop())
 		{
+			// The samples are written without atomic operations; publish them before setting the flags.
+			// The block that sets the second flag acquires the samples written by the other one.
+			std::atomic_thread_fence(std::memory_order_release);
+			
+			// If the samples are mapped, read the next blocks’ samples while the other blocks are being filled.
 			if (1 + lhs_block_idx < lhs_segments)
 			{
+				this->prefetch_samples(1 + lhs_block_idx, rhs_block_idx);
 				auto const prev_val((this->m_data->flags)(1 + lhs_block_idx, rhs_block_idx).fetch_or(0x1));
 				if (0x1 == prev_val)
 				{
+					std::atomic_thread_fence(std::memory_order_acquire);
+					++this->m_running_blocks;
 					boost::asio::post(*this->m_ctx, [this, lhs_block_idx, rhs_block_idx](){
 						align_block(1 + lhs_block_idx, rhs_block_idx);
 					});
@@ -836,15 +1163,22 @@ namespace text_align { namespace smith_waterman { namespace detail {
 			
 			if (1 + rhs_block_idx < rhs_segments)
 			{
+				this->prefetch_samples(lhs_block_idx, 1 + rhs_block_idx);
 				auto const prev_val((this->m_data->flags)(lhs_block_idx, 1 + rhs_block_idx).fetch_or(0x1));
 				if (0x1 == prev_val)
 				{
+					std::atomic_thread_fence(std::memory_order_acquire);
+					++this->m_running_blocks;
 					boost::asio::post(*this->m_ctx, [this, lhs_block_idx, rhs_block_idx](){
 						align_block(lhs_block_idx, 1 + rhs_block_idx);
 					});
 				}
 			}
 		}
+		
+		// If no blocks were posted and none are running, the final block cannot be reached.
+		if (1 == this->m_running_blocks.fetch_sub(1))
+			this->finish_cancelled();
 	}
 }}}
 
@@ -6,6 +6,9 @@
 #ifndef TEXT_ALIGN_SMITH_WATERMAN_ALIGNER_IMPL_BASE_HH
 #define TEXT_ALIGN_SMITH_WATERMAN_ALIGNER_IMPL_BASE_HH
 
+#include <algorithm>
+#include <limits>
+#include <text_align/alignment_operation.hh>
 #include <text_align/smith_waterman/aligner_parameters.hh>
 #include <text_align/smith_waterman/aligner_sample.hh>
 
@@ -40,6 +43,10 @@ namespace text_align { namespace smith_waterman { namespace detail {
 	public:
 		typedef score_result <score_type>					score_result_type;
 		
+		// Stored in the samples of the blocks that were not filled. Halved to prevent overflow
+		// when the penalties are added.
+		static constexpr score_type const SKIPPED_SCORE = std::numeric_limits <score_type>::lowest() / 2;
+		
 	protected:
 		// Pointers from t_owner.
 		t_owner							*m_owner{};	// Not const b.c. finish() requires mutability.
@@ -50,6 +57,8 @@ namespace text_align { namespace smith_waterman { namespace detail {
 		aligner_sample <t_owner>		*m_rhs{};
 		
 		std::atomic <score_type>		m_block_score{};
+		std::atomic_size_t				m_running_blocks{1};	// Posted or running blocks, initially the first one.
+		std::atomic_size_t				m_filled_blocks{};		// Only updated if the delegate reports progress.
 		
 	public:
 		aligner_impl_base() = default;
@@ -66,13 +75,24 @@ namespace text_align { namespace smith_waterman { namespace detail {
 		virtual ~aligner_impl_base() {}
 		virtual void align_block(std::size_t const lhs_block_idx, std::size_t const rhs_block_idx) = 0;
 		score_type block_score() const { return m_block_score; }
+		void set_filled_blocks(std::size_t const count) { m_filled_blocks = count; }	// For progress reporting.
 
 	protected:
 		inline void did_calculate_score(std::size_t const j, std::size_t const i, score_result_type const &result, bool const initial);
+		inline void did_fill_block();
+		inline void did_advance_traceback(std::size_t const lhs_pos, std::size_t const rhs_pos);
+		inline score_type max_remaining_score(std::size_t const row, std::size_t const column) const;
+		inline bool can_reach_min_score(std::size_t const lhs_block_idx, std::size_t const rhs_block_idx) const;
+		inline bool can_reach_min_score(score_type const score, std::size_t const row, std::size_t const column) const;
+		inline void prefetch_samples(std::size_t const lhs_block_idx, std::size_t const rhs_block_idx) const;
 		inline void push_lhs(bool const flag, std::size_t const count) { this->m_owner->push_lhs(flag, count); }
 		inline void push_rhs(bool const flag, std::size_t const count) { this->m_owner->push_rhs(flag, count); }
-		inline void reverse_gaps() { this->m_owner->reverse_gaps(); }
+		inline void push_operation(alignment_operation const op, std::size_t const count) { this->m_owner->push_operation(op, count); }
+		inline void finish_traceback() { this->m_owner->finish_traceback(); }
 		inline void finish() { this->m_owner->finish(m_block_score); }
+		inline void finish_cancelled() { this->m_owner->finish_cancelled(); }
+		inline void finish_below_threshold() { this->m_owner->finish_below_threshold(); }
+		inline bool should_stop() const { return this->m_owner->should_stop(); }
 	};
 	
 	
@@ -81,6 +101,105 @@ namespace text_align { namespace smith_waterman { namespace detail {
 	{
 		this->m_owner->did_calculate_score(j, i, result, initial);
 	}
+	
+	
+	template <typename t_owner>
+	void aligner_impl_base <t_owner>::did_fill_block()
+	{
+		// Count the blocks only if the delegate is interested.
+		if constexpr (t_owner::reports_block_progress())
+		{
+			auto const filled(1 + m_filled_blocks.fetch_add(1, std::memory_order_relaxed));
+			this->m_owner->did_fill_block(filled, m_parameters->lhs_segments * m_parameters->rhs_segments);
+		}
+	}
+	
+	
+	template <typename t_owner>
+	void aligner_impl_base <t_owner>::did_advance_traceback(std::size_t const lhs_pos, std::size_t const rhs_pos)
+	{
+		// The traceback proceeds from the bottom right corner to the top left one,
+		// so measure the progress with the remaining distance.
+		if constexpr (t_owner::reports_traceback_progress())
+		{
+			auto const total(this->m_owner->lhs_size() + this->m_owner->rhs_size());
+			libbio_assert(lhs_pos + rhs_pos <= total);
+			this->m_owner->did_advance_traceback(total - lhs_pos - rhs_pos, total);
+		}
+	}
+	
+	
+	template <typename t_owner>
+	void aligner_impl_base <t_owner>::prefetch_samples(std::size_t const lhs_block_idx, std::size_t const rhs_block_idx) const
+	{
+		// Read the first column and the topmost row of the block, including the final row and column.
+		auto const segment_length(m_parameters->segment_length);
+		auto const lhs_idx(segment_length * lhs_block_idx);
+		auto const rhs_idx(segment_length * rhs_block_idx);
+		m_lhs->prefetch(rhs_block_idx, lhs_idx, 1 + lhs_idx + segment_length);
+		m_rhs->prefetch(lhs_block_idx, rhs_idx, 1 + rhs_idx + segment_length);
+	}
+	
+	
+	template <typename t_owner>
+	bool aligner_impl_base <t_owner>::can_reach_min_score(std::size_t const lhs_block_idx, std::size_t const rhs_block_idx) const
+	{
+		// Every path to the cells filled in the block passes through the first column or the first row
+		// of the block, including the final row and column if they belong to the block. Bound the score
+		// of the remaining part of the path by aligning as many characters as possible with identity_score
+		// and the rest with gaps. Since a gap score does not exceed the score of its cell, this is sufficient
+		// when no edit operation scores more than a match. The blocks filled with SKIPPED_SCORE do not
+		// affect the bound, since no path through them reaches the minimum.
+		auto const segment_length(m_parameters->segment_length);
+		auto const lhs_length(m_parameters->lhs_length);
+		auto const rhs_length(m_parameters->rhs_length);
+		auto const lhs_idx(segment_length * lhs_block_idx);
+		auto const rhs_idx(segment_length * rhs_block_idx);
+		auto const lhs_limit(std::min(lhs_length, lhs_idx + segment_length));
+		auto const rhs_limit(std::min(rhs_length, rhs_idx + segment_length));
+		
+		{
+			auto const &column(m_lhs->score_samples);	// Vertical.
+			for (std::size_t j(lhs_idx); j <= lhs_limit; ++j)
+			{
+				if (can_reach_min_score(column.load(j, rhs_block_idx), j, rhs_idx))
+					return true;
+			}
+		}
+		
+		{
+			auto const &row(m_rhs->score_samples);		// Horizontal.
+			for (std::size_t i(rhs_idx); i <= rhs_limit; ++i)
+			{
+				if (can_reach_min_score(row.load(i, lhs_block_idx), lhs_idx, i))
+					return true;
+			}
+		}
+		
+		return false;
+	}
+	
+	
+	// Bound the score of the remaining part of a path from the given cell as in can_reach_min_score.
+	// Each edit operation decreases the bound at most by its score, so a path through a cell from which
+	// the minimum cannot be reached cannot reach it either from the cells that come after it.
+	template <typename t_owner>
+	auto aligner_impl_base <t_owner>::max_remaining_score(std::size_t const row, std::size_t const column) const -> score_type
+	{
+		libbio_assert(row <= m_parameters->lhs_length);
+		libbio_assert(column <= m_parameters->rhs_length);
+		auto const lhs_remaining(m_parameters->lhs_length - row);
+		auto const rhs_remaining(m_parameters->rhs_length - column);
+		auto const matches(std::min(lhs_remaining, rhs_remaining));
+		return score_type(matches) * m_parameters->identity_score + score_type(lhs_remaining + rhs_remaining - 2 * matches) * m_parameters->gap_penalty;
+	}
+	
+	
+	template <typename t_owner>
+	bool aligner_impl_base <t_owner>::can_reach_min_score(score_type const score, std::size_t const row, std::size_t const column) const
+	{
+		return m_parameters->min_score <= score + max_remaining_score(row, column);
+	}
 }}}
 
 #endif
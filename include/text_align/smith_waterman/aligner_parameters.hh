@@ -17,12 +17,17 @@ namespace text_align { namespace smith_waterman { namespace detail {
 		t_score			mismatch_penalty{-2};
 		t_score			gap_start_penalty{-3};
 		t_score			gap_penalty{-1};
+		t_score			min_score{0};	// Of the texts passed to the implementation.
 		
 		std::size_t		lhs_length{0};
 		std::size_t		rhs_length{0};
 		std::size_t		lhs_segments{0};
 		std::size_t		rhs_segments{0};
 		std::uint32_t	segment_length{0};
+		bool			has_min_score{false};
+		bool			prunes_blocks{false};
+		bool			computes_traceback{true};
+		bool			records_gap_starts{false};
 		bool			print_debugging_information{false};
 		bool			prints_values_converted_to_utf8{true};
 	};
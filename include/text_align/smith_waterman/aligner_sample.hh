@@ -6,7 +6,12 @@
 #ifndef TEXT_ALIGN_SMITH_WATERMAN_ALIGNER_SAMPLE_HH
 #define TEXT_ALIGN_SMITH_WATERMAN_ALIGNER_SAMPLE_HH
 
-#include <libbio/packed_matrix.hh>
+#include <cstdint>
+#include <string>
+#include <text_align/smith_waterman/gap_start_record_matrix.hh>
+#include <text_align/smith_waterman/sample_matrix.hh>
+#include <text_align/smith_waterman/traceback_cell_matrix.hh>
+#include <vector>
 
 
 namespace text_align { namespace smith_waterman { namespace detail {
@@ -18,22 +23,33 @@ namespace text_align { namespace smith_waterman { namespace detail {
 		typedef typename t_aligner::arrow_type					arrow_type;
 		typedef typename t_aligner::gap_start_position_type		gap_start_position_type;
 		
-		typedef typename t_aligner::score_matrix				score_matrix;
-		typedef typename t_aligner::traceback_matrix			traceback_matrix;
-		typedef typename t_aligner::gap_start_position_matrix	gap_start_position_matrix;
+		typedef typename t_aligner::score_sample_matrix			score_matrix;
+		typedef detail::gap_start_record_matrix					gap_start_record_matrix;
 		
 		score_matrix				score_samples;				// Sample vectors.
 		score_matrix				gap_score_samples;			// Sample vectors for gap start position scores.
-		traceback_matrix			traceback_samples;			// Direction sample vectors.
-		gap_start_position_matrix	gap_start_position_samples;	// Sample vectors for gap start positions.
+		traceback_cell_matrix		traceback_samples;			// Direction and gap start position sample vectors.
+		gap_start_record_matrix		gap_start_records;			// Offset of the last cell in each row (lhs) or column (rhs) of each block from which a gap may start.
+		
+		// Copy of the values in the top left corner of the sample matrices.
+		struct retained_values
+		{
+			std::vector <score_type>	scores;
+			std::vector <score_type>	gap_scores;
+			std::vector <std::uint8_t>	traceback_cells;
+			std::size_t					rows{};
+			std::size_t					columns{};
+		};
 		
 		void init(
 			std::size_t const input_length,
 			std::size_t const segments_along_axis,
+			std::size_t const segment_length,
 			arrow_type const arrow,
 			gap_start_position_type const gap_start_position,
 			score_type const gap_penalty,
-			score_type const gap_start_penalty
+			score_type const gap_start_penalty,
+			bool const records_gap_starts
 		);
 		
 		void copy_first_sample_values(
@@ -42,14 +58,24 @@ namespace text_align { namespace smith_waterman { namespace detail {
 			std::size_t const segment_count
 		);
 		
+		// Copy rows [0, row_limit) of columns [0, column_limit) to dst.
+		void retain_values(std::size_t const row_limit, std::size_t const column_limit, retained_values &dst) const;
+		
+		// Write the retained values back after init() and copy_first_sample_values().
+		void restore_values(retained_values const &src);
+		
+		inline void set_file_directory(std::string const &path);
+		void set_encoding(sample_encoding const encoding) { score_samples.set_encoding(encoding); gap_score_samples.set_encoding(encoding); }
+		void set_reserved_value(score_type const value) { score_samples.set_reserved_value(value); gap_score_samples.set_reserved_value(value); }
+		void set_max_step(std::uintmax_t const step) { score_samples.set_max_step(step); gap_score_samples.set_max_step(step); }
+		std::size_t escaped_count() const { return score_samples.escaped_count() + gap_score_samples.escaped_count(); }
+		
+		// Read rows [first, limit) of the given sample vector in advance if the samples are mapped.
+		inline void prefetch(std::size_t const column, std::size_t const first, std::size_t const limit) const;
+		
 	protected:
 		void fill_gap_scores(
-			typename score_matrix::slice_type &slice,
-			score_type const gap_penalty,
-			score_type const gap_start_penalty
-		) const;
-		void fill_gap_scores(
-			typename score_matrix::slice_type &&slice,
+			score_matrix &matrix,
 			score_type const gap_penalty,
 			score_type const gap_start_penalty
 		) const;
@@ -57,30 +83,35 @@ namespace text_align { namespace smith_waterman { namespace detail {
 	
 	
 	template <typename t_aligner>
-	void aligner_sample <t_aligner>::fill_gap_scores(
-		typename score_matrix::slice_type &slice,
-		score_type const gap_penalty,
-		score_type const gap_start_penalty
-	) const
+	void aligner_sample <t_aligner>::set_file_directory(std::string const &path)
 	{
-		std::size_t idx(0);
-		for (auto &val : slice)
-		{
-			val = idx * gap_penalty + gap_start_penalty;
-			++idx;
-		}
-		slice[0] = 0;
+		score_samples.set_file_directory(path);
+		gap_score_samples.set_file_directory(path);
+		traceback_samples.set_file_directory(path);
+		gap_start_records.set_file_directory(path);
+	}
+	
+	
+	template <typename t_aligner>
+	void aligner_sample <t_aligner>::prefetch(std::size_t const column, std::size_t const first, std::size_t const limit) const
+	{
+		score_samples.prefetch(column, first, limit);
+		gap_score_samples.prefetch(column, first, limit);
+		traceback_samples.prefetch(column, first, limit);
 	}
 	
 	
+	// Fill the first column.
 	template <typename t_aligner>
 	void aligner_sample <t_aligner>::fill_gap_scores(
-		typename score_matrix::slice_type &&slice,
+		score_matrix &matrix,
 		score_type const gap_penalty,
 		score_type const gap_start_penalty
 	) const
 	{
-		fill_gap_scores(slice, gap_penalty, gap_start_penalty);
+		matrix.store(0, 0, 0);
+		for (std::size_t idx(1), count(matrix.number_of_rows()); idx < count; ++idx)
+			matrix.store(idx, 0, idx * gap_penalty + gap_start_penalty);
 	}
 	
 	
@@ -88,50 +119,45 @@ namespace text_align { namespace smith_waterman { namespace detail {
 	void aligner_sample <t_aligner>::init(
 		std::size_t const input_length,
 		std::size_t const segments_along_axis,
+		std::size_t const segment_length,
 		arrow_type const arrow,
 		gap_start_position_type const gap_start_position,
 		score_type const gap_penalty,
-		score_type const gap_start_penalty
+		score_type const gap_start_penalty,
+		bool const records_gap_starts
 	)
 	{
 		// Reserve memory for the score samples and the scores.
-		score_samples.resize(1 + input_length, 1 + segments_along_axis);
-		gap_score_samples.resize(1 + input_length, 1 + segments_along_axis);
+		score_samples.resize(1 + input_length, 1 + segments_along_axis, segment_length);
+		gap_score_samples.resize(1 + input_length, 1 + segments_along_axis, segment_length);
 		
-		std::fill(score_samples.begin(), score_samples.end(), 0);
-		std::fill(gap_score_samples.begin(), gap_score_samples.end(), 0);
+		score_samples.fill(0);
+		gap_score_samples.fill(0);
 		
 		// Fill the first vectors with gap scores.
 		// For gap_score_samples, gap_start_penalty is added in the score calculation function.
-		fill_gap_scores(score_samples.column(0), gap_penalty, gap_start_penalty);
-		fill_gap_scores(gap_score_samples.column(0), gap_penalty, 0);
+		fill_gap_scores(score_samples, gap_penalty, gap_start_penalty);
+		fill_gap_scores(gap_score_samples, gap_penalty, 0);
 		
-		// Initialize the traceback samples.
-		{
-			libbio::matrices::initialize_atomic(traceback_samples, 1 + input_length, 1 + segments_along_axis);
-			std::fill(traceback_samples.word_begin(), traceback_samples.word_end(), 0);
-			
-			// Fill the first vectors with arrows.
-			auto column(traceback_samples.column(0));
-			libbio::matrices::fill_column_with_bit_pattern <2>(column, arrow);
+		// Initialize the traceback samples and fill the first vector with arrows and gap start positions.
+		traceback_samples.resize(1 + input_length, 1 + segments_along_axis);
+		traceback_samples.clear();
+		traceback_samples.fill_column(0, arrow, gap_start_position);
 			
-			// Add ARROW_FINISH to the corner, make sure that it does not change the previous value.
-			libbio_assert(arrow_type::ARROW_FINISH == (arrow_type::ARROW_FINISH | (column[0] & arrow_type::ARROW_MASK)));
-			column[0].fetch_or(arrow_type::ARROW_FINISH);
-		}
+		// Add ARROW_FINISH and GSP_BOTH to the corner, make sure that they do not change the previous value.
+		libbio_assert(arrow_type::ARROW_FINISH == (arrow_type::ARROW_FINISH | traceback_samples.arrow(0, 0)));
+		libbio_assert(gap_start_position_type::GSP_BOTH == (gap_start_position_type::GSP_BOTH | traceback_samples.gap_start_position(0, 0)));
+		traceback_samples.merge(0, 0, arrow_type::ARROW_FINISH, gap_start_position_type::GSP_BOTH);
 		
-		// Initialize the gap start position samples.
+		// The records are filled by the blocks; the ones not filled (e.g. retained) are not used.
+		if (records_gap_starts)
 		{
-			libbio::matrices::initialize_atomic(gap_start_position_samples, 1 + input_length, 1 + segments_along_axis);
-			std::fill(gap_start_position_samples.word_begin(), gap_start_position_samples.word_end(), 0);
-			
-			// Fill the first vector.
-			auto column(gap_start_position_samples.column(0));
-			libbio::matrices::fill_column_with_bit_pattern <2>(column, gap_start_position);
-			
-			// Add GSGT_BOTH to the corner, make sure that it does not change the previous value.
-			libbio_assert(gap_start_position_type::GSP_BOTH == (gap_start_position_type::GSP_BOTH | (column[0] & gap_start_position_type::GSP_MASK)));
-			column[0].fetch_or(gap_start_position_type::GSP_BOTH);
+			gap_start_records.resize(1 + input_length, segments_along_axis, segment_length);
+			gap_start_records.fill_unknown();
+		}
+		else
+		{
+			gap_start_records.resize(0, 0, segment_length);
 		}
 	}
 	
@@ -143,16 +169,65 @@ namespace text_align { namespace smith_waterman { namespace detail {
 		std::size_t const segment_count
 	)
 	{
-		auto const first_score_sample(src.score_samples.column(0));
-		auto const first_gap_score_sample(src.gap_score_samples.column(0));
 		for (std::size_t i(1); i < segment_count; ++i)
 		{
 			// Currently this function should only be called when these values have not been set.
-			libbio_assert(0 == score_samples(0, i));
-			libbio_assert(0 == gap_score_samples(0, i));
+			libbio_assert(0 == score_samples.load(0, i));
+			libbio_assert(0 == gap_score_samples.load(0, i));
 			
-			score_samples(0, i)		= first_score_sample[i * segment_length];
-			gap_score_samples(0, i)	= first_gap_score_sample[i * segment_length];
+			score_samples.store(0, i, src.score_samples.load(i * segment_length, 0));
+			gap_score_samples.store(0, i, src.gap_score_samples.load(i * segment_length, 0));
+		}
+	}
+	
+	
+	template <typename t_aligner>
+	void aligner_sample <t_aligner>::retain_values(
+		std::size_t const row_limit,
+		std::size_t const column_limit,
+		retained_values &dst
+	) const
+	{
+		libbio_assert(row_limit <= score_samples.number_of_rows());
+		libbio_assert(column_limit <= score_samples.number_of_columns());
+		
+		auto const count(row_limit * column_limit);
+		dst.rows = row_limit;
+		dst.columns = column_limit;
+		dst.scores.resize(count);
+		dst.gap_scores.resize(count);
+		dst.traceback_cells.resize(count);
+		
+		std::size_t k(0);
+		for (std::size_t i(0); i < column_limit; ++i)
+		{
+			score_samples.copy(i, 0, row_limit, dst.scores.begin() + k);
+			gap_score_samples.copy(i, 0, row_limit, dst.gap_scores.begin() + k);
+			for (std::size_t j(0); j < row_limit; ++j)
+				dst.traceback_cells[k + j] = traceback_samples.load(j, i);
+			k += row_limit;
+		}
+	}
+	
+	
+	template <typename t_aligner>
+	void aligner_sample <t_aligner>::restore_values(retained_values const &src)
+	{
+		libbio_assert(src.rows <= score_samples.number_of_rows());
+		libbio_assert(src.columns <= score_samples.number_of_columns());
+		
+		// The first column and row have already been initialized with the same values, so
+		// or-ing the packed values does not change them.
+		std::size_t k(0);
+		for (std::size_t i(0); i < src.columns; ++i)
+		{
+			for (std::size_t j(0); j < src.rows; ++j)
+			{
+				score_samples.store(j, i, src.scores[k + j]);
+				gap_score_samples.store(j, i, src.gap_scores[k + j]);
+				traceback_samples.merge(j, i, src.traceback_cells[k + j]);
+			}
+			k += src.rows;
 		}
 	}
 }}}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_SMITH_WATERMAN_ALIGNER_TRIMMED_IMPL_HH
+#define TEXT_ALIGN_SMITH_WATERMAN_ALIGNER_TRIMMED_IMPL_HH
+
+#include <libbio/assert.hh>
+#include <text_align/smith_waterman/aligner_impl.hh>
+#include <vector>
+
+
+namespace text_align { namespace smith_waterman { namespace detail {
+	
+	template <typename t_character>
+	struct text_span
+	{
+		t_character const	*first{};
+		t_character const	*last{};
+		
+		t_character const *begin() const { return first; }
+		t_character const *end() const { return last; }
+		std::size_t size() const { return last - first; }
+	};
+	
+	
+	// Decoded texts and the parts of them that remain after removing the common prefix and suffix.
+	template <typename t_lhs_char, typename t_rhs_char>
+	struct trimmed_texts
+	{
+		std::vector <t_lhs_char>	lhs_buffer;
+		std::vector <t_rhs_char>	rhs_buffer;
+		text_span <t_lhs_char>		lhs;
+		text_span <t_rhs_char>		rhs;
+		
+		template <typename t_lhs, typename t_rhs>
+		void assign(t_lhs const &lhs_text, t_rhs const &rhs_text, std::size_t const lhs_len, std::size_t const rhs_len);
+		
+		void set_trimmed_lengths(std::size_t const prefix_length, std::size_t const suffix_length);
+	};
+	
+	
+	// Own the decoded texts for the duration of the alignment. Since the buffers are moved,
+	// the spans remain valid.
+	template <typename t_owner, typename t_lhs_char, typename t_rhs_char>
+	class aligner_trimmed_impl final :
+		private trimmed_texts <t_lhs_char, t_rhs_char>,
+		public aligner_impl <t_owner, text_span <t_lhs_char>, text_span <t_rhs_char>>
+	{
+	protected:
+		typedef trimmed_texts <t_lhs_char, t_rhs_char>									texts_type;
+		typedef aligner_impl <t_owner, text_span <t_lhs_char>, text_span <t_rhs_char>>	superclass;
+	
+	public:
+		aligner_trimmed_impl(
+			t_owner &owner,
+			texts_type &&texts,
+			std::size_t const lhs_blocks,
+			std::size_t const rhs_blocks
+		):
+			texts_type(std::move(texts)),
+			superclass(owner, texts_type::lhs, texts_type::rhs, lhs_blocks, rhs_blocks)
+		{
+		}
+	};
+	
+	
+	template <typename t_lhs_char, typename t_rhs_char>
+	template <typename t_lhs, typename t_rhs>
+	void trimmed_texts <t_lhs_char, t_rhs_char>::assign(
+		t_lhs const &lhs_text,
+		t_rhs const &rhs_text,
+		std::size_t const lhs_len,
+		std::size_t const rhs_len
+	)
+	{
+		// The end iterator may have a different type from that of begin.
+		lhs_buffer.clear();
+		rhs_buffer.clear();
+		lhs_buffer.reserve(lhs_len);
+		rhs_buffer.reserve(rhs_len);
+		
+		{
+			auto it(lhs_text.begin());
+			auto const end(lhs_text.end());
+			for (; it != end; ++it)
+				lhs_buffer.emplace_back(*it);
+		}
+		
+		{
+			auto it(rhs_text.begin());
+			auto const end(rhs_text.end());
+			for (; it != end; ++it)
+				rhs_buffer.emplace_back(*it);
+		}
+		
+		libbio_assert(lhs_buffer.size() == lhs_len);
+		libbio_assert(rhs_buffer.size() == rhs_len);
+		set_trimmed_lengths(0, 0);
+	}
+	
+	
+	template <typename t_lhs_char, typename t_rhs_char>
+	void trimmed_texts <t_lhs_char, t_rhs_char>::set_trimmed_lengths(std::size_t const prefix_length, std::size_t const suffix_length)
+	{
+		libbio_assert(prefix_length + suffix_length <= lhs_buffer.size());
+		libbio_assert(prefix_length + suffix_length <= rhs_buffer.size());
+		lhs.first = lhs_buffer.data() + prefix_length;
+		lhs.last = lhs_buffer.data() + lhs_buffer.size() - suffix_length;
+		rhs.first = rhs_buffer.data() + prefix_length;
+		rhs.last = rhs_buffer.data() + rhs_buffer.size() - suffix_length;
+	}
+}}}
+
+#endif
@@ -6,6 +6,9 @@
 #ifndef TEXT_ALIGN_SMITH_WATERMAN_ALIGNMENT_CONTEXT_HH
 #define TEXT_ALIGN_SMITH_WATERMAN_ALIGNMENT_CONTEXT_HH
 
+#include <future>
+#include <memory>
+#include <text_align/gap_run_buffer.hh>
 #include <text_align/smith_waterman/aligner.hh>
 
 
@@ -91,6 +94,205 @@ namespace text_align { namespace smith_waterman {
 		void clear_gaps() { m_lhs_gaps.clear(); m_rhs_gaps.clear(); }
 		void reverse_gaps() { m_lhs_gaps.reverse(); m_rhs_gaps.reverse(); }
 	};
+	
+	
+	// Collect the traceback into run buffers and write the gap vectors once when the
+	// alignment is done. The vectors are exactly sized and need not be reversed.
+	template <typename t_score, typename t_word, typename t_bit_vector>
+	class buffered_alignment_context final : public alignment_context_tpl <
+		buffered_alignment_context <t_score, t_word, t_bit_vector>,
+		t_score,
+		t_word
+	>
+	{
+	protected:
+		typedef buffered_alignment_context <t_score, t_word, t_bit_vector>	self_type;
+		typedef alignment_context_tpl <self_type, t_score, t_word>			superclass;
+		
+	public:
+		typedef	t_bit_vector												bit_vector_type;
+		typedef	typename superclass::aligner_type							aligner_type;
+		friend aligner_type;
+		
+	protected:
+		gap_run_buffer	m_lhs_runs;
+		gap_run_buffer	m_rhs_runs;
+		t_bit_vector	m_lhs_gaps;
+		t_bit_vector	m_rhs_gaps;
+		
+	public:
+		using superclass::superclass;
+		
+		static constexpr bool uses_scoring_function() { return false; }
+		
+		bit_vector_type &lhs_gaps() { return m_lhs_gaps; }
+		bit_vector_type &rhs_gaps() { return m_rhs_gaps; }
+		bit_vector_type const &lhs_gaps() const { return m_lhs_gaps; }
+		bit_vector_type const &rhs_gaps() const { return m_rhs_gaps; }
+		
+	protected:
+		static void copy_runs(gap_run_buffer const &src, libbio::bit_vector &dst) { src.to_bit_vector(dst); }
+		
+		template <typename t_count>
+		static void copy_runs(gap_run_buffer const &src, libbio::rle_bit_vector <t_count> &dst) { src.to_rle_bit_vector(dst); }
+		
+		void push_lhs(bool flag, std::size_t count) { m_lhs_runs.push_back(flag, count); }
+		void push_rhs(bool flag, std::size_t count) { m_rhs_runs.push_back(flag, count); }
+		void clear_gaps() { m_lhs_runs.clear(); m_rhs_runs.clear(); }
+		void reverse_gaps() { m_lhs_runs.reverse(); m_rhs_runs.reverse(); }
+		
+		void finish(aligner_base &aligner)
+		{
+			copy_runs(m_lhs_runs, m_lhs_gaps);
+			copy_runs(m_rhs_runs, m_rhs_gaps);
+			superclass::finish(aligner);
+		}
+	};
+	
+	
+	// Collect runs of match, mismatch, insertion and deletion instead of gap vectors.
+	template <typename t_score, typename t_word>
+	class operation_alignment_context final : public alignment_context_tpl <
+		operation_alignment_context <t_score, t_word>,
+		t_score,
+		t_word
+	>
+	{
+	protected:
+		typedef operation_alignment_context <t_score, t_word>		self_type;
+		typedef alignment_context_tpl <self_type, t_score, t_word>	superclass;
+		
+	public:
+		typedef	typename superclass::aligner_type					aligner_type;
+		friend aligner_type;
+		
+	protected:
+		operation_run_vector	m_operations;
+		
+	public:
+		using superclass::superclass;
+		
+		static constexpr bool uses_scoring_function() { return false; }
+		
+		operation_run_vector &operations() { return m_operations; }
+		operation_run_vector const &operations() const { return m_operations; }
+		
+	protected:
+		void push_lhs(bool flag, std::size_t count) {}
+		void push_rhs(bool flag, std::size_t count) {}
+		void push_operation(alignment_operation op, std::size_t count) { m_operations.push_back(op, count); }
+		void clear_gaps() { m_operations.clear(); }
+		void reverse_gaps() { m_operations.reverse(); }
+	};
+	
+	
+	template <typename t_score, typename t_bit_vector>
+	struct alignment_result
+	{
+		t_score							score{};
+		aligner_base::status_type		status{};
+		t_bit_vector					lhs_gaps;
+		t_bit_vector					rhs_gaps;
+	};
+	
+	
+	// Hold an aligner that uses an IO context run by the caller, e.g. by a thread pool
+	// shared with other work. Since the context is shared, finish() does not stop it.
+	template <typename t_score, typename t_word, typename t_bit_vector>
+	class async_alignment_context final
+	{
+	public:
+		typedef aligner <t_score, t_word, async_alignment_context>	aligner_type;
+		typedef	t_bit_vector										bit_vector_type;
+		typedef alignment_result <t_score, t_bit_vector>			result_type;
+		friend aligner_type;
+		
+	protected:
+		aligner_type	m_aligner;
+		t_bit_vector	m_lhs_gaps;
+		t_bit_vector	m_rhs_gaps;
+		
+	public:
+		explicit async_alignment_context(boost::asio::io_context &ctx):
+			m_aligner(ctx, *this)
+		{
+		}
+		
+		async_alignment_context(async_alignment_context const &) = delete;
+		async_alignment_context &operator=(async_alignment_context const &) = delete;
+		
+		static constexpr bool uses_scoring_function() { return false; }
+		
+		aligner_type &get_aligner() { return m_aligner; }
+		aligner_type const &get_aligner() const { return m_aligner; }
+		
+		// Call handler with a result_type rvalue when done.
+		template <typename t_lhs, typename t_rhs, typename t_handler>
+		void align_async(
+			t_lhs const &lhs,
+			t_rhs const &rhs,
+			std::size_t const lhs_len,
+			std::size_t const rhs_len,
+			t_handler &&handler
+		);
+		
+		template <typename t_lhs, typename t_rhs>
+		std::future <result_type> align_async(
+			t_lhs const &lhs,
+			t_rhs const &rhs,
+			std::size_t const lhs_len,
+			std::size_t const rhs_len
+		);
+		
+	protected:
+		void push_lhs(bool flag, std::size_t count) { m_lhs_gaps.push_back(flag, count); }
+		void push_rhs(bool flag, std::size_t count) { m_rhs_gaps.push_back(flag, count); }
+		void clear_gaps() { m_lhs_gaps.clear(); m_rhs_gaps.clear(); }
+		void reverse_gaps() { m_lhs_gaps.reverse(); m_rhs_gaps.reverse(); }
+		void finish(aligner_base &aligner) {}
+	};
+	
+	
+	template <typename t_score, typename t_word, typename t_bit_vector>
+	template <typename t_lhs, typename t_rhs, typename t_handler>
+	void async_alignment_context <t_score, t_word, t_bit_vector>::align_async(
+		t_lhs const &lhs,
+		t_rhs const &rhs,
+		std::size_t const lhs_len,
+		std::size_t const rhs_len,
+		t_handler &&handler
+	)
+	{
+		m_aligner.align_async(
+			lhs,
+			rhs,
+			lhs_len,
+			rhs_len,
+			[this, handler = std::forward <t_handler>(handler)](aligner_type &aligner) mutable {
+				// Move the gap vectors to the result; they will be cleared before the next alignment.
+				result_type result{aligner.alignment_score(), aligner.status(), std::move(m_lhs_gaps), std::move(m_rhs_gaps)};
+				handler(std::move(result));
+			}
+		);
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_bit_vector>
+	template <typename t_lhs, typename t_rhs>
+	auto async_alignment_context <t_score, t_word, t_bit_vector>::align_async(
+		t_lhs const &lhs,
+		t_rhs const &rhs,
+		std::size_t const lhs_len,
+		std::size_t const rhs_len
+	) -> std::future <result_type>
+	{
+		std::promise <result_type> promise;
+		auto retval(promise.get_future());
+		align_async(lhs, rhs, lhs_len, rhs_len, [promise = std::move(promise)](result_type &&result) mutable {
+			promise.set_value(std::move(result));
+		});
+		return retval;
+	}
 }}
 
 #endif
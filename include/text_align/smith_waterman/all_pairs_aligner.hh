@@ -0,0 +1,466 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_SMITH_WATERMAN_ALL_PAIRS_ALIGNER_HH
+#define TEXT_ALIGN_SMITH_WATERMAN_ALL_PAIRS_ALIGNER_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <libbio/int_vector.hh>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <text_align/pair_score_file.hh>
+#include <text_align/smith_waterman/alignment_context.hh>
+#include <text_align/tokenizer.hh>
+#include <thread>
+#include <vector>
+
+
+namespace text_align { namespace smith_waterman {
+	
+	// Calculate the alignment scores of all pairs of a collection of texts with a pool of aligners
+	// that use the given execution context, and store them to a pair_score_file. The texts are decoded
+	// once, and equal texts are detected by interning them. The pairs are processed in the order of
+	// the lengths of the texts, longest first, so that the longest alignments do not remain last.
+	// The pairs already marked completed in the file are skipped. After the scores have been written,
+	// the delegate’s finish(aligner_base &) is called. If writing the file fails, the remaining pairs
+	// are not aligned, the status is STATUS_CANCELLED and error() returns the exception.
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	class all_pairs_aligner final : public aligner_base
+	{
+	public:
+		typedef t_score															score_type;
+		typedef t_character														character_type;
+		typedef t_delegate														delegate_type;
+		typedef std::vector <t_character>										text_type;
+		typedef boost::asio::io_context											context_type;
+		typedef std::chrono::steady_clock										clock_type;
+		typedef async_alignment_context <t_score, t_word, libbio::bit_vector>	alignment_context_type;
+		typedef typename alignment_context_type::result_type					result_type;
+		typedef detail::text_span <t_character>									span_type;
+		typedef pair_score_file <t_score>										score_file_type;
+	
+	protected:
+		// Keep the spans passed to align_async alive until the completion handler has been called.
+		struct pair_context
+		{
+			alignment_context_type	context;
+			span_type				lhs;
+			span_type				rhs;
+			
+			explicit pair_context(context_type &ctx): context(ctx) {}
+		};
+		
+		context_type										*m_ctx{nullptr};
+		t_delegate											*m_delegate{nullptr};
+		std::vector <std::unique_ptr <pair_context>>		m_pair_contexts;
+		std::vector <text_type>								m_texts;
+		std::vector <token_id_type>							m_text_ids;		// Equal for equal texts.
+		std::vector <std::size_t>							m_order;		// Text indices by decreasing length.
+		score_file_type										m_score_file;
+		cancellation_token									m_cancellation_token;
+		clock_type::time_point								m_deadline{clock_type::time_point::max()};
+		std::mutex											m_mutex;		// Protects the score file and the state.
+		detail::aligner_parameters <score_type>				m_parameters;
+		std::size_t											m_max_concurrent_alignments{};	// Zero for hardware concurrency.
+		std::size_t											m_sync_interval{4096};			// Pairs.
+		std::size_t											m_next_lhs{};	// Indices of the next pair in m_order.
+		std::size_t											m_next_rhs{};
+		std::size_t											m_running_alignments{};
+		std::size_t											m_unsynced_pairs{};
+		std::size_t											m_stored_pairs{};	// During the current call to align().
+		std::exception_ptr									m_error;		// Thrown when writing the score file.
+		status_type											m_status{status_type::STATUS_NONE};
+		bool												m_is_stopping{};
+	
+	public:
+		all_pairs_aligner(context_type &ctx, t_delegate &delegate):
+			m_ctx(&ctx),
+			m_delegate(&delegate)
+		{
+		}
+		
+		all_pairs_aligner(all_pairs_aligner const &) = delete;
+		all_pairs_aligner &operator=(all_pairs_aligner const &) = delete;
+		
+		delegate_type &delegate() const { return *m_delegate; }
+		
+		score_type identity_score() const { return m_parameters.identity_score; }
+		score_type mismatch_penalty() const { return m_parameters.mismatch_penalty; }
+		score_type gap_start_penalty() const { return m_parameters.gap_start_penalty; }
+		score_type gap_penalty() const { return m_parameters.gap_penalty; }
+		std::uint32_t segment_length() const { return m_parameters.segment_length; }
+		std::size_t max_concurrent_alignments() const { return m_max_concurrent_alignments; }
+		std::size_t sync_interval() const { return m_sync_interval; }
+		std::size_t stored_pair_count() const { return m_stored_pairs; }	// Not including the resumed pairs.
+		status_type status() const override { return m_status; }
+		std::exception_ptr error() const { return m_error; }
+		
+		std::vector <text_type> const &texts() const { return m_texts; }
+		score_file_type const &score_file() const { return m_score_file; }
+		
+		void set_identity_score(score_type const score) { m_parameters.identity_score = score; }
+		void set_mismatch_penalty(score_type const score) { m_parameters.mismatch_penalty = score; }
+		void set_gap_start_penalty(score_type const score) { m_parameters.gap_start_penalty = score; }
+		void set_gap_penalty(score_type const score) { m_parameters.gap_penalty = score; }
+		void set_segment_length(std::uint32_t const length) override { m_parameters.segment_length = length; }
+		void set_prints_debugging_information(bool const should_print) override { m_parameters.print_debugging_information = should_print; }
+		void set_max_concurrent_alignments(std::size_t const count) { m_max_concurrent_alignments = count; }
+		void set_sync_interval(std::size_t const count) { m_sync_interval = count; }	// Write the file after this many pairs.
+		void set_cancellation_token(cancellation_token const &token) { m_cancellation_token = token; }
+		void set_deadline(clock_type::time_point const deadline) { m_deadline = deadline; }
+		void clear_deadline() { m_deadline = clock_type::time_point::max(); }
+		
+		// Decode a text and return its index.
+		template <typename t_text>
+		std::size_t add_text(t_text const &text);
+		
+		// Open or resume the score file at the given path and align the remaining pairs.
+		void align(std::string const &path);
+	
+	protected:
+		inline bool should_stop() const;
+		std::uint64_t calculate_fingerprint() const;
+		bool scores_equal_texts_by_length() const;
+		bool find_next_pair(std::size_t &lhs_idx, std::size_t &rhs_idx);
+		bool calculate_trivial_score(std::size_t const lhs_idx, std::size_t const rhs_idx, score_type &score) const;
+		void configure_aligner(typename alignment_context_type::aligner_type &aligner) const;
+		void start_next_pair(pair_context &ctx);
+		void pair_did_finish(pair_context &ctx, std::size_t const lhs_idx, std::size_t const rhs_idx, result_type &&result);
+		void store_score(std::size_t const lhs_idx, std::size_t const rhs_idx, score_type const score);
+		void sync_score_file(bool const should_wait);
+		void finish();
+	};
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	template <typename t_text>
+	std::size_t all_pairs_aligner <t_score, t_word, t_character, t_delegate>::add_text(t_text const &text)
+	{
+		libbio_assert(0 == m_running_alignments);
+		
+		// The end iterator may have a different type from that of begin.
+		auto const retval(m_texts.size());
+		auto &dst(m_texts.emplace_back());
+		auto it(text.begin());
+		auto const end(text.end());
+		for (; it != end; ++it)
+			dst.emplace_back(*it);
+		return retval;
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void all_pairs_aligner <t_score, t_word, t_character, t_delegate>::align(std::string const &path)
+	{
+		// Only one alignment may be in progress at a time.
+		libbio_assert(0 == m_running_alignments);
+		libbio_always_assert(1 < m_texts.size());
+		
+		m_status = status_type::STATUS_NONE;
+		m_error = nullptr;
+		m_is_stopping = false;
+		m_score_file.open(path, m_texts.size(), calculate_fingerprint());
+		
+		// Intern the texts. The interner stores pointers to the texts, which are not modified any more.
+		{
+			token_interner <t_character> interner;
+			m_text_ids.clear();
+			for (auto const &text : m_texts)
+				m_text_ids.push_back(interner.intern(text.data(), text.data() + text.size()));
+		}
+		
+		// Sort by decreasing length.
+		m_order.resize(m_texts.size());
+		std::iota(m_order.begin(), m_order.end(), 0);
+		std::stable_sort(m_order.begin(), m_order.end(), [this](auto const lhs, auto const rhs){
+			return m_texts[rhs].size() < m_texts[lhs].size();
+		});
+		m_next_lhs = 0;
+		m_next_rhs = 1;
+		m_unsynced_pairs = 0;
+		m_stored_pairs = 0;
+		
+		// Instantiate the aligners.
+		std::size_t const max_concurrent(
+			m_max_concurrent_alignments
+			? m_max_concurrent_alignments
+			: std::max(1U, std::thread::hardware_concurrency())
+		);
+		auto const context_count(std::min(max_concurrent, m_score_file.pair_count()));
+		while (m_pair_contexts.size() < context_count)
+			m_pair_contexts.emplace_back(std::make_unique <pair_context>(*m_ctx));
+		
+		{
+			std::lock_guard <std::mutex> lock(m_mutex);
+			m_running_alignments = context_count;
+		}
+		
+		for (std::size_t i(0); i < context_count; ++i)
+		{
+			auto *ctx(m_pair_contexts[i].get());
+			boost::asio::post(*m_ctx, [this, ctx](){
+				start_next_pair(*ctx);
+			});
+		}
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	bool all_pairs_aligner <t_score, t_word, t_character, t_delegate>::should_stop() const
+	{
+		if (m_cancellation_token.is_cancelled())
+			return true;
+		
+		if (clock_type::time_point::max() != m_deadline && m_deadline <= clock_type::now())
+			return true;
+		
+		return false;
+	}
+	
+	
+	// Hash the scoring parameters and the texts with 64-bit FNV-1a so that a score file made for
+	// other texts or parameters is not resumed. The segment length does not affect the scores.
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	std::uint64_t all_pairs_aligner <t_score, t_word, t_character, t_delegate>::calculate_fingerprint() const
+	{
+		std::uint64_t retval(UINT64_C(0xcbf29ce484222325));
+		auto const hash([&retval](auto const &val){
+			unsigned char bytes[sizeof(val)];
+			std::memcpy(bytes, &val, sizeof(val));
+			for (auto const byte : bytes)
+			{
+				retval ^= byte;
+				retval *= UINT64_C(0x100000001b3);
+			}
+		});
+		
+		hash(m_parameters.identity_score);
+		hash(m_parameters.mismatch_penalty);
+		hash(m_parameters.gap_start_penalty);
+		hash(m_parameters.gap_penalty);
+		for (auto const &text : m_texts)
+		{
+			hash(std::uint64_t(text.size()));
+			for (auto const c : text)
+				hash(c);
+		}
+		return retval;
+	}
+	
+	
+	// If no edit operation scores more than a match, an optimal alignment of equal texts consists of matches.
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	bool all_pairs_aligner <t_score, t_word, t_character, t_delegate>::scores_equal_texts_by_length() const
+	{
+		return (
+			0 <= m_parameters.identity_score &&
+			m_parameters.mismatch_penalty <= m_parameters.identity_score &&
+			m_parameters.gap_start_penalty <= 0 &&
+			m_parameters.gap_penalty <= 0
+		);
+	}
+	
+	
+	// Find the next pair that has not been completed. Called with m_mutex locked.
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	bool all_pairs_aligner <t_score, t_word, t_character, t_delegate>::find_next_pair(std::size_t &lhs_idx, std::size_t &rhs_idx)
+	{
+		auto const text_count(m_order.size());
+		while (m_next_lhs + 1 < text_count)
+		{
+			lhs_idx = m_order[m_next_lhs];
+			rhs_idx = m_order[m_next_rhs];
+			
+			++m_next_rhs;
+			if (text_count == m_next_rhs)
+			{
+				++m_next_lhs;
+				m_next_rhs = 1 + m_next_lhs;
+			}
+			
+			if (!m_score_file.is_completed(lhs_idx, rhs_idx))
+				return true;
+		}
+		
+		return false;
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	bool all_pairs_aligner <t_score, t_word, t_character, t_delegate>::calculate_trivial_score(
+		std::size_t const lhs_idx,
+		std::size_t const rhs_idx,
+		score_type &score
+	) const
+	{
+		auto const lhs_len(m_texts[lhs_idx].size());
+		auto const rhs_len(m_texts[rhs_idx].size());
+		
+		// The aligner requires non-empty texts.
+		if (0 == lhs_len || 0 == rhs_len)
+		{
+			auto const len(lhs_len + rhs_len);
+			score = (len ? m_parameters.gap_start_penalty + score_type(len) * m_parameters.gap_penalty : 0);
+			return true;
+		}
+		
+		if (m_text_ids[lhs_idx] == m_text_ids[rhs_idx] && scores_equal_texts_by_length())
+		{
+			score = score_type(lhs_len) * m_parameters.identity_score;
+			return true;
+		}
+		
+		return false;
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void all_pairs_aligner <t_score, t_word, t_character, t_delegate>::configure_aligner(
+		typename alignment_context_type::aligner_type &aligner
+	) const
+	{
+		aligner.set_identity_score(m_parameters.identity_score);
+		aligner.set_mismatch_penalty(m_parameters.mismatch_penalty);
+		aligner.set_gap_start_penalty(m_parameters.gap_start_penalty);
+		aligner.set_gap_penalty(m_parameters.gap_penalty);
+		aligner.set_segment_length(m_parameters.segment_length); // Zero for determining from the text.
+		aligner.set_prints_debugging_information(m_parameters.print_debugging_information);
+		aligner.set_cancellation_token(m_cancellation_token);
+		aligner.set_deadline(m_deadline);
+		aligner.set_computes_traceback(false);
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void all_pairs_aligner <t_score, t_word, t_character, t_delegate>::start_next_pair(pair_context &ctx)
+	{
+		while (true)
+		{
+			std::size_t lhs_idx(0);
+			std::size_t rhs_idx(0);
+			bool is_last(false);
+			
+			{
+				std::lock_guard <std::mutex> lock(m_mutex);
+				if (should_stop())
+					m_is_stopping = true;
+				
+				if (m_is_stopping || !find_next_pair(lhs_idx, rhs_idx))
+				{
+					is_last = (0 == --m_running_alignments);
+					if (!is_last)
+						return;
+				}
+			}
+			
+			if (is_last)
+			{
+				finish();
+				return;
+			}
+			
+			score_type score(0);
+			if (calculate_trivial_score(lhs_idx, rhs_idx, score))
+			{
+				store_score(lhs_idx, rhs_idx, score);
+				continue;
+			}
+			
+			configure_aligner(ctx.context.get_aligner());
+			auto const &lhs(m_texts[lhs_idx]);
+			auto const &rhs(m_texts[rhs_idx]);
+			ctx.lhs = span_type{lhs.data(), lhs.data() + lhs.size()};
+			ctx.rhs = span_type{rhs.data(), rhs.data() + rhs.size()};
+			ctx.context.align_async(
+				ctx.lhs,
+				ctx.rhs,
+				ctx.lhs.size(),
+				ctx.rhs.size(),
+				[this, &ctx, lhs_idx, rhs_idx](result_type &&result){
+					pair_did_finish(ctx, lhs_idx, rhs_idx, std::move(result));
+				}
+			);
+			return;
+		}
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void all_pairs_aligner <t_score, t_word, t_character, t_delegate>::pair_did_finish(
+		pair_context &ctx,
+		std::size_t const lhs_idx,
+		std::size_t const rhs_idx,
+		result_type &&result
+	)
+	{
+		if (status_type::STATUS_FINISHED == result.status)
+			store_score(lhs_idx, rhs_idx, result.score);
+		else
+		{
+			std::lock_guard <std::mutex> lock(m_mutex);
+			m_is_stopping = true;
+		}
+		
+		// Reuse the aligner for the next pair.
+		start_next_pair(ctx);
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void all_pairs_aligner <t_score, t_word, t_character, t_delegate>::store_score(
+		std::size_t const lhs_idx,
+		std::size_t const rhs_idx,
+		score_type const score
+	)
+	{
+		std::lock_guard <std::mutex> lock(m_mutex);
+		m_score_file.set_score(lhs_idx, rhs_idx, score);
+		++m_stored_pairs;
+		
+		// Checkpoint without waiting.
+		++m_unsynced_pairs;
+		if (m_sync_interval <= m_unsynced_pairs)
+		{
+			sync_score_file(false);
+			m_unsynced_pairs = 0;
+		}
+	}
+	
+	
+	// Called on the threads that run the execution context, so nothing may be thrown; otherwise
+	// the running alignments would not be counted and finish() would not be called. Called with
+	// m_mutex locked or after the alignments have finished.
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void all_pairs_aligner <t_score, t_word, t_character, t_delegate>::sync_score_file(bool const should_wait)
+	{
+		try
+		{
+			m_score_file.sync(should_wait);
+		}
+		catch (...)
+		{
+			if (!m_error)
+				m_error = std::current_exception();
+			m_is_stopping = true;
+		}
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void all_pairs_aligner <t_score, t_word, t_character, t_delegate>::finish()
+	{
+		// Keep the file open so that the scores may be read.
+		sync_score_file(true);
+		m_status = (m_is_stopping ? status_type::STATUS_CANCELLED : status_type::STATUS_FINISHED);
+		m_delegate->finish(*this);
+	}
+}}
+
+#endif
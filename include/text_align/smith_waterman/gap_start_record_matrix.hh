@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_SMITH_WATERMAN_GAP_START_RECORD_MATRIX_HH
+#define TEXT_ALIGN_SMITH_WATERMAN_GAP_START_RECORD_MATRIX_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <libbio/assert.hh>
+#include <limits>
+#include <string>
+#include <text_align/smith_waterman/mapped_buffer.hh>
+
+
+namespace text_align { namespace smith_waterman { namespace detail {
+	
+	// Offset of the last gap start position in each row (lhs) or column (rhs) of each block. The offsets
+	// do not exceed the segment length, so they are stored as std::uint16_t unless the segment length
+	// is too great for it. Like the score samples, the records may be stored in a memory-mapped file.
+	class gap_start_record_matrix
+	{
+	public:
+		// Values other than offsets from the beginning of the block.
+		enum gap_start_record : std::uint32_t
+		{
+			GAP_START_NONE		= 0,
+			GAP_START_UNKNOWN	= std::numeric_limits <std::uint32_t>::max()
+		};
+	
+	protected:
+		mapped_buffer				m_storage;	// Column-major.
+		std::size_t					m_rows{};
+		std::size_t					m_columns{};
+		bool						m_is_wide{};
+	
+	public:
+		// Map the records from a file in the given directory on the next resize. Empty for memory.
+		void set_file_directory(std::string const &path) { m_storage.set_file_directory(path); }
+		bool is_mapped() const { return m_storage.is_mapped(); }
+		
+		// The values are unspecified after resizing.
+		inline void resize(std::size_t const rows, std::size_t const columns, std::size_t const segment_length);
+		
+		// All bits set is GAP_START_UNKNOWN in both widths.
+		void fill_unknown() { std::fill(m_storage.data(), m_storage.data() + m_storage.size(), 0xff); }
+		
+		std::size_t number_of_rows() const { return m_rows; }
+		std::size_t number_of_columns() const { return m_columns; }
+		std::size_t element_size() const { return m_is_wide ? sizeof(std::uint32_t) : sizeof(std::uint16_t); }
+		
+		inline std::uint32_t load(std::size_t const row, std::size_t const column) const;
+		inline void store(std::size_t const row, std::size_t const column, std::uint32_t const value);
+	
+	protected:
+		std::size_t index(std::size_t const row, std::size_t const column) const { libbio_assert(row < m_rows); libbio_assert(column < m_columns); return column * m_rows + row; }
+	};
+	
+	
+	void gap_start_record_matrix::resize(std::size_t const rows, std::size_t const columns, std::size_t const segment_length)
+	{
+		m_rows = rows;
+		m_columns = columns;
+		m_is_wide = (std::numeric_limits <std::uint16_t>::max() <= segment_length);
+		m_storage.resize(rows * columns * element_size());
+	}
+	
+	
+	std::uint32_t gap_start_record_matrix::load(std::size_t const row, std::size_t const column) const
+	{
+		auto const idx(index(row, column));
+		if (m_is_wide)
+			return reinterpret_cast <std::uint32_t const *>(m_storage.data())[idx];
+		
+		auto const value(reinterpret_cast <std::uint16_t const *>(m_storage.data())[idx]);
+		return (std::numeric_limits <std::uint16_t>::max() == value ? GAP_START_UNKNOWN : value);
+	}
+	
+	
+	void gap_start_record_matrix::store(std::size_t const row, std::size_t const column, std::uint32_t const value)
+	{
+		auto const idx(index(row, column));
+		if (m_is_wide)
+			reinterpret_cast <std::uint32_t *>(m_storage.data())[idx] = value;
+		else
+		{
+			libbio_assert(GAP_START_UNKNOWN == value || value < std::numeric_limits <std::uint16_t>::max());
+			reinterpret_cast <std::uint16_t *>(m_storage.data())[idx] = value;
+		}
+	}
+}}}
+
+#endif
@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_SMITH_WATERMAN_MAPPED_BUFFER_HH
+#define TEXT_ALIGN_SMITH_WATERMAN_MAPPED_BUFFER_HH
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+
+namespace text_align { namespace smith_waterman { namespace detail {
+	
+	// Bytes stored either in memory or, if a directory has been set, in a memory-mapped temporary file
+	// that is removed when the buffer is released. The pages may then be evicted by the operating system,
+	// so the size of the buffer is not limited by the memory.
+	class mapped_buffer
+	{
+	protected:
+		std::vector <char>	m_buffer;		// Used if the bytes are not mapped.
+		std::string			m_directory;
+		char				*m_data{};
+		std::size_t			m_size{};
+		std::size_t			m_mapped_size{};
+		int					m_fd{-1};
+	
+	public:
+		mapped_buffer() = default;
+		~mapped_buffer() { unmap(); }
+		
+		mapped_buffer(mapped_buffer const &) = delete;
+		mapped_buffer &operator=(mapped_buffer const &) = delete;
+		
+		mapped_buffer(mapped_buffer &&other) { *this = std::move(other); }
+		inline mapped_buffer &operator=(mapped_buffer &&other);
+		
+		// Map the bytes from a file in the given directory on the next resize. Empty for memory.
+		void set_file_directory(std::string const &path) { m_directory = path; }
+		std::string const &file_directory() const { return m_directory; }
+		bool is_mapped() const { return -1 != m_fd; }
+		
+		// The contents are unspecified after resizing.
+		inline void resize(std::size_t const size);
+		
+		char *data() { return m_data; }
+		char const *data() const { return m_data; }
+		std::size_t size() const { return m_size; }
+		
+		// Ask the operating system to read the given range if the bytes are mapped.
+		inline void prefetch(std::size_t const offset, std::size_t length) const;
+	
+	protected:
+		inline void map(std::size_t const size);
+		inline void unmap();
+		[[noreturn]] static void throw_error(char const *message) { throw std::runtime_error(std::string(message) + ": " + std::strerror(errno)); }
+	};
+	
+	
+	auto mapped_buffer::operator=(mapped_buffer &&other) -> mapped_buffer &
+	{
+		if (this != &other)
+		{
+			unmap();
+			m_buffer = std::move(other.m_buffer);
+			m_directory = std::move(other.m_directory);
+			m_data = other.m_data;
+			m_size = other.m_size;
+			m_mapped_size = other.m_mapped_size;
+			m_fd = other.m_fd;
+			
+			other.m_data = nullptr;
+			other.m_size = 0;
+			other.m_mapped_size = 0;
+			other.m_fd = -1;
+		}
+		return *this;
+	}
+	
+	
+	void mapped_buffer::resize(std::size_t const size)
+	{
+		if (m_directory.empty())
+		{
+			unmap();
+			m_buffer.resize(size);
+			m_data = m_buffer.data();
+		}
+		else
+		{
+			m_buffer.clear();
+			m_buffer.shrink_to_fit();
+			map(size);
+		}
+		m_size = size;
+	}
+	
+	
+	void mapped_buffer::map(std::size_t const size)
+	{
+		// Reuse the file if the size does not change.
+		if (is_mapped() && size == m_mapped_size)
+			return;
+		
+		if (!is_mapped())
+		{
+			// Remove the file immediately so that it is not left behind.
+			std::string path(m_directory + "/text_align_samples.XXXXXX");
+			m_fd = ::mkstemp(path.data());
+			if (-1 == m_fd)
+				throw_error("Unable to create the sample file");
+			::unlink(path.c_str());
+		}
+		else
+		{
+			if (m_data)
+				::munmap(m_data, m_mapped_size);
+			m_data = nullptr;
+			m_mapped_size = 0;
+		}
+		
+		if (-1 == ::ftruncate(m_fd, size))
+			throw_error("Unable to resize the sample file");
+		
+		if (size)
+		{
+			auto *data(::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0));
+			if (MAP_FAILED == data)
+				throw_error("Unable to map the sample file");
+			m_data = static_cast <char *>(data);
+		}
+		m_mapped_size = size;
+	}
+	
+	
+	void mapped_buffer::unmap()
+	{
+		if (is_mapped())
+		{
+			if (m_data)
+				::munmap(m_data, m_mapped_size);
+			::close(m_fd);
+			m_data = nullptr;
+			m_size = 0;
+			m_mapped_size = 0;
+			m_fd = -1;
+		}
+	}
+	
+	
+	void mapped_buffer::prefetch(std::size_t const offset, std::size_t length) const
+	{
+		if (!is_mapped() || m_size <= offset)
+			return;
+		length = std::min(length, m_size - offset);
+		if (!length)
+			return;
+		
+		// madvise requires a page-aligned address. The advice is only a hint, so the return value is not checked.
+		static std::uintptr_t const page_size(::sysconf(_SC_PAGESIZE));
+		auto const begin(reinterpret_cast <std::uintptr_t>(m_data + offset));
+		auto const end(begin + length);
+		auto const aligned_begin(begin & ~(page_size - 1));
+		::madvise(reinterpret_cast <void *>(aligned_begin), end - aligned_begin, MADV_WILLNEED);
+	}
+}}}
+
+#endif
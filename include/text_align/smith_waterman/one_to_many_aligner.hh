@@ -0,0 +1,531 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_SMITH_WATERMAN_ONE_TO_MANY_ALIGNER_HH
+#define TEXT_ALIGN_SMITH_WATERMAN_ONE_TO_MANY_ALIGNER_HH
+
+#include <algorithm>
+#include <deque>
+#include <libbio/int_vector.hh>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <text_align/qgram_filter.hh>
+#include <text_align/smith_waterman/alignment_context.hh>
+#include <thread>
+#include <vector>
+
+
+namespace text_align { namespace smith_waterman {
+	
+	// Align one query text against many candidate texts with a pool of aligners that use the given
+	// execution context. The query is decoded once, and the aligners are reused for the candidates.
+	// Candidates may also be added while the alignment is in progress. The delegate receives
+	// the result of each candidate through did_align_candidate(aligner_base &, std::size_t, result_type &&)
+	// either in the order of the candidates or in the order of completion, and after end_candidates()
+	// and the remaining alignments, finish(aligner_base &) is called. The calls to the delegate are
+	// serialized but may be made from any of the threads that run the execution context.
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	class one_to_many_aligner final : public aligner_base
+	{
+	public:
+		typedef t_score															score_type;
+		typedef t_character														character_type;
+		typedef t_delegate														delegate_type;
+		typedef std::vector <t_character>										text_type;
+		typedef boost::asio::io_context											context_type;
+		typedef std::chrono::steady_clock										clock_type;
+		typedef async_alignment_context <t_score, t_word, libbio::bit_vector>	alignment_context_type;
+		typedef typename alignment_context_type::result_type					result_type;
+		typedef detail::text_span <t_character>									span_type;
+	
+	protected:
+		// Keep the spans passed to align_async alive until the completion handler has been called.
+		struct candidate_context
+		{
+			alignment_context_type	context;
+			span_type				query;
+			span_type				candidate;
+			
+			explicit candidate_context(context_type &ctx): context(ctx) {}
+		};
+		
+		context_type											*m_ctx{nullptr};
+		t_delegate												*m_delegate{nullptr};
+		std::vector <std::unique_ptr <candidate_context>>		m_candidate_contexts;
+		std::vector <candidate_context *>						m_idle_contexts;
+		text_type												m_query;
+		qgram_profile											m_query_profile;
+		std::deque <text_type>									m_candidates;	// Not invalidated by push_back.
+		std::deque <std::optional <result_type>>				m_results;		// Not yet reported.
+		cancellation_token										m_cancellation_token;
+		clock_type::time_point									m_deadline{clock_type::time_point::max()};
+		std::mutex												m_mutex;		// Protects the candidates, the results and the state.
+		std::mutex												m_report_mutex;	// Serializes the calls to the delegate.
+		detail::aligner_parameters <score_type>					m_parameters;
+		std::size_t												m_max_concurrent_alignments{};	// Zero for hardware concurrency.
+		std::size_t												m_qgram_length{3};
+		std::size_t												m_next_candidate{};
+		std::size_t												m_next_reported{};
+		std::size_t												m_running_alignments{};
+		score_type												m_min_score{};
+		status_type												m_status{status_type::STATUS_NONE};
+		bool													m_reverses_texts{};
+		bool													m_reports_in_order{true};
+		bool													m_has_min_score{};
+		bool													m_is_running{};
+		bool													m_has_all_candidates{};
+		bool													m_is_stopping{};
+	
+	public:
+		one_to_many_aligner(context_type &ctx, t_delegate &delegate):
+			m_ctx(&ctx),
+			m_delegate(&delegate)
+		{
+		}
+		
+		one_to_many_aligner(one_to_many_aligner const &) = delete;
+		one_to_many_aligner &operator=(one_to_many_aligner const &) = delete;
+		
+		delegate_type &delegate() const { return *m_delegate; }
+		
+		score_type identity_score() const { return m_parameters.identity_score; }
+		score_type mismatch_penalty() const { return m_parameters.mismatch_penalty; }
+		score_type gap_start_penalty() const { return m_parameters.gap_start_penalty; }
+		score_type gap_penalty() const { return m_parameters.gap_penalty; }
+		std::uint32_t segment_length() const { return m_parameters.segment_length; }
+		std::size_t max_concurrent_alignments() const { return m_max_concurrent_alignments; }
+		std::size_t qgram_length() const { return m_qgram_length; }
+		bool reverses_texts() const { return m_reverses_texts; }
+		bool reports_in_order() const { return m_reports_in_order; }
+		bool has_min_score() const { return m_has_min_score; }
+		score_type min_score() const { return m_min_score; }
+		status_type status() const override { return m_status; }
+		
+		text_type const &query_text() const { return m_query; }
+		
+		void set_identity_score(score_type const score) { m_parameters.identity_score = score; }
+		void set_mismatch_penalty(score_type const score) { m_parameters.mismatch_penalty = score; }
+		void set_gap_start_penalty(score_type const score) { m_parameters.gap_start_penalty = score; }
+		void set_gap_penalty(score_type const score) { m_parameters.gap_penalty = score; }
+		void set_segment_length(std::uint32_t const length) override { m_parameters.segment_length = length; }
+		void set_prints_debugging_information(bool const should_print) override { m_parameters.print_debugging_information = should_print; }
+		void set_max_concurrent_alignments(std::size_t const count) { m_max_concurrent_alignments = count; }
+		void set_qgram_length(std::size_t const length) { libbio_always_assert(0 < length); m_qgram_length = length; }
+		void set_reverses_texts(bool const flag) { m_reverses_texts = flag; }
+		void set_reports_in_order(bool const flag) { m_reports_in_order = flag; }	// If false, report in the order of completion.
+		void set_cancellation_token(cancellation_token const &token) { m_cancellation_token = token; }
+		void set_deadline(clock_type::time_point const deadline) { m_deadline = deadline; }
+		void clear_deadline() { m_deadline = clock_type::time_point::max(); }
+		
+		// Report the candidates whose score would be less than the minimum with STATUS_BELOW_THRESHOLD.
+		// The candidates are first checked with the q-gram bound against the profile of the query.
+		void set_min_score(score_type const score) { m_min_score = score; m_has_min_score = true; }
+		void clear_min_score() { m_has_min_score = false; }
+		
+		// Decode the query. Not to be called while the alignment is in progress.
+		template <typename t_query>
+		void set_query(t_query const &query);
+		
+		// Decode a candidate and return its index. May be called from any thread.
+		template <typename t_text>
+		std::size_t add_candidate(t_text const &text);
+		
+		// Start aligning the candidates added so far and the ones added later.
+		void align_candidates();
+		
+		// Finish after the candidates added so far have been aligned.
+		void end_candidates();
+	
+	protected:
+		template <typename t_text>
+		static void copy_text(t_text const &src, text_type &dst);
+		
+		inline bool should_stop() const;
+		bool can_skip_candidate(text_type const &text) const;
+		bool make_trivial_result(text_type const &text, result_type &result) const;
+		void configure_aligner(typename alignment_context_type::aligner_type &aligner) const;
+		void start_next_candidate(candidate_context &ctx);
+		void candidate_did_finish(candidate_context &ctx, std::size_t const idx, result_type &&result);
+		void report_result(std::size_t const idx, result_type &&result);
+		bool should_finish() const { return m_is_running && 0 == m_running_alignments && (m_has_all_candidates || m_is_stopping); }
+		void finish();
+	};
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	template <typename t_text>
+	void one_to_many_aligner <t_score, t_word, t_character, t_delegate>::copy_text(t_text const &src, text_type &dst)
+	{
+		// The end iterator may have a different type from that of begin.
+		dst.clear();
+		auto it(src.begin());
+		auto const end(src.end());
+		for (; it != end; ++it)
+			dst.emplace_back(*it);
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	template <typename t_query>
+	void one_to_many_aligner <t_score, t_word, t_character, t_delegate>::set_query(t_query const &query)
+	{
+		libbio_assert(!m_is_running);
+		copy_text(query, m_query);
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	template <typename t_text>
+	std::size_t one_to_many_aligner <t_score, t_word, t_character, t_delegate>::add_candidate(t_text const &text)
+	{
+		// Decode before locking.
+		text_type buffer;
+		copy_text(text, buffer);
+		
+		candidate_context *ctx(nullptr);
+		std::size_t retval(0);
+		
+		{
+			std::lock_guard <std::mutex> lock(m_mutex);
+			libbio_assert(!m_has_all_candidates);
+			retval = m_candidates.size();
+			m_candidates.emplace_back(std::move(buffer));
+			m_results.emplace_back();
+			
+			// Wake up an idle aligner.
+			if (m_is_running && !m_is_stopping && !m_idle_contexts.empty())
+			{
+				ctx = m_idle_contexts.back();
+				m_idle_contexts.pop_back();
+				++m_running_alignments;
+			}
+		}
+		
+		if (ctx)
+		{
+			boost::asio::post(*m_ctx, [this, ctx](){
+				start_next_candidate(*ctx);
+			});
+		}
+		
+		return retval;
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void one_to_many_aligner <t_score, t_word, t_character, t_delegate>::align_candidates()
+	{
+		// Only one alignment may be in progress at a time.
+		libbio_assert(!m_is_running);
+		
+		if (m_has_min_score)
+			m_query_profile.assign(m_query, m_qgram_length);
+		
+		std::vector <candidate_context *> started_contexts;
+		bool is_last(false);	// If end_candidates() was called and there are no candidates.
+		
+		{
+			std::lock_guard <std::mutex> lock(m_mutex);
+			m_status = status_type::STATUS_NONE;
+			m_is_running = true;
+			m_is_stopping = false;
+			
+			// Instantiate the aligners.
+			std::size_t const max_concurrent(
+				m_max_concurrent_alignments
+				? m_max_concurrent_alignments
+				: std::max(1U, std::thread::hardware_concurrency())
+			);
+			while (m_candidate_contexts.size() < max_concurrent)
+				m_candidate_contexts.emplace_back(std::make_unique <candidate_context>(*m_ctx));
+			
+			m_idle_contexts.clear();
+			for (auto &ctx_ptr : m_candidate_contexts)
+				m_idle_contexts.push_back(ctx_ptr.get());
+			
+			auto const count(std::min(m_idle_contexts.size(), m_candidates.size() - m_next_candidate));
+			for (std::size_t i(0); i < count; ++i)
+			{
+				started_contexts.push_back(m_idle_contexts.back());
+				m_idle_contexts.pop_back();
+			}
+			m_running_alignments = count;
+			is_last = should_finish();
+		}
+		
+		// Finish from the execution context as in the general case.
+		if (is_last)
+		{
+			boost::asio::post(*m_ctx, [this](){ finish(); });
+			return;
+		}
+		
+		for (auto *ctx : started_contexts)
+		{
+			boost::asio::post(*m_ctx, [this, ctx](){
+				start_next_candidate(*ctx);
+			});
+		}
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void one_to_many_aligner <t_score, t_word, t_character, t_delegate>::end_candidates()
+	{
+		bool is_last(false);
+		
+		{
+			std::lock_guard <std::mutex> lock(m_mutex);
+			m_has_all_candidates = true;
+			is_last = should_finish();
+		}
+		
+		// Finish from the execution context as in the general case.
+		if (is_last)
+			boost::asio::post(*m_ctx, [this](){ finish(); });
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	bool one_to_many_aligner <t_score, t_word, t_character, t_delegate>::should_stop() const
+	{
+		if (m_cancellation_token.is_cancelled())
+			return true;
+		
+		if (clock_type::time_point::max() != m_deadline && m_deadline <= clock_type::now())
+			return true;
+		
+		return false;
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	bool one_to_many_aligner <t_score, t_word, t_character, t_delegate>::can_skip_candidate(text_type const &text) const
+	{
+		if (!m_has_min_score)
+			return false;
+		
+		qgram_profile const profile(text, m_qgram_length);
+		auto const lhs_len(m_query.size());
+		auto const rhs_len(text.size());
+		auto const min_edits(edit_distance_lower_bound(lhs_len, rhs_len, m_query_profile.count_common(profile), m_qgram_length));
+		auto const max_score(alignment_score_upper_bound(
+			lhs_len,
+			rhs_len,
+			min_edits,
+			m_parameters.identity_score,
+			m_parameters.mismatch_penalty,
+			m_parameters.gap_start_penalty,
+			m_parameters.gap_penalty
+		));
+		return max_score < m_min_score;
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	bool one_to_many_aligner <t_score, t_word, t_character, t_delegate>::make_trivial_result(
+		text_type const &text,
+		result_type &result
+	) const
+	{
+		// The aligner requires non-empty texts; if either one is empty, only one alignment is possible.
+		auto const lhs_len(m_query.size());
+		auto const rhs_len(text.size());
+		if (lhs_len && rhs_len)
+			return false;
+		
+		result = result_type();
+		result.status = status_type::STATUS_FINISHED;
+		if (lhs_len)
+		{
+			result.lhs_gaps.push_back(0, lhs_len);
+			result.rhs_gaps.push_back(1, lhs_len);
+			result.score = m_parameters.gap_start_penalty + score_type(lhs_len) * m_parameters.gap_penalty;
+		}
+		else if (rhs_len)
+		{
+			result.lhs_gaps.push_back(1, rhs_len);
+			result.rhs_gaps.push_back(0, rhs_len);
+			result.score = m_parameters.gap_start_penalty + score_type(rhs_len) * m_parameters.gap_penalty;
+		}
+		
+		if (m_has_min_score && result.score < m_min_score)
+			result = result_type{0, status_type::STATUS_BELOW_THRESHOLD};
+		
+		return true;
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void one_to_many_aligner <t_score, t_word, t_character, t_delegate>::configure_aligner(
+		typename alignment_context_type::aligner_type &aligner
+	) const
+	{
+		aligner.set_identity_score(m_parameters.identity_score);
+		aligner.set_mismatch_penalty(m_parameters.mismatch_penalty);
+		aligner.set_gap_start_penalty(m_parameters.gap_start_penalty);
+		aligner.set_gap_penalty(m_parameters.gap_penalty);
+		aligner.set_segment_length(m_parameters.segment_length); // Zero for determining from the text.
+		aligner.set_prints_debugging_information(m_parameters.print_debugging_information);
+		aligner.set_reverses_texts(m_reverses_texts);
+		aligner.set_cancellation_token(m_cancellation_token);
+		aligner.set_deadline(m_deadline);
+		
+		if (m_has_min_score)
+			aligner.set_min_score(m_min_score);
+		else
+			aligner.clear_min_score();
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void one_to_many_aligner <t_score, t_word, t_character, t_delegate>::start_next_candidate(candidate_context &ctx)
+	{
+		while (true)
+		{
+			std::size_t idx(0);
+			text_type const *text(nullptr);
+			bool is_last(false);
+			
+			{
+				std::lock_guard <std::mutex> lock(m_mutex);
+				if (should_stop())
+					m_is_stopping = true;
+				
+				if (m_is_stopping || m_candidates.size() == m_next_candidate)
+				{
+					// Wait for more candidates.
+					m_idle_contexts.push_back(&ctx);
+					--m_running_alignments;
+					is_last = should_finish();
+				}
+				else
+				{
+					idx = m_next_candidate++;
+					text = &m_candidates[idx];
+				}
+			}
+			
+			if (!text)
+			{
+				if (is_last)
+					finish();
+				return;
+			}
+			
+			// Report the candidates that need not be aligned immediately.
+			result_type result;
+			if (make_trivial_result(*text, result))
+			{
+				report_result(idx, std::move(result));
+				continue;
+			}
+			
+			if (can_skip_candidate(*text))
+			{
+				report_result(idx, result_type{0, status_type::STATUS_BELOW_THRESHOLD});
+				continue;
+			}
+			
+			configure_aligner(ctx.context.get_aligner());
+			ctx.query = span_type{m_query.data(), m_query.data() + m_query.size()};
+			ctx.candidate = span_type{text->data(), text->data() + text->size()};
+			ctx.context.align_async(
+				ctx.query,
+				ctx.candidate,
+				ctx.query.size(),
+				ctx.candidate.size(),
+				[this, &ctx, idx](result_type &&result){
+					candidate_did_finish(ctx, idx, std::move(result));
+				}
+			);
+			return;
+		}
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void one_to_many_aligner <t_score, t_word, t_character, t_delegate>::candidate_did_finish(
+		candidate_context &ctx,
+		std::size_t const idx,
+		result_type &&result
+	)
+	{
+		if (status_type::STATUS_CANCELLED == result.status)
+		{
+			std::lock_guard <std::mutex> lock(m_mutex);
+			m_is_stopping = true;
+		}
+		
+		// Report before the aligner becomes idle so that finish() is called after the last report.
+		report_result(idx, std::move(result));
+		
+		// Reuse the aligner for the next candidate.
+		start_next_candidate(ctx);
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void one_to_many_aligner <t_score, t_word, t_character, t_delegate>::report_result(std::size_t const idx, result_type &&result)
+	{
+		std::lock_guard <std::mutex> report_lock(m_report_mutex);
+		
+		{
+			// The candidate is no longer needed.
+			std::lock_guard <std::mutex> lock(m_mutex);
+			text_type().swap(m_candidates[idx]);
+			
+			if (m_reports_in_order)
+				m_results[idx] = std::move(result);
+		}
+		
+		if (!m_reports_in_order)
+		{
+			m_delegate->did_align_candidate(*this, idx, std::move(result));
+			return;
+		}
+		
+		// Report the results that are next in order.
+		while (true)
+		{
+			std::optional <result_type> next_result;
+			std::size_t next_idx(0);
+			
+			{
+				std::lock_guard <std::mutex> lock(m_mutex);
+				if (m_results.size() == m_next_reported || !m_results[m_next_reported])
+					return;
+				
+				next_idx = m_next_reported++;
+				next_result.swap(m_results[next_idx]);
+			}
+			
+			m_delegate->did_align_candidate(*this, next_idx, std::move(*next_result));
+		}
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void one_to_many_aligner <t_score, t_word, t_character, t_delegate>::finish()
+	{
+		{
+			// Results that were not reported before stopping are discarded.
+			std::lock_guard <std::mutex> lock(m_mutex);
+			m_status = (m_is_stopping ? status_type::STATUS_CANCELLED : status_type::STATUS_FINISHED);
+			m_is_running = false;
+			m_has_all_candidates = false;
+			m_candidates.clear();
+			m_results.clear();
+			m_next_candidate = 0;
+			m_next_reported = 0;
+		}
+		
+		std::lock_guard <std::mutex> report_lock(m_report_mutex);
+		m_delegate->finish(*this);
+	}
+}}
+
+#endif
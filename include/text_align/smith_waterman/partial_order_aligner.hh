@@ -0,0 +1,552 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_SMITH_WATERMAN_PARTIAL_ORDER_ALIGNER_HH
+#define TEXT_ALIGN_SMITH_WATERMAN_PARTIAL_ORDER_ALIGNER_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <libbio/algorithm.hh>
+#include <libbio/assert.hh>
+#include <limits>
+#include <stdexcept>
+#include <text_align/alignment_graph_builder.hh>
+#include <text_align/multiple_alignment_graph_builder.hh>
+#include <text_align/smith_waterman/aligner_parameters.hh>
+#include <utility>
+#include <vector>
+
+
+namespace text_align { namespace smith_waterman {
+	
+	// Align texts to the graph of common and distinct segments of the texts added so far, and add them
+	// to the graph. The characters of the segments are the vertices of a DAG in which each segment is
+	// either a chain or a set of parallel branches, one for each distinct string. Aligning a text of
+	// length m takes O(Vm) time and space, where V is the number of the vertices, and only the segments
+	// that the alignment touches are split when the text is added.
+	template <typename t_score, typename t_character>
+	class partial_order_aligner final : public alignment_graph_builder_base
+	{
+	public:
+		typedef t_score															score_type;
+		typedef t_character														character_type;
+		typedef std::vector <character_type>									text_type;
+		typedef alignment_graph::common_node <character_type>					common_node_type;
+		typedef alignment_graph::distinct_node <character_type>					pairwise_distinct_node_type;
+		typedef alignment_graph::multiple_distinct_node <character_type>		distinct_node_type;
+		
+		static constexpr score_type const SCORE_MIN{std::numeric_limits <score_type>::lowest() / 2};
+		static constexpr std::size_t const SOURCE{0};
+	
+	protected:
+		enum class operation_type : std::uint8_t
+		{
+			MATCH,		// The vertex is aligned to a character of the text.
+			DELETION,	// The vertex is aligned to a gap.
+			INSERTION	// The character of the text is aligned to a gap after the vertex.
+		};
+		
+		struct operation
+		{
+			std::size_t		vertex{};
+			std::size_t		text_idx{};
+			operation_type	type{};
+		};
+		
+		struct vertex
+		{
+			character_type	character{};
+			std::size_t		segment_idx{};
+			std::size_t		predecessors_begin{};
+			std::size_t		predecessors_end{};
+		};
+		
+		enum class state : std::uint8_t
+		{
+			H,
+			D,
+			I
+		};
+	
+	protected:
+		// Typed pointers to m_current_segment, at most one of which is non-null.
+		common_node_type														*m_current_common{};
+		distinct_node_type														*m_current_distinct{};
+		
+		detail::aligner_parameters <score_type>									m_parameters;
+		std::vector <vertex>													m_vertices;				// The first one is the source.
+		std::vector <std::size_t>												m_predecessors;
+		std::vector <std::size_t>												m_sink_predecessors;
+		std::vector <score_type>												m_h;					// Best score, by vertex and text position.
+		std::vector <score_type>												m_d;					// The vertex is aligned to a gap.
+		std::vector <score_type>												m_i;					// The character is aligned to a gap.
+		std::vector <operation>													m_operations;
+		std::size_t																m_text_count{};
+	
+	public:
+		score_type identity_score() const { return m_parameters.identity_score; }
+		score_type mismatch_penalty() const { return m_parameters.mismatch_penalty; }
+		score_type gap_start_penalty() const { return m_parameters.gap_start_penalty; }
+		score_type gap_penalty() const { return m_parameters.gap_penalty; }
+		std::size_t text_count() const { return m_text_count; }
+		
+		void set_identity_score(score_type const score) { m_parameters.identity_score = score; }
+		void set_mismatch_penalty(score_type const score) { m_parameters.mismatch_penalty = score; }
+		void set_gap_start_penalty(score_type const score) { m_parameters.gap_start_penalty = score; }
+		void set_gap_penalty(score_type const score) { m_parameters.gap_penalty = score; }
+		
+		// Copy the segments of a graph of the given number of texts, e.g. ones made by alignment_graph_builder.
+		void set_graph(node_ptr_vector const &segments, std::size_t const text_count);
+		
+		// Align the text to the graph, add it and return the alignment score.
+		template <typename t_text>
+		score_type add_text(t_text const &text);
+	
+	protected:
+		inline common_node_type &common_segment();
+		inline distinct_node_type &distinct_segment();
+		inline void end_segment();
+		
+		std::size_t add_vertex(character_type const c, std::size_t const segment_idx, std::vector <std::size_t> const &predecessors);
+		void build_dag();
+		void fill_matrices(text_type const &text);
+		score_type traceback(text_type const &text);
+		void update_graph(text_type const &text);
+		
+		std::size_t cell(std::size_t const vertex_idx, std::size_t const text_idx, std::size_t const text_length) const { return vertex_idx * (1 + text_length) + text_idx; }
+		score_type similarity(character_type const lhs, character_type const rhs) const { return libbio::is_equal(lhs, rhs) ? m_parameters.identity_score : m_parameters.mismatch_penalty; }
+	};
+	
+	
+	template <typename t_score, typename t_character>
+	void partial_order_aligner <t_score, t_character>::set_graph(node_ptr_vector const &segments, std::size_t const text_count)
+	{
+		m_text_segments.clear();
+		end_segment();
+		m_text_count = text_count;
+		
+		for (auto const &seg : segments)
+		{
+			switch (seg->type())
+			{
+				case alignment_graph::node_type::COMMON:
+				{
+					auto const &src(static_cast <common_node_type const &>(*seg));
+					auto &dst(common_segment());
+					dst.add_characters(src.characters().begin(), src.characters().end());
+					break;
+				}
+				
+				case alignment_graph::node_type::DISTINCT:
+				{
+					libbio_always_assert(2 == text_count);
+					auto const &src(static_cast <pairwise_distinct_node_type const &>(*seg));
+					auto &dst(distinct_segment());
+					dst.add_characters(0, src.characters_lhs().begin(), src.characters_lhs().end());
+					dst.add_characters(1, src.characters_rhs().begin(), src.characters_rhs().end());
+					break;
+				}
+				
+				case alignment_graph::node_type::MULTIPLE_DISTINCT:
+				{
+					auto const &src(static_cast <distinct_node_type const &>(*seg));
+					libbio_always_assert(src.texts().size() == text_count);
+					auto &dst(distinct_segment());
+					for (std::size_t i(0); i < text_count; ++i)
+						dst.add_characters(i, src.texts()[i].begin(), src.texts()[i].end());
+					break;
+				}
+				
+				default:
+					throw std::runtime_error("Unexpected node type");
+			}
+		}
+		
+		end_segment();
+	}
+	
+	
+	template <typename t_score, typename t_character>
+	template <typename t_text>
+	auto partial_order_aligner <t_score, t_character>::add_text(t_text const &text) -> score_type
+	{
+		// The end iterator may have a different type from that of begin.
+		text_type decoded;
+		auto it(text.begin());
+		auto const end(text.end());
+		for (; it != end; ++it)
+			decoded.emplace_back(*it);
+		
+		// The first text forms the graph.
+		if (0 == m_text_count)
+		{
+			if (!decoded.empty())
+				common_segment().add_characters(decoded.begin(), decoded.end());
+			end_segment();
+			m_text_count = 1;
+			return 0;
+		}
+		
+		build_dag();
+		fill_matrices(decoded);
+		auto const retval(traceback(decoded));
+		update_graph(decoded);
+		
+		// Release the matrices.
+		m_vertices.clear();
+		m_predecessors.clear();
+		m_sink_predecessors.clear();
+		m_h = std::vector <score_type>();
+		m_d = std::vector <score_type>();
+		m_i = std::vector <score_type>();
+		m_operations.clear();
+		return retval;
+	}
+	
+	
+	template <typename t_score, typename t_character>
+	auto partial_order_aligner <t_score, t_character>::common_segment() -> common_node_type &
+	{
+		if (!m_current_common)
+		{
+			end_segment();
+			m_current_common = new common_node_type();
+			m_current_segment.reset(m_current_common);
+		}
+		return *m_current_common;
+	}
+	
+	
+	template <typename t_score, typename t_character>
+	auto partial_order_aligner <t_score, t_character>::distinct_segment() -> distinct_node_type &
+	{
+		if (!m_current_distinct)
+		{
+			end_segment();
+			m_current_distinct = new distinct_node_type(m_text_count);
+			m_current_segment.reset(m_current_distinct);
+		}
+		return *m_current_distinct;
+	}
+	
+	
+	template <typename t_score, typename t_character>
+	void partial_order_aligner <t_score, t_character>::end_segment()
+	{
+		end_current_segment();
+		m_current_common = nullptr;
+		m_current_distinct = nullptr;
+	}
+	
+	
+	template <typename t_score, typename t_character>
+	std::size_t partial_order_aligner <t_score, t_character>::add_vertex(
+		character_type const c,
+		std::size_t const segment_idx,
+		std::vector <std::size_t> const &predecessors
+	)
+	{
+		auto const retval(m_vertices.size());
+		auto &vv(m_vertices.emplace_back());
+		vv.character = c;
+		vv.segment_idx = segment_idx;
+		vv.predecessors_begin = m_predecessors.size();
+		m_predecessors.insert(m_predecessors.end(), predecessors.begin(), predecessors.end());
+		vv.predecessors_end = m_predecessors.size();
+		return retval;
+	}
+	
+	
+	// Number the vertices in topological order. Equal branches of a distinct segment are represented once.
+	template <typename t_score, typename t_character>
+	void partial_order_aligner <t_score, t_character>::build_dag()
+	{
+		m_vertices.clear();
+		m_predecessors.clear();
+		m_vertices.emplace_back().segment_idx = SIZE_MAX; // Source.
+		
+		std::vector <std::size_t> exits{SOURCE};	// Vertices from which the next segment may be entered.
+		std::vector <std::size_t> next_exits;
+		std::vector <std::size_t> predecessors;
+		std::vector <text_type const *> branches;
+		for (std::size_t i(0), count(m_text_segments.size()); i < count; ++i)
+		{
+			auto const &seg(*m_text_segments[i]);
+			if (alignment_graph::node_type::COMMON == seg.type())
+			{
+				predecessors = exits;
+				for (auto const c : static_cast <common_node_type const &>(seg).characters())
+				{
+					auto const vertex_idx(add_vertex(c, i, predecessors));
+					predecessors.assign(1, vertex_idx);
+				}
+				exits = predecessors;
+			}
+			else
+			{
+				libbio_assert(alignment_graph::node_type::MULTIPLE_DISTINCT == seg.type());
+				auto const &texts(static_cast <distinct_node_type const &>(seg).texts());
+				
+				branches.clear();
+				for (auto const &text : texts)
+				{
+					if (branches.end() == std::find_if(branches.begin(), branches.end(), [&text](auto const *branch){ return *branch == text; }))
+						branches.push_back(&text);
+				}
+				
+				next_exits.clear();
+				for (auto const *branch : branches)
+				{
+					// An empty branch lets the segment be skipped.
+					if (branch->empty())
+					{
+						next_exits.insert(next_exits.end(), exits.begin(), exits.end());
+						continue;
+					}
+					
+					predecessors = exits;
+					for (auto const c : *branch)
+					{
+						auto const vertex_idx(add_vertex(c, i, predecessors));
+						predecessors.assign(1, vertex_idx);
+					}
+					next_exits.push_back(predecessors.front());
+				}
+				
+				std::sort(next_exits.begin(), next_exits.end());
+				next_exits.erase(std::unique(next_exits.begin(), next_exits.end()), next_exits.end());
+				exits.swap(next_exits);
+			}
+		}
+		
+		m_sink_predecessors = exits;
+	}
+	
+	
+	template <typename t_score, typename t_character>
+	void partial_order_aligner <t_score, t_character>::fill_matrices(text_type const &text)
+	{
+		auto const text_length(text.size());
+		auto const size(m_vertices.size() * (1 + text_length));
+		m_h.assign(size, SCORE_MIN);
+		m_d.assign(size, SCORE_MIN);
+		m_i.assign(size, SCORE_MIN);
+		
+		auto const gs(m_parameters.gap_start_penalty);
+		auto const g(m_parameters.gap_penalty);
+		
+		// Align the prefixes of the text to the source.
+		m_h[cell(SOURCE, 0, text_length)] = 0;
+		for (std::size_t j(1); j <= text_length; ++j)
+		{
+			auto const score(gs + score_type(j) * g);
+			m_i[cell(SOURCE, j, text_length)] = score;
+			m_h[cell(SOURCE, j, text_length)] = score;
+		}
+		
+		for (std::size_t v(1), count(m_vertices.size()); v < count; ++v)
+		{
+			auto const &vv(m_vertices[v]);
+			for (std::size_t j(0); j <= text_length; ++j)
+			{
+				score_type match(SCORE_MIN);
+				score_type deletion(SCORE_MIN);
+				for (std::size_t k(vv.predecessors_begin); k < vv.predecessors_end; ++k)
+				{
+					auto const p(m_predecessors[k]);
+					if (j)
+						match = std::max(match, score_type(m_h[cell(p, j - 1, text_length)] + similarity(vv.character, text[j - 1])));
+					deletion = std::max({deletion, score_type(m_h[cell(p, j, text_length)] + gs + g), score_type(m_d[cell(p, j, text_length)] + g)});
+				}
+				
+				score_type insertion(SCORE_MIN);
+				if (j)
+					insertion = std::max(score_type(m_h[cell(v, j - 1, text_length)] + gs + g), score_type(m_i[cell(v, j - 1, text_length)] + g));
+				
+				m_d[cell(v, j, text_length)] = deletion;
+				m_i[cell(v, j, text_length)] = insertion;
+				m_h[cell(v, j, text_length)] = std::max({match, deletion, insertion});
+			}
+		}
+	}
+	
+	
+	// Find the operations of an optimal alignment by checking which of the candidates produced each score.
+	template <typename t_score, typename t_character>
+	auto partial_order_aligner <t_score, t_character>::traceback(text_type const &text) -> score_type
+	{
+		auto const text_length(text.size());
+		auto const gs(m_parameters.gap_start_penalty);
+		auto const g(m_parameters.gap_penalty);
+		
+		std::size_t v(m_sink_predecessors.front());
+		for (auto const p : m_sink_predecessors)
+		{
+			if (m_h[cell(v, text_length, text_length)] < m_h[cell(p, text_length, text_length)])
+				v = p;
+		}
+		auto const retval(m_h[cell(v, text_length, text_length)]);
+		
+		m_operations.clear();
+		std::size_t j(text_length);
+		state current_state(state::H);
+		while (SOURCE != v || j)
+		{
+			auto const &vv(m_vertices[v]);
+			switch (current_state)
+			{
+				case state::H:
+				{
+					auto const score(m_h[cell(v, j, text_length)]);
+					if (SOURCE == v)
+					{
+						current_state = state::I;
+						break;
+					}
+					
+					if (j)
+					{
+						auto const expected(score - similarity(vv.character, text[j - 1]));
+						auto const begin(m_predecessors.begin() + vv.predecessors_begin);
+						auto const end(m_predecessors.begin() + vv.predecessors_end);
+						auto const it(std::find_if(begin, end, [this, j, text_length, expected](auto const p){
+							return m_h[cell(p, j - 1, text_length)] == expected;
+						}));
+						if (end != it)
+						{
+							m_operations.push_back(operation{v, j - 1, operation_type::MATCH});
+							v = *it;
+							--j;
+							break;
+						}
+					}
+					
+					current_state = (score == m_d[cell(v, j, text_length)] ? state::D : state::I);
+					break;
+				}
+				
+				case state::D:
+				{
+					auto const score(m_d[cell(v, j, text_length)]);
+					m_operations.push_back(operation{v, j, operation_type::DELETION});
+					bool did_find(false);
+					for (std::size_t k(vv.predecessors_begin); k < vv.predecessors_end; ++k)
+					{
+						auto const p(m_predecessors[k]);
+						if (m_h[cell(p, j, text_length)] + gs + g == score)
+						{
+							v = p;
+							current_state = state::H;
+							did_find = true;
+							break;
+						}
+						
+						if (SOURCE != p && m_d[cell(p, j, text_length)] + g == score)
+						{
+							v = p;
+							did_find = true;
+							break;
+						}
+					}
+					libbio_always_assert(did_find);
+					break;
+				}
+				
+				case state::I:
+				{
+					libbio_assert(j);
+					auto const score(m_i[cell(v, j, text_length)]);
+					m_operations.push_back(operation{v, j - 1, operation_type::INSERTION});
+					current_state = (m_h[cell(v, j - 1, text_length)] + gs + g == score ? state::H : state::I);
+					--j;
+					break;
+				}
+			}
+		}
+		
+		std::reverse(m_operations.begin(), m_operations.end());
+		return retval;
+	}
+	
+	
+	// Split the common segments where the text differs and add a branch to the distinct segments.
+	template <typename t_score, typename t_character>
+	void partial_order_aligner <t_score, t_character>::update_graph(text_type const &text)
+	{
+		node_ptr_vector segments;
+		segments.swap(m_text_segments);
+		end_segment();
+		
+		auto const old_text_count(m_text_count);
+		++m_text_count;
+		
+		// Insertions before the first segment.
+		auto op_it(m_operations.cbegin());
+		auto const op_end(m_operations.cend());
+		for (; op_it != op_end && SOURCE == op_it->vertex; ++op_it)
+			distinct_segment().add_character(old_text_count, text[op_it->text_idx]);
+		
+		for (std::size_t i(0), count(segments.size()); i < count; ++i)
+		{
+			auto const &seg(*segments[i]);
+			if (alignment_graph::node_type::COMMON == seg.type())
+			{
+				// The alignment passes through each vertex of a common segment.
+				for (; op_it != op_end && m_vertices[op_it->vertex].segment_idx == i; ++op_it)
+				{
+					auto const c(m_vertices[op_it->vertex].character);
+					switch (op_it->type)
+					{
+						case operation_type::MATCH:
+						{
+							auto const text_c(text[op_it->text_idx]);
+							if (libbio::is_equal(c, text_c))
+								common_segment().add_character(c);
+							else
+							{
+								auto &node(distinct_segment());
+								for (std::size_t j(0); j < old_text_count; ++j)
+									node.add_character(j, c);
+								node.add_character(old_text_count, text_c);
+							}
+							break;
+						}
+						
+						case operation_type::DELETION:
+						{
+							auto &node(distinct_segment());
+							for (std::size_t j(0); j < old_text_count; ++j)
+								node.add_character(j, c);
+							break;
+						}
+						
+						case operation_type::INSERTION:
+							distinct_segment().add_character(old_text_count, text[op_it->text_idx]);
+							break;
+					}
+				}
+			}
+			else
+			{
+				auto const &texts(static_cast <distinct_node_type const &>(seg).texts());
+				auto &node(distinct_segment());
+				for (std::size_t j(0); j < old_text_count; ++j)
+					node.add_characters(j, texts[j].begin(), texts[j].end());
+				
+				// The characters of the new text that have been aligned to one of the branches or inserted after it.
+				for (; op_it != op_end && m_vertices[op_it->vertex].segment_idx == i; ++op_it)
+				{
+					if (operation_type::DELETION != op_it->type)
+						node.add_character(old_text_count, text[op_it->text_idx]);
+				}
+			}
+		}
+		
+		libbio_assert(op_end == op_it);
+		end_segment();
+	}
+}}
+
+#endif
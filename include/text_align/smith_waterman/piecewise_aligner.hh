@@ -0,0 +1,614 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_SMITH_WATERMAN_PIECEWISE_ALIGNER_HH
+#define TEXT_ALIGN_SMITH_WATERMAN_PIECEWISE_ALIGNER_HH
+
+#include <algorithm>
+#include <libbio/int_vector.hh>
+#include <memory>
+#include <mutex>
+#include <text_align/anchors.hh>
+#include <text_align/gap_runs.hh>
+#include <text_align/smith_waterman/alignment_context.hh>
+#include <text_align/tokenizer.hh>
+#include <thread>
+#include <vector>
+
+
+namespace text_align { namespace smith_waterman {
+	
+	// A part of both texts. Common pieces consist of matching characters and are not aligned.
+	struct alignment_piece
+	{
+		std::size_t	lhs_offset{};
+		std::size_t	lhs_length{};
+		std::size_t	rhs_offset{};
+		std::size_t	rhs_length{};
+		bool		is_common{};
+		
+		alignment_piece() = default;
+		
+		alignment_piece(
+			std::size_t const lhs_offset_,
+			std::size_t const lhs_length_,
+			std::size_t const rhs_offset_,
+			std::size_t const rhs_length_,
+			bool const is_common_
+		):
+			lhs_offset(lhs_offset_),
+			lhs_length(lhs_length_),
+			rhs_offset(rhs_offset_),
+			rhs_length(rhs_length_),
+			is_common(is_common_)
+		{
+		}
+	};
+	
+	typedef std::vector <alignment_piece> alignment_piece_vector;
+	
+	
+	// Make common pieces of the chained anchors and pieces to be aligned of the parts between them.
+	inline void make_pieces(
+		anchor_vector const &anchors,
+		std::size_t const lhs_len,
+		std::size_t const rhs_len,
+		alignment_piece_vector &dst
+	)
+	{
+		dst.clear();
+		std::size_t lhs_pos(0);
+		std::size_t rhs_pos(0);
+		for (auto const &anchor : anchors)
+		{
+			libbio_assert(lhs_pos <= anchor.lhs_pos);
+			libbio_assert(rhs_pos <= anchor.rhs_pos);
+			if (lhs_pos < anchor.lhs_pos || rhs_pos < anchor.rhs_pos)
+				dst.emplace_back(lhs_pos, anchor.lhs_pos - lhs_pos, rhs_pos, anchor.rhs_pos - rhs_pos, false);
+			dst.emplace_back(anchor.lhs_pos, anchor.length, anchor.rhs_pos, anchor.length, true);
+			lhs_pos = anchor.lhs_end();
+			rhs_pos = anchor.rhs_end();
+		}
+		
+		if (lhs_pos < lhs_len || rhs_pos < rhs_len)
+			dst.emplace_back(lhs_pos, lhs_len - lhs_pos, rhs_pos, rhs_len - rhs_pos, false);
+	}
+	
+	
+	// Make common pieces of the aligned pairs of equal tokens and pieces to be aligned of the parts
+	// between them. The token offsets include the end of the text.
+	inline void make_token_pieces(
+		std::vector <token_id_type> const &lhs_tokens,
+		std::vector <token_id_type> const &rhs_tokens,
+		std::vector <std::size_t> const &lhs_offsets,
+		std::vector <std::size_t> const &rhs_offsets,
+		libbio::bit_vector const &lhs_gaps,
+		libbio::bit_vector const &rhs_gaps,
+		alignment_piece_vector &dst
+	)
+	{
+		libbio_assert(lhs_tokens.size() + 1 == lhs_offsets.size());
+		libbio_assert(rhs_tokens.size() + 1 == rhs_offsets.size());
+		
+		dst.clear();
+		std::size_t lhs_token(0);
+		std::size_t rhs_token(0);
+		std::size_t lhs_start(0);	// Start of the current piece in characters.
+		std::size_t rhs_start(0);
+		
+		auto const add_common([&](){
+			auto const lhs_pos(lhs_offsets[lhs_token]);
+			auto const rhs_pos(rhs_offsets[rhs_token]);
+			auto const length(lhs_offsets[1 + lhs_token] - lhs_pos);
+			libbio_assert(length == rhs_offsets[1 + rhs_token] - rhs_pos);
+			
+			if (lhs_start < lhs_pos || rhs_start < rhs_pos)
+				dst.emplace_back(lhs_start, lhs_pos - lhs_start, rhs_start, rhs_pos - rhs_start, false);
+			else if (!dst.empty() && dst.back().is_common)
+			{
+				// Merge with the previous token.
+				dst.back().lhs_length += length;
+				dst.back().rhs_length += length;
+				lhs_start = lhs_pos + length;
+				rhs_start = rhs_pos + length;
+				return;
+			}
+			
+			dst.emplace_back(lhs_pos, length, rhs_pos, length, true);
+			lhs_start = lhs_pos + length;
+			rhs_start = rhs_pos + length;
+		});
+		
+		for_each_gap_run(lhs_gaps, rhs_gaps, [&](gap_run_type const run_type, std::size_t const length){
+			switch (run_type)
+			{
+				case gap_run_type::NONE:
+					for (std::size_t i(0); i < length; ++i)
+					{
+						if (lhs_tokens[lhs_token] == rhs_tokens[rhs_token])
+							add_common();
+						++lhs_token;
+						++rhs_token;
+					}
+					break;
+				
+				case gap_run_type::LHS:
+					rhs_token += length;
+					break;
+				
+				case gap_run_type::RHS:
+					lhs_token += length;
+					break;
+			}
+		});
+		
+		libbio_assert(lhs_token == lhs_tokens.size());
+		libbio_assert(rhs_token == rhs_tokens.size());
+		auto const lhs_len(lhs_offsets.back());
+		auto const rhs_len(rhs_offsets.back());
+		if (lhs_start < lhs_len || rhs_start < rhs_len)
+			dst.emplace_back(lhs_start, lhs_len - lhs_start, rhs_start, rhs_len - rhs_start, false);
+	}
+	
+	
+	// Align the pieces of two texts independently of each other and concatenate the results.
+	// Pieces that need the dynamic programming matrix are aligned concurrently with a pool of
+	// aligners that use the given execution context. The delegate receives the gaps in the order
+	// of the texts (or in reverse if the texts are reversed) through push_lhs and push_rhs, and
+	// then finish(aligner_base &) is called.
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	class piecewise_aligner final : public aligner_base
+	{
+	public:
+		typedef t_score														score_type;
+		typedef t_character													character_type;
+		typedef t_delegate													delegate_type;
+		typedef std::vector <t_character>									text_type;
+		typedef boost::asio::io_context										context_type;
+		typedef std::chrono::steady_clock									clock_type;
+		typedef async_alignment_context <t_score, t_word, libbio::bit_vector>	piece_context_type;
+		typedef typename piece_context_type::result_type					piece_result_type;
+		typedef detail::text_span <t_character>								span_type;
+		typedef detail::text_span <token_id_type>							token_span_type;
+	
+	protected:
+		context_type										*m_ctx{nullptr};
+		t_delegate											*m_delegate{nullptr};
+		std::vector <std::unique_ptr <piece_context_type>>	m_piece_contexts;
+		text_type											m_lhs;
+		text_type											m_rhs;
+		alignment_piece_vector								m_pieces;
+		std::vector <std::size_t>							m_aligned_pieces;	// Indices of the pieces that need the aligner.
+		std::vector <std::pair <span_type, span_type>>		m_piece_texts;
+		std::vector <piece_result_type>						m_results;
+		std::vector <token_id_type>							m_lhs_tokens;
+		std::vector <token_id_type>							m_rhs_tokens;
+		std::vector <std::size_t>							m_lhs_token_offsets;
+		std::vector <std::size_t>							m_rhs_token_offsets;
+		std::pair <token_span_type, token_span_type>		m_token_texts;		// Referred to by the aligner until the token alignment finishes.
+		cancellation_token									m_cancellation_token;
+		clock_type::time_point								m_deadline{clock_type::time_point::max()};
+		std::mutex											m_mutex;
+		detail::aligner_parameters <score_type>				m_parameters;
+		std::size_t											m_max_concurrent_alignments{};	// Zero for hardware concurrency.
+		std::size_t											m_next_piece{};
+		std::size_t											m_running_alignments{};
+		score_type											m_alignment_score{};
+		status_type											m_status{status_type::STATUS_NONE};
+		bool												m_reverses_texts{};
+		bool												m_refines_tokens{true};
+		bool												m_replaces_distinct_pieces{};	// Set by align_words if !m_refines_tokens.
+		bool												m_is_stopping{};
+	
+	public:
+		piecewise_aligner(context_type &ctx, t_delegate &delegate):
+			m_ctx(&ctx),
+			m_delegate(&delegate)
+		{
+		}
+		
+		piecewise_aligner(piecewise_aligner const &) = delete;
+		piecewise_aligner &operator=(piecewise_aligner const &) = delete;
+		
+		delegate_type &delegate() const { return *m_delegate; }
+		
+		score_type identity_score() const { return m_parameters.identity_score; }
+		score_type mismatch_penalty() const { return m_parameters.mismatch_penalty; }
+		score_type gap_start_penalty() const { return m_parameters.gap_start_penalty; }
+		score_type gap_penalty() const { return m_parameters.gap_penalty; }
+		std::uint32_t segment_length() const { return m_parameters.segment_length; }
+		std::size_t max_concurrent_alignments() const { return m_max_concurrent_alignments; }
+		bool reverses_texts() const { return m_reverses_texts; }
+		bool refines_tokens() const { return m_refines_tokens; }
+		status_type status() const override { return m_status; }
+		score_type alignment_score() const { return m_alignment_score; }
+		
+		text_type const &lhs_text() const { return m_lhs; }
+		text_type const &rhs_text() const { return m_rhs; }
+		alignment_piece_vector const &pieces() const { return m_pieces; }
+		
+		void set_identity_score(score_type const score) { m_parameters.identity_score = score; }
+		void set_mismatch_penalty(score_type const score) { m_parameters.mismatch_penalty = score; }
+		void set_gap_start_penalty(score_type const score) { m_parameters.gap_start_penalty = score; }
+		void set_gap_penalty(score_type const score) { m_parameters.gap_penalty = score; }
+		void set_segment_length(std::uint32_t const length) override { m_parameters.segment_length = length; }
+		void set_prints_debugging_information(bool const should_print) override { m_parameters.print_debugging_information = should_print; }
+		void set_max_concurrent_alignments(std::size_t const count) { m_max_concurrent_alignments = count; }
+		void set_reverses_texts(bool const flag) { m_reverses_texts = flag; }
+		void set_refines_tokens(bool const flag) { m_refines_tokens = flag; }	// If false, align_words replaces the distinct pieces without aligning.
+		void set_cancellation_token(cancellation_token const &token) { m_cancellation_token = token; }
+		void set_deadline(clock_type::time_point const deadline) { m_deadline = deadline; }
+		void clear_deadline() { m_deadline = clock_type::time_point::max(); }
+		
+		// Decode the texts to buffers; the pieces are specified in terms of them.
+		template <typename t_lhs, typename t_rhs>
+		void set_texts(t_lhs const &lhs, t_rhs const &rhs);
+		
+		// Align the given pieces of the texts set with set_texts. The pieces need to cover both texts in order.
+		void align_pieces(alignment_piece_vector &&pieces) { m_replaces_distinct_pieces = false; do_align_pieces(std::move(pieces)); }
+		
+		// Align the parts of the texts between the collinear chain of unique exact matches.
+		template <typename t_lhs, typename t_rhs>
+		void align_anchored(t_lhs const &lhs, t_rhs const &rhs, anchor_parameters const &parameters);
+		
+		// Align the lines of the texts first and then the characters of the lines that do not match.
+		template <typename t_lhs, typename t_rhs>
+		void align_lines(t_lhs const &lhs, t_rhs const &rhs) { m_replaces_distinct_pieces = false; align_tokens(lhs, rhs, &tokenize_lines <t_character>); }
+		
+		// Align the words, whitespace and punctuation of the texts first and then the characters
+		// of the tokens that do not match, unless refines_tokens() is false.
+		template <typename t_lhs, typename t_rhs>
+		void align_words(t_lhs const &lhs, t_rhs const &rhs) { m_replaces_distinct_pieces = !m_refines_tokens; align_tokens(lhs, rhs, &tokenize_words <t_character>); }
+	
+	protected:
+		template <typename t_lhs, typename t_rhs, typename t_tokenize_fn>
+		void align_tokens(t_lhs const &lhs, t_rhs const &rhs, t_tokenize_fn &&tokenize_fn);
+		
+		void do_align_pieces(alignment_piece_vector &&pieces);
+		inline bool should_stop() const;
+		void configure_aligner(typename piece_context_type::aligner_type &aligner) const;
+		void token_alignment_did_finish(piece_result_type &&result);
+		void start_piece(piece_context_type &ctx, std::size_t const idx);
+		void piece_did_finish(piece_context_type &ctx, std::size_t const idx, piece_result_type &&result);
+		void push_gaps(libbio::bit_vector const &lhs_gaps, libbio::bit_vector const &rhs_gaps);
+		void finish();
+	};
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	template <typename t_lhs, typename t_rhs>
+	void piecewise_aligner <t_score, t_word, t_character, t_delegate>::set_texts(t_lhs const &lhs, t_rhs const &rhs)
+	{
+		// The end iterator may have a different type from that of begin.
+		auto const copy_text([](auto const &src, text_type &dst){
+			dst.clear();
+			auto it(src.begin());
+			auto const end(src.end());
+			for (; it != end; ++it)
+				dst.emplace_back(*it);
+		});
+		
+		copy_text(lhs, m_lhs);
+		copy_text(rhs, m_rhs);
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	template <typename t_lhs, typename t_rhs>
+	void piecewise_aligner <t_score, t_word, t_character, t_delegate>::align_anchored(
+		t_lhs const &lhs,
+		t_rhs const &rhs,
+		anchor_parameters const &parameters
+	)
+	{
+		m_replaces_distinct_pieces = false;
+		set_texts(lhs, rhs);
+		
+		anchor_vector anchors;
+		find_unique_anchors(m_lhs, m_rhs, parameters, anchors);
+		chain_anchors(anchors);
+		
+		alignment_piece_vector pieces;
+		make_pieces(anchors, m_lhs.size(), m_rhs.size(), pieces);
+		do_align_pieces(std::move(pieces));
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	template <typename t_lhs, typename t_rhs, typename t_tokenize_fn>
+	void piecewise_aligner <t_score, t_word, t_character, t_delegate>::align_tokens(
+		t_lhs const &lhs,
+		t_rhs const &rhs,
+		t_tokenize_fn &&tokenize_fn
+	)
+	{
+		libbio_assert(0 == m_running_alignments);
+		set_texts(lhs, rhs);
+		
+		{
+			token_interner <t_character> interner;
+			tokenize_fn(m_lhs, interner, m_lhs_tokens, m_lhs_token_offsets);
+			tokenize_fn(m_rhs, interner, m_rhs_tokens, m_rhs_token_offsets);
+		}
+		
+		if (m_lhs_tokens.empty() || m_rhs_tokens.empty())
+		{
+			alignment_piece_vector pieces;
+			make_pieces(anchor_vector(), m_lhs.size(), m_rhs.size(), pieces);
+			do_align_pieces(std::move(pieces));
+			return;
+		}
+		
+		// Align the token identifiers with the first aligner of the pool.
+		if (m_piece_contexts.empty())
+			m_piece_contexts.emplace_back(std::make_unique <piece_context_type>(*m_ctx));
+		
+		auto &ctx(*m_piece_contexts.front());
+		auto &aligner(ctx.get_aligner());
+		configure_aligner(aligner);
+		aligner.set_reverses_texts(false);
+		
+		m_token_texts.first = token_span_type{m_lhs_tokens.data(), m_lhs_tokens.data() + m_lhs_tokens.size()};
+		m_token_texts.second = token_span_type{m_rhs_tokens.data(), m_rhs_tokens.data() + m_rhs_tokens.size()};
+		ctx.align_async(
+			m_token_texts.first,
+			m_token_texts.second,
+			m_token_texts.first.size(),
+			m_token_texts.second.size(),
+			[this](piece_result_type &&result){
+				token_alignment_did_finish(std::move(result));
+			}
+		);
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void piecewise_aligner <t_score, t_word, t_character, t_delegate>::token_alignment_did_finish(piece_result_type &&result)
+	{
+		if (status_type::STATUS_FINISHED != result.status || should_stop())
+		{
+			m_delegate->clear_gaps();
+			m_is_stopping = true;
+			finish();
+			return;
+		}
+		
+		alignment_piece_vector pieces;
+		make_token_pieces(m_lhs_tokens, m_rhs_tokens, m_lhs_token_offsets, m_rhs_token_offsets, result.lhs_gaps, result.rhs_gaps, pieces);
+		do_align_pieces(std::move(pieces));
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	bool piecewise_aligner <t_score, t_word, t_character, t_delegate>::should_stop() const
+	{
+		if (m_cancellation_token.is_cancelled())
+			return true;
+		
+		if (clock_type::time_point::max() != m_deadline && m_deadline <= clock_type::now())
+			return true;
+		
+		return false;
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void piecewise_aligner <t_score, t_word, t_character, t_delegate>::do_align_pieces(alignment_piece_vector &&pieces)
+	{
+		// Only one alignment may be in progress at a time.
+		libbio_assert(0 == m_running_alignments);
+		
+		m_delegate->clear_gaps();
+		m_status = status_type::STATUS_NONE;
+		m_is_stopping = false;
+		m_pieces = std::move(pieces);
+		m_aligned_pieces.clear();
+		m_piece_texts.clear();
+		
+		// Determine the pieces that need to be aligned with the dynamic programming matrix.
+		for (std::size_t idx(0), count(m_pieces.size()); idx < count; ++idx)
+		{
+			auto const &piece(m_pieces[idx]);
+			libbio_assert(piece.lhs_offset + piece.lhs_length <= m_lhs.size());
+			libbio_assert(piece.rhs_offset + piece.rhs_length <= m_rhs.size());
+			if (piece.is_common || 0 == piece.lhs_length || 0 == piece.rhs_length || m_replaces_distinct_pieces)
+				continue;
+			
+			auto const *lhs_begin(m_lhs.data() + piece.lhs_offset);
+			auto const *rhs_begin(m_rhs.data() + piece.rhs_offset);
+			m_aligned_pieces.push_back(idx);
+			m_piece_texts.emplace_back(
+				span_type{lhs_begin, lhs_begin + piece.lhs_length},
+				span_type{rhs_begin, rhs_begin + piece.rhs_length}
+			);
+		}
+		
+		auto const aligned_count(m_aligned_pieces.size());
+		m_results.clear();
+		m_results.resize(aligned_count);
+		m_next_piece = 0;
+		
+		if (0 == aligned_count)
+		{
+			// Finish from the execution context as in the general case.
+			boost::asio::post(*m_ctx, [this](){ finish(); });
+			return;
+		}
+		
+		// Instantiate the aligners.
+		std::size_t const max_concurrent(
+			m_max_concurrent_alignments
+			? m_max_concurrent_alignments
+			: std::max(1U, std::thread::hardware_concurrency())
+		);
+		auto const context_count(std::min(max_concurrent, aligned_count));
+		while (m_piece_contexts.size() < context_count)
+			m_piece_contexts.emplace_back(std::make_unique <piece_context_type>(*m_ctx));
+		
+		{
+			std::lock_guard <std::mutex> lock(m_mutex);
+			m_running_alignments = context_count;
+			m_next_piece = context_count;
+		}
+		
+		for (std::size_t i(0); i < context_count; ++i)
+			start_piece(*m_piece_contexts[i], i);
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void piecewise_aligner <t_score, t_word, t_character, t_delegate>::configure_aligner(
+		typename piece_context_type::aligner_type &aligner
+	) const
+	{
+		aligner.set_identity_score(m_parameters.identity_score);
+		aligner.set_mismatch_penalty(m_parameters.mismatch_penalty);
+		aligner.set_gap_start_penalty(m_parameters.gap_start_penalty);
+		aligner.set_gap_penalty(m_parameters.gap_penalty);
+		aligner.set_segment_length(m_parameters.segment_length); // Zero for determining from the text.
+		aligner.set_prints_debugging_information(m_parameters.print_debugging_information);
+		aligner.set_reverses_texts(m_reverses_texts);
+		aligner.set_cancellation_token(m_cancellation_token);
+		aligner.set_deadline(m_deadline);
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void piecewise_aligner <t_score, t_word, t_character, t_delegate>::start_piece(piece_context_type &ctx, std::size_t const idx)
+	{
+		configure_aligner(ctx.get_aligner());
+		
+		auto const &texts(m_piece_texts[idx]);
+		ctx.align_async(
+			texts.first,
+			texts.second,
+			texts.first.size(),
+			texts.second.size(),
+			[this, &ctx, idx](piece_result_type &&result){
+				piece_did_finish(ctx, idx, std::move(result));
+			}
+		);
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void piecewise_aligner <t_score, t_word, t_character, t_delegate>::piece_did_finish(
+		piece_context_type &ctx,
+		std::size_t const idx,
+		piece_result_type &&result
+	)
+	{
+		std::size_t next_idx(SIZE_MAX);
+		bool is_last(false);
+		
+		{
+			std::lock_guard <std::mutex> lock(m_mutex);
+			if (status_type::STATUS_FINISHED != result.status || should_stop())
+				m_is_stopping = true;
+			
+			m_results[idx] = std::move(result);
+			if (!m_is_stopping && m_next_piece < m_aligned_pieces.size())
+				next_idx = m_next_piece++;
+			else
+				is_last = (0 == --m_running_alignments);
+		}
+		
+		// Reuse the aligner for the next piece.
+		if (SIZE_MAX != next_idx)
+			start_piece(ctx, next_idx);
+		else if (is_last)
+			finish();
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void piecewise_aligner <t_score, t_word, t_character, t_delegate>::push_gaps(
+		libbio::bit_vector const &lhs_gaps,
+		libbio::bit_vector const &rhs_gaps
+	)
+	{
+		for_each_bit_run(lhs_gaps, [this](bool const flag, std::size_t const length){
+			m_delegate->push_lhs(flag, length);
+		});
+		
+		for_each_bit_run(rhs_gaps, [this](bool const flag, std::size_t const length){
+			m_delegate->push_rhs(flag, length);
+		});
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void piecewise_aligner <t_score, t_word, t_character, t_delegate>::finish()
+	{
+		if (m_is_stopping)
+		{
+			m_alignment_score = 0;
+			m_status = status_type::STATUS_CANCELLED;
+			m_delegate->finish(*this);
+			return;
+		}
+		
+		// Concatenate the results. If the texts are reversed, so are the piece alignments.
+		score_type score(0);
+		auto const piece_count(m_pieces.size());
+		std::size_t aligned_idx(m_reverses_texts ? m_aligned_pieces.size() : 0);
+		for (std::size_t i(0); i < piece_count; ++i)
+		{
+			auto const piece_idx(m_reverses_texts ? piece_count - i - 1 : i);
+			auto const &piece(m_pieces[piece_idx]);
+			if (piece.is_common)
+			{
+				libbio_assert(piece.lhs_length == piece.rhs_length);
+				m_delegate->push_lhs(0, piece.lhs_length);
+				m_delegate->push_rhs(0, piece.rhs_length);
+				score += score_type(piece.lhs_length) * m_parameters.identity_score;
+			}
+			else if (0 == piece.lhs_length)
+			{
+				if (piece.rhs_length)
+				{
+					m_delegate->push_lhs(1, piece.rhs_length);
+					m_delegate->push_rhs(0, piece.rhs_length);
+					score += m_parameters.gap_start_penalty + score_type(piece.rhs_length) * m_parameters.gap_penalty;
+				}
+			}
+			else if (0 == piece.rhs_length)
+			{
+				m_delegate->push_lhs(0, piece.lhs_length);
+				m_delegate->push_rhs(1, piece.lhs_length);
+				score += m_parameters.gap_start_penalty + score_type(piece.lhs_length) * m_parameters.gap_penalty;
+			}
+			else if (m_replaces_distinct_pieces)
+			{
+				// Replace the part of lhs with that of rhs.
+				m_delegate->push_lhs(m_reverses_texts, m_reverses_texts ? piece.rhs_length : piece.lhs_length);
+				m_delegate->push_lhs(!m_reverses_texts, m_reverses_texts ? piece.lhs_length : piece.rhs_length);
+				m_delegate->push_rhs(!m_reverses_texts, m_reverses_texts ? piece.rhs_length : piece.lhs_length);
+				m_delegate->push_rhs(m_reverses_texts, m_reverses_texts ? piece.lhs_length : piece.rhs_length);
+				score += 2 * m_parameters.gap_start_penalty + score_type(piece.lhs_length + piece.rhs_length) * m_parameters.gap_penalty;
+			}
+			else
+			{
+				if (m_reverses_texts)
+					--aligned_idx;
+				
+				libbio_assert(m_aligned_pieces[aligned_idx] == piece_idx);
+				auto &result(m_results[aligned_idx]);
+				push_gaps(result.lhs_gaps, result.rhs_gaps);
+				score += result.score;
+				result = piece_result_type();
+				
+				if (!m_reverses_texts)
+					++aligned_idx;
+			}
+		}
+		
+		m_alignment_score = score;
+		m_status = status_type::STATUS_FINISHED;
+		m_delegate->finish(*this);
+	}
+}}
+
+#endif
@@ -0,0 +1,529 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_SMITH_WATERMAN_PROGRESSIVE_ALIGNER_HH
+#define TEXT_ALIGN_SMITH_WATERMAN_PROGRESSIVE_ALIGNER_HH
+
+#include <algorithm>
+#include <deque>
+#include <libbio/int_vector.hh>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <text_align/gap_runs.hh>
+#include <text_align/guide_tree.hh>
+#include <text_align/pair_score_file.hh>
+#include <text_align/smith_waterman/alignment_context.hh>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+namespace text_align { namespace smith_waterman {
+	
+	// Progressive multiple alignment of a collection of texts. A guide tree is built from the pairwise
+	// scores, e.g. ones calculated with all_pairs_aligner, and the consensus sequences of the subtrees
+	// are aligned up the tree with a pool of aligners that use the given execution context. Independent
+	// subtrees are aligned in parallel. The alignment is stored as a gap vector for each text, and the
+	// memory used by a subtree is released as soon as it has been merged to its parent. After the root
+	// has been aligned, the delegate’s finish(aligner_base &) is called.
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	class progressive_aligner final : public aligner_base
+	{
+	public:
+		typedef t_score															score_type;
+		typedef t_character														character_type;
+		typedef t_delegate														delegate_type;
+		typedef std::vector <t_character>										text_type;
+		typedef boost::asio::io_context											context_type;
+		typedef std::chrono::steady_clock										clock_type;
+		typedef async_alignment_context <t_score, t_word, libbio::bit_vector>	alignment_context_type;
+		typedef typename alignment_context_type::result_type					result_type;
+		typedef detail::text_span <t_character>									span_type;
+		typedef pair_score_file <t_score>										score_file_type;
+	
+	protected:
+		// Multiple alignment of the texts of a subtree.
+		struct profile
+		{
+			std::vector <std::size_t>			text_indices;
+			std::vector <libbio::bit_vector>	gaps;			// By column, for each text.
+			text_type							consensus;		// Empty for leaves.
+			std::size_t							column_count{};
+		};
+		
+		// Keep the spans passed to align_async alive until the completion handler has been called.
+		struct merge_context
+		{
+			alignment_context_type	context;
+			span_type				lhs;
+			span_type				rhs;
+			
+			explicit merge_context(context_type &ctx): context(ctx) {}
+		};
+	
+	protected:
+		context_type										*m_ctx{nullptr};
+		t_delegate											*m_delegate{nullptr};
+		std::vector <std::unique_ptr <merge_context>>		m_merge_contexts;
+		std::vector <text_type>								m_texts;
+		std::vector <libbio::bit_vector>					m_gaps;			// Result, for each text.
+		guide_tree											m_guide_tree;
+		std::vector <profile>								m_profiles;		// By guide tree node.
+		std::vector <std::size_t>							m_parents;
+		std::vector <std::uint8_t>							m_finished_children;
+		std::deque <std::size_t>							m_ready_nodes;
+		cancellation_token									m_cancellation_token;
+		clock_type::time_point								m_deadline{clock_type::time_point::max()};
+		std::mutex											m_mutex;		// Protects the state below.
+		detail::aligner_parameters <score_type>				m_parameters;
+		std::size_t											m_max_concurrent_alignments{};	// Zero for hardware concurrency.
+		std::size_t											m_running_alignments{};
+		std::size_t											m_remaining_merges{};
+		status_type											m_status{status_type::STATUS_NONE};
+		bool												m_is_stopping{};
+	
+	public:
+		progressive_aligner(context_type &ctx, t_delegate &delegate):
+			m_ctx(&ctx),
+			m_delegate(&delegate)
+		{
+		}
+		
+		progressive_aligner(progressive_aligner const &) = delete;
+		progressive_aligner &operator=(progressive_aligner const &) = delete;
+		
+		delegate_type &delegate() const { return *m_delegate; }
+		
+		score_type identity_score() const { return m_parameters.identity_score; }
+		score_type mismatch_penalty() const { return m_parameters.mismatch_penalty; }
+		score_type gap_start_penalty() const { return m_parameters.gap_start_penalty; }
+		score_type gap_penalty() const { return m_parameters.gap_penalty; }
+		std::uint32_t segment_length() const { return m_parameters.segment_length; }
+		std::size_t max_concurrent_alignments() const { return m_max_concurrent_alignments; }
+		status_type status() const override { return m_status; }
+		
+		std::vector <text_type> const &texts() const { return m_texts; }
+		guide_tree const &get_guide_tree() const { return m_guide_tree; }
+		std::vector <libbio::bit_vector> const &gaps() const { return m_gaps; }	// May be passed to multiple_alignment_graph_builder.
+		
+		void set_identity_score(score_type const score) { m_parameters.identity_score = score; }
+		void set_mismatch_penalty(score_type const score) { m_parameters.mismatch_penalty = score; }
+		void set_gap_start_penalty(score_type const score) { m_parameters.gap_start_penalty = score; }
+		void set_gap_penalty(score_type const score) { m_parameters.gap_penalty = score; }
+		void set_segment_length(std::uint32_t const length) override { m_parameters.segment_length = length; }
+		void set_prints_debugging_information(bool const should_print) override { m_parameters.print_debugging_information = should_print; }
+		void set_max_concurrent_alignments(std::size_t const count) { m_max_concurrent_alignments = count; }
+		void set_cancellation_token(cancellation_token const &token) { m_cancellation_token = token; }
+		void set_deadline(clock_type::time_point const deadline) { m_deadline = deadline; }
+		void clear_deadline() { m_deadline = clock_type::time_point::max(); }
+		
+		// Decode a text and return its index.
+		template <typename t_text>
+		std::size_t add_text(t_text const &text);
+		
+		// Build the guide tree from the completed pairwise scores of the texts and align.
+		void align(score_file_type const &scores);
+	
+	protected:
+		inline bool should_stop() const;
+		span_type consensus(std::size_t const node_idx) const;
+		void configure_aligner(typename alignment_context_type::aligner_type &aligner) const;
+		void start_next_merge(merge_context &ctx);
+		void merge_did_finish(merge_context &ctx, std::size_t const node_idx, result_type &&result);
+		void merge(std::size_t const node_idx, libbio::bit_vector const &lhs_gaps, libbio::bit_vector const &rhs_gaps);
+		void calculate_consensus(profile &prof) const;
+		void finish();
+		
+		static void expand_gaps(libbio::bit_vector const &gaps, libbio::bit_vector const &alignment_gaps, libbio::bit_vector &dst);
+		static void collect_runs(libbio::bit_vector const &gaps, std::vector <std::pair <bool, std::size_t>> &dst);
+	};
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	template <typename t_text>
+	std::size_t progressive_aligner <t_score, t_word, t_character, t_delegate>::add_text(t_text const &text)
+	{
+		libbio_assert(0 == m_running_alignments);
+		
+		// The end iterator may have a different type from that of begin.
+		auto const retval(m_texts.size());
+		auto &dst(m_texts.emplace_back());
+		auto it(text.begin());
+		auto const end(text.end());
+		for (; it != end; ++it)
+			dst.emplace_back(*it);
+		return retval;
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void progressive_aligner <t_score, t_word, t_character, t_delegate>::align(score_file_type const &scores)
+	{
+		// Only one alignment may be in progress at a time.
+		libbio_assert(0 == m_running_alignments);
+		libbio_always_assert(1 < m_texts.size());
+		
+		if (scores.text_count() != m_texts.size() || scores.completed_count() != scores.pair_count())
+			throw std::runtime_error("The pairwise scores of the texts have not been calculated");
+		
+		m_status = status_type::STATUS_NONE;
+		m_is_stopping = false;
+		m_gaps.clear();
+		
+		m_guide_tree.build_upgma(m_texts.size(), [&scores](std::size_t const lhs_idx, std::size_t const rhs_idx){
+			return scores.score(lhs_idx, rhs_idx);
+		});
+		
+		// Initialize the leaves with their texts.
+		auto const text_count(m_texts.size());
+		auto const node_count(m_guide_tree.node_count());
+		m_profiles.clear();
+		m_profiles.resize(node_count);
+		m_parents.resize(node_count);
+		m_finished_children.clear();
+		m_finished_children.resize(node_count, 0);
+		m_ready_nodes.clear();
+		for (std::size_t i(0); i < text_count; ++i)
+		{
+			auto &prof(m_profiles[i]);
+			prof.text_indices.push_back(i);
+			prof.gaps.emplace_back().push_back(false, m_texts[i].size());
+			prof.column_count = m_texts[i].size();
+		}
+		
+		for (std::size_t i(text_count); i < node_count; ++i)
+		{
+			auto const &node(m_guide_tree.internal_node(i));
+			m_parents[node.lhs] = i;
+			m_parents[node.rhs] = i;
+			
+			// The leaves are finished.
+			m_finished_children[i] = m_guide_tree.is_leaf(node.lhs) + m_guide_tree.is_leaf(node.rhs);
+			if (2 == m_finished_children[i])
+				m_ready_nodes.push_back(i);
+		}
+		
+		// Instantiate the aligners.
+		std::size_t const max_concurrent(
+			m_max_concurrent_alignments
+			? m_max_concurrent_alignments
+			: std::max(1U, std::thread::hardware_concurrency())
+		);
+		auto const context_count(std::min(max_concurrent, m_ready_nodes.size()));
+		while (m_merge_contexts.size() < context_count)
+			m_merge_contexts.emplace_back(std::make_unique <merge_context>(*m_ctx));
+		
+		{
+			std::lock_guard <std::mutex> lock(m_mutex);
+			m_running_alignments = context_count;
+			m_remaining_merges = node_count - text_count;
+		}
+		
+		for (std::size_t i(0); i < context_count; ++i)
+		{
+			auto *ctx(m_merge_contexts[i].get());
+			boost::asio::post(*m_ctx, [this, ctx](){
+				start_next_merge(*ctx);
+			});
+		}
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	bool progressive_aligner <t_score, t_word, t_character, t_delegate>::should_stop() const
+	{
+		if (m_cancellation_token.is_cancelled())
+			return true;
+		
+		if (clock_type::time_point::max() != m_deadline && m_deadline <= clock_type::now())
+			return true;
+		
+		return false;
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	auto progressive_aligner <t_score, t_word, t_character, t_delegate>::consensus(std::size_t const node_idx) const -> span_type
+	{
+		auto const &text(m_guide_tree.is_leaf(node_idx) ? m_texts[node_idx] : m_profiles[node_idx].consensus);
+		return span_type{text.data(), text.data() + text.size()};
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void progressive_aligner <t_score, t_word, t_character, t_delegate>::configure_aligner(
+		typename alignment_context_type::aligner_type &aligner
+	) const
+	{
+		aligner.set_identity_score(m_parameters.identity_score);
+		aligner.set_mismatch_penalty(m_parameters.mismatch_penalty);
+		aligner.set_gap_start_penalty(m_parameters.gap_start_penalty);
+		aligner.set_gap_penalty(m_parameters.gap_penalty);
+		aligner.set_segment_length(m_parameters.segment_length); // Zero for determining from the text.
+		aligner.set_prints_debugging_information(m_parameters.print_debugging_information);
+		aligner.set_cancellation_token(m_cancellation_token);
+		aligner.set_deadline(m_deadline);
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void progressive_aligner <t_score, t_word, t_character, t_delegate>::start_next_merge(merge_context &ctx)
+	{
+		while (true)
+		{
+			std::size_t node_idx(0);
+			bool is_last(false);
+			
+			{
+				std::lock_guard <std::mutex> lock(m_mutex);
+				if (should_stop())
+					m_is_stopping = true;
+				
+				if (m_is_stopping || m_ready_nodes.empty())
+				{
+					is_last = (0 == --m_running_alignments);
+					if (!is_last)
+						return;
+				}
+				else
+				{
+					node_idx = m_ready_nodes.front();
+					m_ready_nodes.pop_front();
+				}
+			}
+			
+			if (is_last)
+			{
+				finish();
+				return;
+			}
+			
+			// The aligner requires non-empty texts.
+			auto const &node(m_guide_tree.internal_node(node_idx));
+			auto const &lhs(ctx.lhs = consensus(node.lhs));
+			auto const &rhs(ctx.rhs = consensus(node.rhs));
+			if (0 == lhs.size() || 0 == rhs.size())
+			{
+				libbio::bit_vector lhs_gaps;
+				libbio::bit_vector rhs_gaps;
+				lhs_gaps.push_back(true, rhs.size());
+				lhs_gaps.push_back(false, lhs.size());
+				rhs_gaps.push_back(false, rhs.size());
+				rhs_gaps.push_back(true, lhs.size());
+				merge(node_idx, lhs_gaps, rhs_gaps);
+				continue;
+			}
+			
+			configure_aligner(ctx.context.get_aligner());
+			ctx.context.align_async(
+				lhs,
+				rhs,
+				lhs.size(),
+				rhs.size(),
+				[this, &ctx, node_idx](result_type &&result){
+					merge_did_finish(ctx, node_idx, std::move(result));
+				}
+			);
+			return;
+		}
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void progressive_aligner <t_score, t_word, t_character, t_delegate>::merge_did_finish(
+		merge_context &ctx,
+		std::size_t const node_idx,
+		result_type &&result
+	)
+	{
+		if (status_type::STATUS_FINISHED == result.status)
+			merge(node_idx, result.lhs_gaps, result.rhs_gaps);
+		else
+		{
+			std::lock_guard <std::mutex> lock(m_mutex);
+			m_is_stopping = true;
+		}
+		
+		// Reuse the aligner for the next node.
+		start_next_merge(ctx);
+	}
+	
+	
+	// Combine the profiles of the children of the given node. Only the thread that aligned
+	// the children accesses their profiles.
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void progressive_aligner <t_score, t_word, t_character, t_delegate>::merge(
+		std::size_t const node_idx,
+		libbio::bit_vector const &lhs_gaps,
+		libbio::bit_vector const &rhs_gaps
+	)
+	{
+		auto const &node(m_guide_tree.internal_node(node_idx));
+		auto &lhs(m_profiles[node.lhs]);
+		auto &rhs(m_profiles[node.rhs]);
+		libbio_assert(lhs_gaps.size() == rhs_gaps.size());
+		
+		profile merged;
+		merged.column_count = lhs_gaps.size();
+		merged.text_indices.reserve(lhs.text_indices.size() + rhs.text_indices.size());
+		merged.gaps.resize(lhs.gaps.size() + rhs.gaps.size());
+		merged.text_indices.insert(merged.text_indices.end(), lhs.text_indices.begin(), lhs.text_indices.end());
+		merged.text_indices.insert(merged.text_indices.end(), rhs.text_indices.begin(), rhs.text_indices.end());
+		for (std::size_t i(0), count(lhs.gaps.size()); i < count; ++i)
+			expand_gaps(lhs.gaps[i], lhs_gaps, merged.gaps[i]);
+		for (std::size_t i(0), count(rhs.gaps.size()); i < count; ++i)
+			expand_gaps(rhs.gaps[i], rhs_gaps, merged.gaps[lhs.gaps.size() + i]);
+		
+		// Release the children.
+		lhs = profile();
+		rhs = profile();
+		
+		bool const is_root(m_guide_tree.root() == node_idx);
+		if (is_root)
+		{
+			// Store the result by text.
+			m_gaps.resize(m_texts.size());
+			for (std::size_t i(0), count(merged.text_indices.size()); i < count; ++i)
+				m_gaps[merged.text_indices[i]] = std::move(merged.gaps[i]);
+		}
+		else
+		{
+			calculate_consensus(merged);
+		}
+		
+		std::lock_guard <std::mutex> lock(m_mutex);
+		if (!is_root)
+		{
+			m_profiles[node_idx] = std::move(merged);
+			
+			// The current context will align the parent. Since each merge makes at most one node ready,
+			// the number of the ready nodes does not exceed the initial count.
+			auto const parent(m_parents[node_idx]);
+			if (2 == ++m_finished_children[parent])
+				m_ready_nodes.push_back(parent);
+		}
+		
+		--m_remaining_merges;
+	}
+	
+	
+	// Choose the most frequent character in each column. Walk the gap vectors in parallel
+	// so that no per-column state needs to be stored.
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void progressive_aligner <t_score, t_word, t_character, t_delegate>::calculate_consensus(profile &prof) const
+	{
+		struct row_cursor
+		{
+			std::vector <std::pair <bool, std::size_t>>	gap_runs;
+			std::size_t									run_idx{};
+			std::size_t									remaining{};
+			t_character const							*text{};
+		};
+		
+		auto const text_count(prof.text_indices.size());
+		std::vector <row_cursor> cursors(text_count);
+		for (std::size_t i(0); i < text_count; ++i)
+		{
+			auto &cursor(cursors[i]);
+			collect_runs(prof.gaps[i], cursor.gap_runs);
+			if (!cursor.gap_runs.empty())
+				cursor.remaining = cursor.gap_runs.front().second;
+			cursor.text = m_texts[prof.text_indices[i]].data();
+		}
+		
+		std::vector <std::pair <t_character, std::size_t>> counts;
+		prof.consensus.clear();
+		prof.consensus.reserve(prof.column_count);
+		for (std::size_t col(0); col < prof.column_count; ++col)
+		{
+			counts.clear();
+			for (auto &cursor : cursors)
+			{
+				while (!cursor.remaining)
+					cursor.remaining = cursor.gap_runs[++cursor.run_idx].second;
+				--cursor.remaining;
+				
+				if (cursor.gap_runs[cursor.run_idx].first)
+					continue;
+				
+				auto const c(*cursor.text++);
+				auto const it(std::find_if(counts.begin(), counts.end(), [c](auto const &pair){ return pair.first == c; }));
+				if (counts.end() == it)
+					counts.emplace_back(c, 1);
+				else
+					++it->second;
+			}
+			
+			// Each column has at least one character.
+			libbio_assert(!counts.empty());
+			auto const it(std::max_element(counts.begin(), counts.end(), [](auto const &lhs, auto const &rhs){
+				return lhs.second < rhs.second;
+			}));
+			prof.consensus.push_back(it->first);
+		}
+	}
+	
+	
+	// Insert gaps to the positions marked in the gap vector of a pairwise alignment of consensus sequences.
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void progressive_aligner <t_score, t_word, t_character, t_delegate>::expand_gaps(
+		libbio::bit_vector const &gaps,
+		libbio::bit_vector const &alignment_gaps,
+		libbio::bit_vector &dst
+	)
+	{
+		std::vector <std::pair <bool, std::size_t>> gap_runs;
+		collect_runs(gaps, gap_runs);
+		
+		std::size_t run_idx(0);
+		std::size_t remaining(gap_runs.empty() ? 0 : gap_runs.front().second);
+		for_each_bit_run(alignment_gaps, [&](bool const is_gap, std::size_t length){
+			if (is_gap)
+			{
+				dst.push_back(true, length);
+				return;
+			}
+			
+			// Copy the existing columns.
+			while (length)
+			{
+				while (!remaining)
+					remaining = gap_runs[++run_idx].second;
+				
+				auto const count(std::min(length, remaining));
+				dst.push_back(gap_runs[run_idx].first, count);
+				length -= count;
+				remaining -= count;
+			}
+		});
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void progressive_aligner <t_score, t_word, t_character, t_delegate>::collect_runs(
+		libbio::bit_vector const &gaps,
+		std::vector <std::pair <bool, std::size_t>> &dst
+	)
+	{
+		dst.clear();
+		for_each_bit_run(gaps, [&dst](bool const is_gap, std::size_t const length){
+			dst.emplace_back(is_gap, length);
+		});
+	}
+	
+	
+	template <typename t_score, typename t_word, typename t_character, typename t_delegate>
+	void progressive_aligner <t_score, t_word, t_character, t_delegate>::finish()
+	{
+		m_profiles.clear();
+		m_status = (m_is_stopping || m_remaining_merges ? status_type::STATUS_CANCELLED : status_type::STATUS_FINISHED);
+		if (status_type::STATUS_FINISHED != m_status)
+			m_gaps.clear();
+		m_delegate->finish(*this);
+	}
+}}
+
+#endif
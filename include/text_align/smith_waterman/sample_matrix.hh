@@ -0,0 +1,382 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_SMITH_WATERMAN_SAMPLE_MATRIX_HH
+#define TEXT_ALIGN_SMITH_WATERMAN_SAMPLE_MATRIX_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <libbio/assert.hh>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <text_align/smith_waterman/mapped_buffer.hh>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+namespace text_align { namespace smith_waterman {
+	
+	enum class sample_encoding : std::uint8_t
+	{
+		PLAIN		= 0x0,
+		DELTA_16	= 0x1,	// Differences from the nearest preceding value stored as is as std::int16_t.
+		DELTA_8		= 0x2	// As above but std::int8_t; only suitable for small scores.
+	};
+}}
+
+
+namespace text_align { namespace smith_waterman { namespace detail {
+	
+	// Column-major matrix for the score samples. The values are stored in a mapped_buffer, i.e. in a memory-mapped
+	// temporary file if a directory has been set.
+	//
+	// With a delta encoding, every anchor_interval()th row is stored as is and the rest as differences from the
+	// preceding such row. The interval is chosen from the given bound for the difference of adjacent values in
+	// a column so that the differences fit, and the values are stored as is if the bound is not known or is too
+	// large for the encoding. The rows of each interval are stored in increasing order, so the values may be
+	// stored and loaded in constant time. One code is reserved for the value set with set_reserved_value(), i.e.
+	// the samples of the skipped blocks; if the first row of an interval has that value, the first other value
+	// of the interval is stored as is instead. Differences that still do not fit, which only happens if the
+	// bound is too small, are stored separately.
+	template <typename t_value>
+	class sample_matrix
+	{
+		static_assert(std::is_signed_v <t_value>);
+	
+	public:
+		typedef t_value									value_type;
+		typedef std::make_unsigned_t <t_value>			unsigned_value_type;
+	
+	protected:
+		mapped_buffer									m_storage;
+		std::vector <t_value>							m_anchor_values;
+		std::unordered_map <std::size_t, t_value>		m_escaped_values;
+		mutable std::mutex								m_escape_mutex;
+		std::size_t										m_rows{};
+		std::size_t										m_columns{};
+		std::size_t										m_anchor_interval{1};
+		std::size_t										m_anchors_per_column{};
+		std::uintmax_t									m_max_step{};
+		t_value											m_reserved_value{std::numeric_limits <t_value>::lowest()};
+		sample_encoding									m_encoding{sample_encoding::PLAIN};
+		sample_encoding									m_encoding_in_use{sample_encoding::PLAIN};
+	
+	public:
+		sample_matrix() = default;
+		
+		sample_matrix(sample_matrix const &) = delete;
+		sample_matrix &operator=(sample_matrix const &) = delete;
+		
+		sample_matrix(sample_matrix &&other) { *this = std::move(other); }
+		inline sample_matrix &operator=(sample_matrix &&other);
+		
+		// Map the values from a file in the given directory on the next resize. Empty for memory.
+		void set_file_directory(std::string const &path) { m_storage.set_file_directory(path); }
+		std::string const &file_directory() const { return m_storage.file_directory(); }
+		bool is_mapped() const { return m_storage.is_mapped(); }
+		
+		// Take effect on the next resize. The maximum step is the greatest absolute difference
+		// of adjacent values in a column other than the reserved one, zero if not known.
+		void set_encoding(sample_encoding const encoding) { m_encoding = encoding; }
+		void set_max_step(std::uintmax_t const step) { m_max_step = step; }
+		sample_encoding encoding() const { return m_encoding; }
+		sample_encoding encoding_in_use() const { return m_encoding_in_use; }
+		void set_reserved_value(t_value const value) { m_reserved_value = value; }
+		
+		// The values are unspecified after resizing.
+		void resize(std::size_t const rows, std::size_t const columns, std::size_t const segment_length);
+		void fill(t_value const value);
+		
+		std::size_t number_of_rows() const { return m_rows; }
+		std::size_t number_of_columns() const { return m_columns; }
+		std::size_t anchor_interval() const { return m_anchor_interval; }
+		std::size_t escaped_count() const { return m_escaped_values.size(); }
+		
+		// The rows of each anchor interval need to be stored in increasing order.
+		inline t_value load(std::size_t const row, std::size_t const column) const;
+		inline void store(std::size_t const row, std::size_t const column, t_value const value);
+		
+		// Copy rows [first, limit) of the given column.
+		template <typename t_iterator>
+		inline void copy(std::size_t const column, std::size_t const first, std::size_t const limit, t_iterator dst) const;
+		
+		// Ask the operating system to read rows [first, limit) of the given column if the values are mapped.
+		void prefetch(std::size_t const column, std::size_t const first, std::size_t limit) const;
+	
+	protected:
+		char *data() { return m_storage.data(); }
+		char const *data() const { return m_storage.data(); }
+		std::size_t element_size() const;
+		std::size_t anchor_index(std::size_t const row, std::size_t const column) const { return column * m_anchors_per_column + row / m_anchor_interval; }
+		
+		// The greatest absolute difference that may be encoded; the two smallest codes are reserved.
+		template <typename t_delta>
+		static constexpr std::uintmax_t max_delta() { return std::numeric_limits <t_delta>::max() - 1; }
+		
+		// The anchor is only read if needed, since the first value of the interval may be stored concurrently
+		// if the loaded value is the reserved one.
+		template <typename t_delta>
+		inline t_value decode(std::size_t const idx, t_value const &anchor) const;
+		
+		template <typename t_delta>
+		inline void encode(std::size_t const idx, t_value const anchor, t_value const value);
+	};
+	
+	
+	template <typename t_value>
+	auto sample_matrix <t_value>::operator=(sample_matrix &&other) -> sample_matrix &
+	{
+		// The mutex is not moved.
+		if (this != &other)
+		{
+			m_storage = std::move(other.m_storage);
+			m_anchor_values = std::move(other.m_anchor_values);
+			m_escaped_values = std::move(other.m_escaped_values);
+			m_rows = other.m_rows;
+			m_columns = other.m_columns;
+			m_anchor_interval = other.m_anchor_interval;
+			m_anchors_per_column = other.m_anchors_per_column;
+			m_max_step = other.m_max_step;
+			m_reserved_value = other.m_reserved_value;
+			m_encoding = other.m_encoding;
+			m_encoding_in_use = other.m_encoding_in_use;
+			
+			other.m_rows = 0;
+			other.m_columns = 0;
+		}
+		return *this;
+	}
+	
+	
+	template <typename t_value>
+	std::size_t sample_matrix <t_value>::element_size() const
+	{
+		switch (m_encoding_in_use)
+		{
+			case sample_encoding::PLAIN:
+				return sizeof(t_value);
+			case sample_encoding::DELTA_16:
+				return sizeof(std::int16_t);
+			case sample_encoding::DELTA_8:
+				return sizeof(std::int8_t);
+		}
+		
+		libbio_fail("Unexpected sample encoding");
+		return 0;
+	}
+	
+	
+	template <typename t_value>
+	void sample_matrix <t_value>::resize(std::size_t const rows, std::size_t const columns, std::size_t const segment_length)
+	{
+		libbio_assert(0 < segment_length);
+		
+		// Choose the interval so that the difference of each value and the preceding anchor fits. The values
+		// of the rows of an interval need not be adjacent, since the ones in between may have been replaced
+		// with the reserved value, but the step bound holds for the values that were replaced, too. Intervals
+		// longer than the segment would not decrease the size much.
+		m_encoding_in_use = m_encoding;
+		m_anchor_interval = 1;
+		if (sample_encoding::PLAIN != m_encoding)
+		{
+			auto const max_delta_(sample_encoding::DELTA_16 == m_encoding ? max_delta <std::int16_t>() : max_delta <std::int8_t>());
+			if (m_max_step)
+				m_anchor_interval = std::min <std::uintmax_t>(segment_length, max_delta_ / m_max_step);
+			
+			// Every value would be stored as is.
+			if (m_anchor_interval < 2)
+			{
+				m_encoding_in_use = sample_encoding::PLAIN;
+				m_anchor_interval = 1;
+			}
+		}
+		
+		m_storage.resize(rows * columns * element_size());
+		m_rows = rows;
+		m_columns = columns;
+		m_anchors_per_column = (rows + m_anchor_interval - 1) / m_anchor_interval;
+		
+		if (sample_encoding::PLAIN == m_encoding_in_use)
+		{
+			m_anchor_values.clear();
+			m_anchor_values.shrink_to_fit();
+		}
+		else
+			m_anchor_values.resize(columns * m_anchors_per_column);
+		m_escaped_values.clear();
+	}
+	
+	
+	template <typename t_value>
+	void sample_matrix <t_value>::fill(t_value const value)
+	{
+		m_escaped_values.clear();
+		if (sample_encoding::PLAIN == m_encoding_in_use)
+		{
+			auto *values(reinterpret_cast <t_value *>(data()));
+			std::fill(values, values + m_rows * m_columns, value);
+		}
+		else
+		{
+			// Zero differences.
+			std::fill(m_anchor_values.begin(), m_anchor_values.end(), value);
+			std::fill(data(), data() + m_rows * m_columns * element_size(), 0);
+		}
+	}
+	
+	
+	template <typename t_value>
+	template <typename t_delta>
+	auto sample_matrix <t_value>::decode(std::size_t const idx, t_value const &anchor) const -> t_value
+	{
+		constexpr t_delta const ESCAPE(std::numeric_limits <t_delta>::min());
+		constexpr t_delta const RESERVED(1 + ESCAPE);
+		
+		auto const delta(reinterpret_cast <t_delta const *>(data())[idx]);
+		switch (delta)
+		{
+			case ESCAPE:
+			{
+				std::lock_guard <std::mutex> lock(m_escape_mutex);
+				auto const it(m_escaped_values.find(idx));
+				libbio_assert(m_escaped_values.end() != it);
+				return it->second;
+			}
+			
+			case RESERVED:
+				return m_reserved_value;
+			
+			default:
+				return anchor + delta;
+		}
+	}
+	
+	
+	template <typename t_value>
+	template <typename t_delta>
+	void sample_matrix <t_value>::encode(std::size_t const idx, t_value const anchor, t_value const value)
+	{
+		constexpr t_delta const ESCAPE(std::numeric_limits <t_delta>::min());
+		constexpr t_delta const RESERVED(1 + ESCAPE);
+		
+		auto *deltas(reinterpret_cast <t_delta *>(data()));
+		if (value == m_reserved_value)
+		{
+			deltas[idx] = RESERVED;
+			return;
+		}
+		
+		// Calculate the difference without overflow.
+		if (anchor <= value)
+		{
+			std::uintmax_t const diff(unsigned_value_type(unsigned_value_type(value) - unsigned_value_type(anchor)));
+			if (diff <= max_delta <t_delta>())
+			{
+				deltas[idx] = t_delta(diff);
+				return;
+			}
+		}
+		else
+		{
+			std::uintmax_t const diff(unsigned_value_type(unsigned_value_type(anchor) - unsigned_value_type(value)));
+			if (diff <= max_delta <t_delta>())
+			{
+				deltas[idx] = -t_delta(diff);
+				return;
+			}
+		}
+		
+		{
+			std::lock_guard <std::mutex> lock(m_escape_mutex);
+			m_escaped_values[idx] = value;
+		}
+		deltas[idx] = ESCAPE;
+	}
+	
+	
+	template <typename t_value>
+	auto sample_matrix <t_value>::load(std::size_t const row, std::size_t const column) const -> t_value
+	{
+		libbio_assert(row < m_rows);
+		libbio_assert(column < m_columns);
+		auto const idx(column * m_rows + row);
+		switch (m_encoding_in_use)
+		{
+			case sample_encoding::PLAIN:
+				return reinterpret_cast <t_value const *>(data())[idx];
+			case sample_encoding::DELTA_16:
+				return decode <std::int16_t>(idx, m_anchor_values[anchor_index(row, column)]);
+			case sample_encoding::DELTA_8:
+				return decode <std::int8_t>(idx, m_anchor_values[anchor_index(row, column)]);
+		}
+		
+		libbio_fail("Unexpected sample encoding");
+		return 0;
+	}
+	
+	
+	template <typename t_value>
+	void sample_matrix <t_value>::store(std::size_t const row, std::size_t const column, t_value const value)
+	{
+		libbio_assert(row < m_rows);
+		libbio_assert(column < m_columns);
+		auto const idx(column * m_rows + row);
+		if (sample_encoding::PLAIN == m_encoding_in_use)
+		{
+			reinterpret_cast <t_value *>(data())[idx] = value;
+			return;
+		}
+		
+		// The first row of the interval is stored as is, as is the first other value if the first row has the reserved value.
+		// In the latter case, the preceding rows of the interval have the reserved value and hence do not depend on the anchor.
+		auto &anchor(m_anchor_values[anchor_index(row, column)]);
+		if (0 == row % m_anchor_interval || anchor == m_reserved_value)
+			anchor = value;
+		
+		if (sample_encoding::DELTA_16 == m_encoding_in_use)
+			encode <std::int16_t>(idx, anchor, value);
+		else
+			encode <std::int8_t>(idx, anchor, value);
+	}
+	
+	
+	template <typename t_value>
+	template <typename t_iterator>
+	void sample_matrix <t_value>::copy(std::size_t const column, std::size_t const first, std::size_t const limit, t_iterator dst) const
+	{
+		libbio_assert(first <= limit);
+		libbio_assert(limit <= m_rows);
+		if (sample_encoding::PLAIN == m_encoding_in_use)
+		{
+			auto const *values(reinterpret_cast <t_value const *>(data()) + column * m_rows);
+			std::copy(values + first, values + limit, dst);
+		}
+		else
+		{
+			for (std::size_t row(first); row < limit; ++row)
+			{
+				*dst = load(row, column);
+				++dst;
+			}
+		}
+	}
+	
+	
+	template <typename t_value>
+	void sample_matrix <t_value>::prefetch(std::size_t const column, std::size_t const first, std::size_t limit) const
+	{
+		limit = std::min(limit, m_rows);
+		if (limit <= first)
+			return;
+		
+		auto const size(element_size());
+		m_storage.prefetch(size * (column * m_rows + first), size * (limit - first));
+	}
+}}}
+
+#endif
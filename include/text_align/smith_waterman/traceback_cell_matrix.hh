@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_SMITH_WATERMAN_TRACEBACK_CELL_MATRIX_HH
+#define TEXT_ALIGN_SMITH_WATERMAN_TRACEBACK_CELL_MATRIX_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <libbio/assert.hh>
+#include <string>
+#include <text_align/smith_waterman/aligner_base.hh>
+#include <text_align/smith_waterman/mapped_buffer.hh>
+
+
+namespace text_align { namespace smith_waterman { namespace detail {
+	
+	// Arrow and gap start position of each cell, packed into four bits, so that both are stored and loaded
+	// with one memory operation. The cells are written without atomic operations. Each column begins at
+	// a byte boundary, so the cells that share a byte are in consecutive rows of one column. When used for
+	// the samples, such cells are written either by one block or by blocks that are ordered by the flags.
+	// Like the score samples, the cells may be stored in a memory-mapped file.
+	class traceback_cell_matrix
+	{
+	public:
+		typedef aligner_base::arrow_type				arrow_type;
+		typedef aligner_base::gap_start_position_type	gap_start_position_type;
+	
+	protected:
+		mapped_buffer				m_storage;	// Column-major, two cells per byte.
+		std::size_t					m_rows{};
+		std::size_t					m_columns{};
+		std::size_t					m_column_bytes{};
+	
+	public:
+		// Map the cells from a file in the given directory on the next resize. Empty for memory.
+		void set_file_directory(std::string const &path) { m_storage.set_file_directory(path); }
+		bool is_mapped() const { return m_storage.is_mapped(); }
+		
+		void resize(std::size_t const rows, std::size_t const columns) { m_rows = rows; m_columns = columns; m_column_bytes = (1 + rows) / 2; m_storage.resize(m_column_bytes * columns); }
+		void clear() { std::fill(data(), data() + m_storage.size(), 0); }
+		
+		std::size_t number_of_rows() const { return m_rows; }
+		std::size_t number_of_columns() const { return m_columns; }
+		
+		inline std::uint8_t load(std::size_t const row, std::size_t const column) const;
+		arrow_type arrow(std::size_t const row, std::size_t const column) const { return static_cast <arrow_type>(load(row, column) & arrow_type::ARROW_MASK); }
+		gap_start_position_type gap_start_position(std::size_t const row, std::size_t const column) const { return static_cast <gap_start_position_type>(load(row, column) >> 2); }
+		std::uint8_t operator()(std::size_t const row, std::size_t const column) const { return arrow(row, column); } // For matrix_printer.
+		
+		// Replace the value.
+		inline void store(std::size_t const row, std::size_t const column, std::uint8_t const arrow, gap_start_position_type const gsp);
+		
+		// Combine with the previous value.
+		inline void merge(std::size_t const row, std::size_t const column, std::uint8_t const arrow, std::uint8_t const gsp);
+		inline void merge(std::size_t const row, std::size_t const column, std::uint8_t const value) { merge(row, column, value & arrow_type::ARROW_MASK, value >> 2); }
+		
+		// Set the arrow and the gap start position of each cell in the column.
+		inline void fill_column(std::size_t const column, std::uint8_t const arrow, gap_start_position_type const gsp);
+	
+		// Ask the operating system to read rows [first, limit) of the given column if the cells are mapped.
+		inline void prefetch(std::size_t const column, std::size_t const first, std::size_t limit) const;
+	
+	protected:
+		std::uint8_t *data() { return reinterpret_cast <std::uint8_t *>(m_storage.data()); }
+		std::uint8_t const *data() const { return reinterpret_cast <std::uint8_t const *>(m_storage.data()); }
+		std::uint8_t &byte(std::size_t const row, std::size_t const column) { libbio_assert(row < m_rows); libbio_assert(column < m_columns); return data()[column * m_column_bytes + row / 2]; }
+		std::uint8_t byte(std::size_t const row, std::size_t const column) const { libbio_assert(row < m_rows); libbio_assert(column < m_columns); return data()[column * m_column_bytes + row / 2]; }
+		static std::uint8_t shift(std::size_t const row) { return 4 * (row % 2); }
+		static std::uint8_t cell_value(std::uint8_t const arrow, std::uint8_t const gsp) { return (arrow & arrow_type::ARROW_MASK) | ((gsp & gap_start_position_type::GSP_MASK) << 2); }
+	};
+	
+	
+	std::uint8_t traceback_cell_matrix::load(std::size_t const row, std::size_t const column) const
+	{
+		return (byte(row, column) >> shift(row)) & 0xf;
+	}
+	
+	
+	void traceback_cell_matrix::store(std::size_t const row, std::size_t const column, std::uint8_t const arrow, gap_start_position_type const gsp)
+	{
+		auto &dst(byte(row, column));
+		auto const sh(shift(row));
+		dst = (dst & ~(0xf << sh)) | (cell_value(arrow, gsp) << sh);
+	}
+	
+	
+	void traceback_cell_matrix::merge(std::size_t const row, std::size_t const column, std::uint8_t const arrow, std::uint8_t const gsp)
+	{
+		byte(row, column) |= (cell_value(arrow, gsp) << shift(row));
+	}
+	
+	
+	inline void traceback_cell_matrix::fill_column(std::size_t const column, std::uint8_t const arrow, gap_start_position_type const gsp)
+	{
+		auto const value(cell_value(arrow, gsp));
+		auto *const it(data() + column * m_column_bytes);
+		std::fill(it, it + m_column_bytes, std::uint8_t(value | (value << 4)));
+	}
+	
+	
+	void traceback_cell_matrix::prefetch(std::size_t const column, std::size_t const first, std::size_t limit) const
+	{
+		limit = std::min(limit, m_rows);
+		if (limit <= first)
+			return;
+		
+		auto const begin(column * m_column_bytes + first / 2);
+		auto const end(column * m_column_bytes + (1 + limit) / 2);
+		m_storage.prefetch(begin, end - begin);
+	}
+}}}
+
+#endif
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_TOKENIZER_HH
+#define TEXT_ALIGN_TOKENIZER_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <text_align/anchors.hh>
+#include <unordered_map>
+#include <vector>
+
+
+namespace text_align {
+	
+	typedef std::uint32_t token_id_type;
+	
+	enum class character_class : std::uint8_t
+	{
+		SPACE		= 0,
+		PUNCTUATION	= 1,
+		IDEOGRAPH	= 2,	// Not joined with the adjacent characters.
+		WORD		= 3
+	};
+	
+	
+	// Approximate the word boundary rules of UAX #29 by classifying the code points.
+	inline character_class classify_character(char32_t const c);
+	
+	
+	// Assign a dense identifier to each distinct token. The tokens are stored as pointers to
+	// the texts, so the texts need to outlive the interner.
+	template <typename t_character>
+	class token_interner
+	{
+	protected:
+		struct token
+		{
+			t_character const	*first{};
+			t_character const	*last{};
+		};
+		
+		struct token_hash
+		{
+			std::size_t operator()(token const &tok) const;
+		};
+		
+		struct token_equal_to
+		{
+			bool operator()(token const &lhs, token const &rhs) const
+			{
+				return (lhs.last - lhs.first) == (rhs.last - rhs.first) && std::equal(lhs.first, lhs.last, rhs.first);
+			}
+		};
+		
+		typedef std::unordered_map <token, token_id_type, token_hash, token_equal_to> token_map;
+	
+	protected:
+		token_map	m_ids;
+	
+	public:
+		std::size_t size() const { return m_ids.size(); }
+		void clear() { m_ids.clear(); }
+		
+		token_id_type intern(t_character const *first, t_character const *last)
+		{
+			return m_ids.emplace(token{first, last}, m_ids.size()).first->second;
+		}
+	};
+	
+	
+	// Split the text to lines that include their terminators. The offsets of the tokens and
+	// the end of the text are stored to dst_offsets.
+	template <typename t_character>
+	void tokenize_lines(
+		std::vector <t_character> const &text,
+		token_interner <t_character> &interner,
+		std::vector <token_id_type> &dst_tokens,
+		std::vector <std::size_t> &dst_offsets
+	);
+	
+	// Split the text to runs of word characters, runs of whitespace and single punctuation
+	// characters and ideographs.
+	template <typename t_character>
+	void tokenize_words(
+		std::vector <t_character> const &text,
+		token_interner <t_character> &interner,
+		std::vector <token_id_type> &dst_tokens,
+		std::vector <std::size_t> &dst_offsets
+	);
+	
+	
+	character_class classify_character(char32_t const c)
+	{
+		if (c < 0x80)
+		{
+			if (' ' == c || ('\t' <= c && c <= '\r'))
+				return character_class::SPACE;
+			if (('0' <= c && c <= '9') || ('A' <= c && c <= 'Z') || ('a' <= c && c <= 'z') || '_' == c)
+				return character_class::WORD;
+			return character_class::PUNCTUATION;
+		}
+		
+		switch (c)
+		{
+			case 0x85:
+			case 0xa0:
+			case 0x1680:
+			case 0x2028:
+			case 0x2029:
+			case 0x202f:
+			case 0x205f:
+			case 0x3000:
+				return character_class::SPACE;
+			
+			default:
+				break;
+		}
+		
+		if (0x2000 <= c && c <= 0x200a)
+			return character_class::SPACE;
+		
+		// Latin-1 punctuation and symbols, General Punctuation, CJK Symbols and Punctuation,
+		// fullwidth ASCII punctuation.
+		if (
+			(0xa1 <= c && c <= 0xbf && 0xaa != c && 0xb2 != c && 0xb3 != c && 0xb5 != c && 0xb9 != c && 0xba != c) ||
+			0xd7 == c || 0xf7 == c ||
+			(0x2010 <= c && c <= 0x2027) ||
+			(0x2030 <= c && c <= 0x205e) ||
+			(0x3001 <= c && c <= 0x303f) ||
+			(0xff01 <= c && c <= 0xff0f) ||
+			(0xff1a <= c && c <= 0xff20) ||
+			(0xff3b <= c && c <= 0xff40) ||
+			(0xff5b <= c && c <= 0xff65)
+		)
+			return character_class::PUNCTUATION;
+		
+		// Hiragana, Katakana, CJK ideographs, Hangul syllables and the supplementary ideographic planes.
+		if (
+			(0x3040 <= c && c <= 0x30ff) ||
+			(0x3400 <= c && c <= 0x4dbf) ||
+			(0x4e00 <= c && c <= 0x9fff) ||
+			(0xac00 <= c && c <= 0xd7af) ||
+			(0xf900 <= c && c <= 0xfaff) ||
+			(0x20000 <= c && c <= 0x3ffff)
+		)
+			return character_class::IDEOGRAPH;
+		
+		return character_class::WORD;
+	}
+	
+	
+	template <typename t_character>
+	std::size_t token_interner <t_character>::token_hash::operator()(token const &tok) const
+	{
+		// FNV-1a with a final mix.
+		std::uint64_t retval(0xcbf29ce484222325ULL);
+		for (auto it(tok.first); it != tok.last; ++it)
+			retval = (retval ^ std::uint64_t(*it)) * 0x100000001b3ULL;
+		return detail::mix_hash(retval);
+	}
+	
+	
+	template <typename t_character>
+	void tokenize_lines(
+		std::vector <t_character> const &text,
+		token_interner <t_character> &interner,
+		std::vector <token_id_type> &dst_tokens,
+		std::vector <std::size_t> &dst_offsets
+	)
+	{
+		dst_tokens.clear();
+		dst_offsets.clear();
+		
+		auto const *first(text.data());
+		auto const *last(text.data() + text.size());
+		auto const *line_begin(first);
+		while (line_begin != last)
+		{
+			auto const *line_end(std::find(line_begin, last, t_character('\n')));
+			if (line_end != last)
+				++line_end;
+			
+			dst_tokens.push_back(interner.intern(line_begin, line_end));
+			dst_offsets.push_back(line_begin - first);
+			line_begin = line_end;
+		}
+		
+		dst_offsets.push_back(text.size());
+	}
+	
+	
+	template <typename t_character>
+	void tokenize_words(
+		std::vector <t_character> const &text,
+		token_interner <t_character> &interner,
+		std::vector <token_id_type> &dst_tokens,
+		std::vector <std::size_t> &dst_offsets
+	)
+	{
+		dst_tokens.clear();
+		dst_offsets.clear();
+		
+		auto const *first(text.data());
+		auto const *last(text.data() + text.size());
+		auto const *token_begin(first);
+		while (token_begin != last)
+		{
+			auto const cls(classify_character(*token_begin));
+			auto const *token_end(token_begin + 1);
+			if (character_class::SPACE == cls || character_class::WORD == cls)
+			{
+				while (token_end != last && classify_character(*token_end) == cls)
+					++token_end;
+			}
+			
+			dst_tokens.push_back(interner.intern(token_begin, token_end));
+			dst_offsets.push_back(token_begin - first);
+			token_begin = token_end;
+		}
+		
+		dst_offsets.push_back(text.size());
+	}
+}
+
+#endif
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_UNIQUE_FUNCTION_HH
+#define TEXT_ALIGN_UNIQUE_FUNCTION_HH
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+
+namespace text_align {
+	
+	template <typename t_signature>
+	class unique_function;
+	
+	
+	// Like std::function but only requires the target to be move-constructible,
+	// so e.g. lambdas that capture a std::promise may be stored.
+	template <typename t_return, typename ... t_args>
+	class unique_function <t_return(t_args ...)>
+	{
+	protected:
+		struct callable_base
+		{
+			virtual ~callable_base() {}
+			virtual t_return call(t_args ... args) = 0;
+		};
+		
+		template <typename t_fn>
+		struct callable final : public callable_base
+		{
+			t_fn fn;
+			
+			callable(t_fn &&fn_): fn(std::move(fn_)) {}
+			t_return call(t_args ... args) override { return fn(std::forward <t_args>(args)...); }
+		};
+	
+	protected:
+		std::unique_ptr <callable_base>	m_callable;
+	
+	public:
+		unique_function() = default;
+		unique_function(std::nullptr_t) {}
+		
+		template <
+			typename t_fn,
+			typename = std::enable_if_t <!std::is_same_v <std::decay_t <t_fn>, unique_function>>
+		>
+		unique_function(t_fn &&fn):
+			m_callable(new callable <std::decay_t <t_fn>>(std::decay_t <t_fn>(std::forward <t_fn>(fn))))
+		{
+		}
+		
+		unique_function(unique_function &&) = default;
+		unique_function &operator=(unique_function &&) = default;
+		unique_function &operator=(std::nullptr_t) { m_callable.reset(); return *this; }
+		
+		explicit operator bool() const { return bool(m_callable); }
+		t_return operator()(t_args ... args) { return m_callable->call(std::forward <t_args>(args)...); }
+	};
+}
+
+#endif
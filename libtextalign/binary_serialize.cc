@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#include <stdexcept>
+#include <text_align/binary_serialize.hh>
+
+
+namespace text_align { namespace binary { namespace {
+	
+	char const s_magic[4]{'T', 'X', 'A', 'L'};
+	
+	
+	class reader
+	{
+	protected:
+		std::uint8_t const	*m_it{};
+		std::uint8_t const	*m_end{};
+		
+	public:
+		reader(std::uint8_t const *data, std::size_t const size):
+			m_it(data),
+			m_end(data + size)
+		{
+		}
+		
+		std::size_t remaining() const { return m_end - m_it; }
+		
+		std::uint8_t read_byte()
+		{
+			if (m_it == m_end)
+				throw std::runtime_error("Unexpected end of input");
+			return *m_it++;
+		}
+		
+		std::uint64_t read_varint()
+		{
+			std::uint64_t retval(0);
+			for (std::size_t shift(0); shift < 64; shift += 7)
+			{
+				auto const byte(read_byte());
+				retval |= std::uint64_t(byte & 0x7f) << shift;
+				if (! (byte & 0x80))
+					return retval;
+			}
+			throw std::runtime_error("Varint too long");
+		}
+		
+		void read_gaps(gap_run_buffer &dst)
+		{
+			auto const bit_count(read_varint());
+			auto const first_value(read_byte());
+			auto const run_count(read_varint());
+			if (1 < first_value)
+				throw std::runtime_error("Unexpected run value");
+			
+			// Each run takes at least one byte.
+			if (remaining() < run_count)
+				throw std::runtime_error("Unexpected end of input");
+			
+			bool flag(first_value);
+			dst.clear();
+			dst.reserve(run_count);
+			for (std::uint64_t i(0); i < run_count; ++i)
+			{
+				dst.push_back(flag, read_varint());
+				flag = !flag;
+			}
+			
+			if (dst.size() != bit_count)
+				throw std::runtime_error("Run lengths do not match the bit count");
+		}
+	};
+}}}
+
+
+namespace text_align { namespace binary {
+	
+	void alignment_record::clear()
+	{
+		lhs_gaps.clear();
+		rhs_gaps.clear();
+		segments.clear();
+		score = 0;
+		flags = 0;
+	}
+	
+	
+	void write_header(buffer_type &dst, std::uint8_t const flags)
+	{
+		dst.insert(dst.end(), s_magic, s_magic + sizeof(s_magic));
+		dst.push_back(FORMAT_VERSION);
+		dst.push_back(flags);
+	}
+	
+	
+	void write_score(buffer_type &dst, std::int64_t const score)
+	{
+		std::uint64_t const val((std::uint64_t(score) << 1) ^ std::uint64_t(score >> 63));
+		write_varint(dst, val);
+	}
+	
+	
+	void write_gaps(buffer_type &dst, libbio::bit_vector const &gaps)
+	{
+		std::vector <std::size_t> runs;
+		for_each_bit_run(gaps, [&runs](bool const, std::size_t const length){
+			runs.push_back(length);
+		});
+		
+		write_varint(dst, gaps.size());
+		dst.push_back(gaps.size() && (*gaps.word_begin() & 0x1));
+		write_varint(dst, runs.size());
+		for (auto const run : runs)
+			write_varint(dst, run);
+	}
+	
+	
+	void write_graph(buffer_type &dst, alignment_graph::flat_segment_vector const &segments)
+	{
+		write_varint(dst, segments.size());
+		for (auto const &segment : segments)
+		{
+			dst.push_back(static_cast <std::uint8_t>(segment.type));
+			write_varint(dst, segment.lhs_length);
+			write_varint(dst, segment.rhs_length);
+		}
+	}
+	
+	
+	void decode(std::uint8_t const *data, std::size_t const size, alignment_record &dst)
+	{
+		reader reader(data, size);
+		dst.clear();
+		
+		for (auto const c : s_magic)
+		{
+			if (reader.read_byte() != static_cast <std::uint8_t>(c))
+				throw std::runtime_error("Unexpected magic number");
+		}
+		
+		auto const version(reader.read_byte());
+		if (FORMAT_VERSION < version || 0 == version)
+			throw std::runtime_error("Unsupported format version");
+		
+		dst.flags = reader.read_byte();
+		if (dst.has_score())
+		{
+			auto const val(reader.read_varint());
+			dst.score = std::int64_t(val >> 1) ^ -std::int64_t(val & 0x1);
+		}
+		
+		reader.read_gaps(dst.lhs_gaps);
+		reader.read_gaps(dst.rhs_gaps);
+		
+		if (dst.has_graph())
+		{
+			auto const segment_count(reader.read_varint());
+			if (reader.remaining() / 3 < segment_count)
+				throw std::runtime_error("Unexpected end of input");
+			
+			dst.segments.reserve(segment_count);
+			std::size_t lhs_offset(0);
+			std::size_t rhs_offset(0);
+			for (std::uint64_t i(0); i < segment_count; ++i)
+			{
+				auto const type(static_cast <alignment_graph::node_type>(reader.read_byte()));
+				if (! (alignment_graph::node_type::COMMON == type || alignment_graph::node_type::DISTINCT == type))
+					throw std::runtime_error("Unexpected segment type");
+				
+				auto &segment(dst.segments.emplace_back(type, lhs_offset, rhs_offset));
+				segment.lhs_length = reader.read_varint();
+				segment.rhs_length = reader.read_varint();
+				lhs_offset += segment.lhs_length;
+				rhs_offset += segment.rhs_length;
+			}
+		}
+	}
+}}
@@ -8,13 +8,18 @@ extern "C" {
 #	include <arpa/inet.h>
 #	include <postgres.h>
 #	include <fmgr.h>
+#	include <storage/proc.h>
 #	include <utils/builtins.h>
 }
 
-#include <sstream>
+#include <chrono>
 #include <text_align/alignment_graph_builder.hh>
+#include <text_align/binary_serialize.hh>
 #include <text_align/code_point_range.hh>
+#include <text_align/flat_alignment_graph.hh>
 #include <text_align/json_serialize.hh>
+#include <text_align/json_writer.hh>
+#include <text_align/qgram_filter.hh>
 #include <text_align/smith_waterman/alignment_context.hh>
 
 
@@ -48,6 +53,31 @@ namespace {
 	}
 	
 	
+	struct alignment_cancelled_exception final : public std::exception
+	{
+		char const *what() const noexcept override { return "alignment cancelled"; }
+	};
+	
+	
+	// Stop the alignment if it would not finish within statement_timeout.
+	// Since we cannot know how long the statement has already taken, the timeout
+	// is measured from the start of the alignment.
+	template <typename t_aligner>
+	void set_deadline(t_aligner &aligner)
+	{
+		if (0 < StatementTimeout)
+			aligner.set_deadline(t_aligner::clock_type::now() + std::chrono::milliseconds(StatementTimeout));
+	}
+	
+	
+	template <typename t_aligner>
+	void check_finished(t_aligner const &aligner)
+	{
+		if (text_align::smith_waterman::aligner_base::STATUS_FINISHED != aligner.status())
+			throw alignment_cancelled_exception();
+	}
+	
+	
 	template <typename t_aligner>
 	void assign_scores(t_aligner &aligner, score_type const match, score_type const mismatch, score_type const gap_start, score_type const gap)
 	{
@@ -59,14 +89,126 @@ namespace {
 	}
 	
 	
-	void serialize_to_json(alignment_rle_context_type const &ctx, std::ostringstream &os)
+	void serialize_to_json(alignment_rle_context_type const &ctx, text_align::json::writer &writer)
+	{
+		writer.write("{\"left\":");
+		text_align::json::to_json(writer, ctx.lhs_gaps());
+		writer.write(",\"right\":");
+		text_align::json::to_json(writer, ctx.rhs_gaps());
+		writer.put('}');
+	}
+	
+	
+	bytea *copy_to_bytea(text_align::binary::buffer_type const &buffer)
+	{
+		auto *retval(static_cast <bytea *>(palloc(VARHDRSZ + buffer.size())));
+		SET_VARSIZE(retval, VARHDRSZ + buffer.size());
+		std::copy(buffer.begin(), buffer.end(), reinterpret_cast <std::uint8_t *>(VARDATA(retval)));
+		return retval;
+	}
+	
+	
+	// Arguments of align_texts and align_texts_binary.
+	struct alignment_arguments
+	{
+		std::string_view	lhs;
+		std::string_view	rhs;
+		score_type			match_score{};
+		score_type			mismatch_penalty{};
+		score_type			gap_start_penalty{};
+		score_type			gap_penalty{};
+		bool				needs_alignment_graph{};
+	};
+	
+	
+	alignment_arguments get_alignment_arguments(FunctionCallInfo fcinfo, char const *graph_argument_name)
+	{
+		if (7 != PG_NARGS())
+		{
+			ereport(ERROR, (
+				errcode(ERRCODE_PROTOCOL_VIOLATION),
+				errmsg("expected seven arguments: lhs, rhs, match_score, mismatch_penalty, gap_start_penalty, gap_penalty, %s", graph_argument_name)
+			));
+		}
+		
+		alignment_arguments retval;
+		make_string_view(PG_GETARG_TEXT_P(0), retval.lhs);
+		make_string_view(PG_GETARG_TEXT_P(1), retval.rhs);
+		retval.match_score = PG_GETARG_INT32(2);
+		retval.mismatch_penalty = PG_GETARG_INT32(3);
+		retval.gap_start_penalty = PG_GETARG_INT32(4);
+		retval.gap_penalty = PG_GETARG_INT32(5);
+		retval.needs_alignment_graph = PG_GETARG_BOOL(6);
+		return retval;
+	}
+	
+	
+	// Align the texts and pass the code point ranges and the context to graph_fn if the alignment graph
+	// is needed, to runs_fn otherwise. The former gets bit vectors, the latter run-length encoded ones.
+	template <typename t_graph_fn, typename t_runs_fn>
+	void align_and_serialize(alignment_arguments const &args, t_graph_fn &&graph_fn, t_runs_fn &&runs_fn)
 	{
-		// Write JSON directly to os.
-		os << "{\"left\":";
-		text_align::json::to_json(os, ctx.lhs_gaps());
-		os << ",\"right\":";
-		text_align::json::to_json(os, ctx.rhs_gaps());
-		os << "}";
+		namespace ta = text_align;
+		
+		// Create iterator ranges out of the UTF-8 strings.
+		auto const lhsr(ta::make_reversed_code_point_range(ranges::view::reverse(args.lhs)));
+		auto const rhsr(ta::make_reversed_code_point_range(ranges::view::reverse(args.rhs)));
+		auto const lhs_len(copy_distance(lhsr));
+		auto const rhs_len(copy_distance(rhsr));
+		
+		auto const align([&](auto &ctx){
+			auto &aligner(ctx.get_aligner());
+			assign_scores(aligner, args.match_score, args.mismatch_penalty, args.gap_start_penalty, args.gap_penalty);
+			set_deadline(aligner);
+			aligner.align(lhsr, rhsr, lhs_len, rhs_len);
+			ctx.run();
+			check_finished(aligner);
+		});
+		
+		if (args.needs_alignment_graph)
+		{
+			alignment_bv_context_type ctx;
+			align(ctx);
+			graph_fn(lhsr, rhsr, ctx);
+		}
+		else
+		{
+			alignment_rle_context_type ctx;
+			align(ctx);
+			runs_fn(ctx);
+		}
+	}
+	
+	
+	// Call fn and report anything thrown as a PostgreSQL error, so that nothing is leaked.
+	template <typename t_fn>
+	Datum report_exceptions(FunctionCallInfo fcinfo, t_fn &&fn)
+	{
+		try
+		{
+			return fn();
+		}
+		catch (alignment_cancelled_exception const &)
+		{
+			ereport(ERROR, (
+				errcode(ERRCODE_QUERY_CANCELED),
+				errmsg("canceling alignment due to statement timeout")
+			));
+		}
+		catch (std::exception const &exc)
+		{
+			ereport(ERROR, (
+				errmsg("caught an exception: %s", exc.what())
+			));
+		}
+		catch (...)
+		{
+			ereport(ERROR, (
+				errmsg("caught an unknown exception")
+			));
+		}
+		
+		PG_RETURN_NULL();
 	}
 }
 
@@ -78,76 +220,117 @@ extern "C" {
 	PG_FUNCTION_INFO_V1(align_texts);
 	Datum align_texts(PG_FUNCTION_ARGS)
 	{
-		namespace lb = libbio;
+		namespace ta = text_align;
+		
+		auto const args(get_alignment_arguments(fcinfo, "should_return_alignment_graph"));
+		return report_exceptions(fcinfo, [&]{
+			// Buffer for the return value.
+			ta::json::writer writer;
+			align_and_serialize(
+				args,
+				[&writer](auto const &lhsr, auto const &rhsr, alignment_bv_context_type &ctx){
+					// Build the alignment graph and serialize it to JSON.
+					ta::alignment_graph_builder <char32_t> builder;
+					builder.build_graph(lhsr, rhsr, ctx.lhs_gaps(), ctx.rhs_gaps());
+					ta::json::to_json(writer, builder.text_segments());
+				},
+				[&writer](alignment_rle_context_type &ctx){
+					serialize_to_json(ctx, writer);
+				}
+			);
+			
+			// Copy the buffer only once, to memory allocated by PostgreSQL.
+			PG_RETURN_TEXT_P(cstring_to_text_with_len(writer.data(), writer.size()));
+		});
+	}
+	
+	
+	// Same as align_texts but return the alignment in the binary format of binary_serialize.hh.
+	// The graph section contains offsets to the texts in code points.
+	PG_FUNCTION_INFO_V1(align_texts_binary);
+	Datum align_texts_binary(PG_FUNCTION_ARGS)
+	{
+		namespace ta = text_align;
+		
+		auto const args(get_alignment_arguments(fcinfo, "should_include_alignment_graph"));
+		return report_exceptions(fcinfo, [&]{
+			// Buffer for the return value.
+			ta::binary::buffer_type buffer;
+			align_and_serialize(
+				args,
+				[&buffer](auto const &lhsr, auto const &rhsr, alignment_bv_context_type &ctx){
+					// Build the alignment graph without copying the characters.
+					ta::flat_alignment_graph_builder builder;
+					builder.build_graph(lhsr, rhsr, ctx.lhs_gaps(), ctx.rhs_gaps());
+					
+					std::int64_t const score(ctx.get_aligner().alignment_score());
+					ta::binary::encode(buffer, ctx.lhs_gaps(), ctx.rhs_gaps(), &score, &builder.segments());
+				},
+				[&buffer](alignment_rle_context_type &ctx){
+					std::int64_t const score(ctx.get_aligner().alignment_score());
+					ta::binary::encode(buffer, ctx.lhs_gaps(), ctx.rhs_gaps(), &score);
+				}
+			);
+			
+			PG_RETURN_BYTEA_P(copy_to_bytea(buffer));
+		});
+	}
+	
+	
+	// Return an upper bound for the score that align_texts would return, computed in linear time
+	// from the q-gram profiles of the texts. Pairs whose bound is below a threshold need not be aligned.
+	PG_FUNCTION_INFO_V1(align_texts_score_upper_bound);
+	Datum align_texts_score_upper_bound(PG_FUNCTION_ARGS)
+	{
 		namespace ta = text_align;
 		
 		if (7 != PG_NARGS())
 		{
 			ereport(ERROR, (
 				errcode(ERRCODE_PROTOCOL_VIOLATION),
-				errmsg("expected seven arguments: lhs, rhs, match_score, mismatch_penalty, gap_start_penalty, gap_penalty, should_return_alignment_graph")
+				errmsg("expected seven arguments: lhs, rhs, match_score, mismatch_penalty, gap_start_penalty, gap_penalty, qgram_length")
 			));
 		}
-
+		
 		auto const *lhs(PG_GETARG_TEXT_P(0));
 		auto const *rhs(PG_GETARG_TEXT_P(1));
 		auto const match_score(PG_GETARG_INT32(2));
 		auto const mismatch_penalty(PG_GETARG_INT32(3));
 		auto const gap_start_penalty(PG_GETARG_INT32(4));
 		auto const gap_penalty(PG_GETARG_INT32(5));
-		auto const should_return_alignment_graph(PG_GETARG_BOOL(6));
-
+		auto const qgram_length(PG_GETARG_INT32(6));
+		
+		if (qgram_length <= 0)
+		{
+			ereport(ERROR, (
+				errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				errmsg("qgram_length must be positive")
+			));
+		}
+		
 		// Don’t leak anything thrown.
 		try
 		{
-			// Create iterator ranges out of the UTF-8 strings.
 			std::string_view lhsv, rhsv;
 			make_string_view(lhs, lhsv);
 			make_string_view(rhs, rhsv);
-			auto const lhsr(ta::make_reversed_code_point_range(ranges::view::reverse(lhsv)));
-			auto const rhsr(ta::make_reversed_code_point_range(ranges::view::reverse(rhsv)));
-			auto const lhs_len(copy_distance(lhsr));
-			auto const rhs_len(copy_distance(rhsr));
 			
-			// Buffer for the return value.
-			std::ostringstream os;
-			
-			if (should_return_alignment_graph)
-			{
-				// Instantiate the aligner.
-				alignment_bv_context_type ctx;
-				auto &aligner(ctx.get_aligner());
-				assign_scores(aligner, match_score, mismatch_penalty, gap_start_penalty, gap_penalty);
-				//aligner.set_prints_debugging_information(print_debugging_information);
-			
-				// Align the texts.
-				aligner.align(lhsr, rhsr, lhs_len, rhs_len);
-				ctx.run();
-			
-				// Build the alignment graph.
-				ta::alignment_graph_builder <char32_t> builder;
-				builder.build_graph(lhsr, rhsr, ctx.lhs_gaps(), ctx.rhs_gaps());
-			
-				// Serialize to JSON.
-				ta::json::to_json(os, builder.text_segments());
-			}
-			else
-			{
-				// Instantiate the aligner.
-				alignment_rle_context_type ctx;
-				auto &aligner(ctx.get_aligner());
-				assign_scores(aligner, match_score, mismatch_penalty, gap_start_penalty, gap_penalty);
-				
-				// Align the texts.
-				aligner.align(lhsr, rhsr, lhs_len, rhs_len);
-				ctx.run();
-				
-				// Serialize to JSON.
-				serialize_to_json(ctx, os);
-			}
+			ta::qgram_profile const lhs_profile(ta::make_code_point_range(lhsv), qgram_length);
+			ta::qgram_profile const rhs_profile(ta::make_code_point_range(rhsv), qgram_length);
+			auto const lhs_len(lhs_profile.text_length());
+			auto const rhs_len(rhs_profile.text_length());
+			auto const min_edits(ta::edit_distance_lower_bound(lhs_len, rhs_len, lhs_profile.count_common(rhs_profile), qgram_length));
+			auto const bound(ta::alignment_score_upper_bound <score_type>(
+				lhs_len,
+				rhs_len,
+				min_edits,
+				match_score,
+				mismatch_penalty,
+				gap_start_penalty,
+				gap_penalty
+			));
 			
-			std::string const &json_buffer(os.str());
-			PG_RETURN_TEXT_P(cstring_to_text_with_len(json_buffer.data(), json_buffer.size()));
+			PG_RETURN_INT32(bound);
 		}
 		catch (std::exception const &exc)
 		{
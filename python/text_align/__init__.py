@@ -1,5 +1,5 @@
 # Copyright (c) 2018-2019 Tuukka Norri
 # This code is licensed under MIT license (see LICENSE for details).
 
-from .aligner import SmithWatermanAligner, SmithWatermanScoringFpAligner
+from .aligner import AlignmentCancelledError, SmithWatermanAligner, SmithWatermanScoringFpAligner, decode_binary, intern_tokens
 from .alignment_graph_node import NodeType as AlignmentGraphNodeType
@@ -14,9 +14,12 @@ from libcpp.pair cimport pair
 from libcpp.vector cimport vector
 from . cimport interface as cxx
 from .alignment_context cimport alignment_context_base, alignment_context, scoring_fp_alignment_context
-from .alignment_graph_node import CommonNode, DistinctNode
+from .alignment_graph_node import CommonNode, DistinctNode, NodeType
+from .binary_format cimport encode_alignment
 from .cast_bit_vector cimport cast #to_rle_bit_vector
-from .run_aligner cimport run_aligner, run_builder, process_alignment_graph
+from .interface.alignment_graph_builder cimport COMMON as NODE_TYPE_COMMON
+from .run_aligner cimport run_aligner, run_builder, process_alignment_graph, qgram_score_upper_bound
+from .tokenize cimport intern_tokens as intern_tokens_
 
 include "char32_t.pxi"
 
@@ -30,6 +33,57 @@ cdef public void handle_distinct_node(object dst, object lhs, object rhs):
 	dst.append(node)
 
 
+class AlignmentCancelledError(RuntimeError):
+	"""Raised when an alignment did not finish within the timeout."""
+	pass
+
+
+cdef convert_gap_runs(const cxx.gap_run_buffer &buffer):
+	# Same form as returned by make_lhs_runs and make_rhs_runs.
+	retval = []
+	starts_with_zero = True
+	cdef size_t i = 0
+	cdef const vector[cxx.gap_run] *runs = &buffer.runs()
+	while i < deref(runs).size():
+		if 0 == i:
+			starts_with_zero = not deref(runs)[i].flag
+		retval.append(deref(runs)[i].length)
+		inc(i)
+	return starts_with_zero, retval
+
+
+def decode_binary(const uint8_t[:] data not None):
+	"""Decode an alignment encoded with encode_binary. Return a dict with lhs_gaps, rhs_gaps,
+	   score (or None) and segments (or None) as (type, lhs_offset, lhs_length, rhs_offset, rhs_length)."""
+	cdef cxx.alignment_record record
+	if 0 < data.shape[0]:
+		cxx.decode(&data[0], data.shape[0], record)
+	else:
+		cxx.decode(NULL, 0, record)
+	
+	retval = {
+		"lhs_gaps": convert_gap_runs(record.lhs_gaps),
+		"rhs_gaps": convert_gap_runs(record.rhs_gaps),
+		"score": record.score if record.has_score() else None,
+		"segments": None
+	}
+	
+	if record.has_graph():
+		segments = []
+		for segment in record.segments:
+			segment_type = NodeType.COMMON if NODE_TYPE_COMMON == segment.type else NodeType.DISTINCT
+			segments.append((segment_type, segment.lhs_offset, segment.lhs_length, segment.rhs_offset, segment.rhs_length))
+		retval["segments"] = segments
+	
+	return retval
+
+
+def intern_tokens(lhs, rhs, by_lines=False):
+	"""Split the strings to words, whitespace and punctuation (or to lines) and return two lists of
+	   token identifiers that may be passed to the aligners. Equal tokens get equal identifiers."""
+	return intern_tokens_(lhs, rhs, by_lines)
+
+
 cdef class Aligner(object):
 	
 	cdef object lhs
@@ -145,6 +199,19 @@ cdef class SmithWatermanAlignerBase(Aligner):
 		if not self.has_bit_vectors:
 			raise RuntimeError("Bit vectors not initialized")
 	
+	def check_cancelled(self):
+		if deref(self.get_context()).was_cancelled():
+			raise AlignmentCancelledError("Alignment was cancelled")
+	
+	@property
+	def timeout(self):
+		"""Timeout in milliseconds, zero for none."""
+		return deref(self.get_context()).timeout()
+	
+	@timeout.setter
+	def timeout(self, milliseconds):
+		deref(self.get_context()).set_timeout(milliseconds)
+	
 	def make_lhs_runs(self):
 		"""Return the alignment as a list of runs."""
 		cdef cast[uint32_t] c
@@ -173,6 +240,25 @@ cdef class SmithWatermanAligner(SmithWatermanAlignerBase):
 		"""Align self.lhs and self.rhs."""
 		self.check_bit_vectors()
 		run_aligner(deref(self.ctx), self.lhs, self.rhs)
+		self.check_cancelled()
+	
+	def score_upper_bound(self, qgram_length = 3):
+		"""Return an upper bound for the alignment score of self.lhs and self.rhs computed in linear time from their q-gram profiles."""
+		return qgram_score_upper_bound(deref(self.ctx), self.lhs, self.rhs, qgram_length)
+	
+	def align_if_above(self, min_score, qgram_length = 3):
+		"""Align self.lhs and self.rhs unless the score would be less than min_score. Return True if aligned.
+		   The q-gram bound is checked first; the blocks through which min_score cannot be reached are not filled."""
+		if self.score_upper_bound(qgram_length) < min_score:
+			return False
+		self.check_bit_vectors()
+		deref(self.ctx).get_aligner().set_min_score(min_score)
+		try:
+			run_aligner(deref(self.ctx), self.lhs, self.rhs)
+		finally:
+			deref(self.ctx).get_aligner().clear_min_score()
+		self.check_cancelled()
+		return not deref(self.ctx).was_below_threshold()
 	
 	def make_alignment_graph(self):
 		"""Return the alignment as a graph."""
@@ -183,6 +269,10 @@ cdef class SmithWatermanAligner(SmithWatermanAlignerBase):
 		process_alignment_graph(deref(builder), retval)
 		return retval
 	
+	def encode_binary(self, include_graph = False):
+		"""Return the alignment in the binary format, optionally with the alignment graph."""
+		return encode_alignment(deref(self.ctx), self.lhs, self.rhs, include_graph)
+	
 	def setup_bit_vectors(self):
 		"""Use bit vectors for gaps."""
 		self.has_bit_vectors = True
@@ -253,6 +343,15 @@ cdef class SmithWatermanAligner(SmithWatermanAlignerBase):
 	def prints_debugging_information(self, should_print):
 		deref(self.ctx).get_aligner().set_prints_debugging_information(should_print)
 	
+	@property
+	def trims_common_affixes(self):
+		"""Align only the part of the texts after the common prefix and before the common suffix."""
+		return deref(self.ctx).get_aligner().trims_common_affixes()
+	
+	@trims_common_affixes.setter
+	def trims_common_affixes(self, should_trim):
+		deref(self.ctx).get_aligner().set_trims_common_affixes(should_trim)
+	
 	@property
 	def alignment_score(self):
 		return deref(self.ctx).get_aligner().alignment_score()
@@ -295,6 +394,7 @@ cdef class SmithWatermanScoringFpAligner(SmithWatermanAlignerBase):
 		"""Align self.lhs and self.rhs."""
 		self.check_bit_vectors()
 		run_aligner(deref(self.ctx), self.lhs, self.rhs)
+		self.check_cancelled()
 	
 	def make_alignment_graph(self):
 		"""Return the alignment as a graph."""
@@ -305,6 +405,10 @@ cdef class SmithWatermanScoringFpAligner(SmithWatermanAlignerBase):
 		process_alignment_graph(deref(builder), retval)
 		return retval
 	
+	def encode_binary(self, include_graph = False):
+		"""Return the alignment in the binary format, optionally with the alignment graph."""
+		return encode_alignment(deref(self.ctx), self.lhs, self.rhs, include_graph)
+	
 	def setup_bit_vectors(self):
 		"""Use bit vectors for gaps."""
 		self.has_bit_vectors = True
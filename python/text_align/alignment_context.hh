@@ -41,6 +41,9 @@ namespace text_align { namespace python {
 		boost::asio::io_context						m_ctx;
 		std::unique_ptr <bit_vector_type>			m_lhs_gaps;
 		std::unique_ptr <bit_vector_type>			m_rhs_gaps;
+		std::uint32_t								m_timeout{};		// Milliseconds, zero for none.
+		bool										m_was_cancelled{};
+		bool										m_was_below_threshold{};
 		
 	public:
 		alignment_context_base():
@@ -60,6 +63,11 @@ namespace text_align { namespace python {
 		void restart() { m_ctx.restart(); }
 		bool stopped() const { return m_ctx.stopped(); }
 		
+		std::uint32_t timeout() const { return m_timeout; }
+		void set_timeout(std::uint32_t const timeout) { m_timeout = timeout; }
+		bool was_cancelled() const { return m_was_cancelled; }
+		bool was_below_threshold() const { return m_was_below_threshold; }
+		
 		template <typename t_bv> void instantiate_lhs_gaps() { m_lhs_gaps.reset(new bit_vector_wrapper <word_type, t_bv>); }
 		template <typename t_bv> void instantiate_rhs_gaps() { m_rhs_gaps.reset(new bit_vector_wrapper <word_type, t_bv>); }
 		
@@ -75,7 +83,12 @@ namespace text_align { namespace python {
 		void reverse_gaps() { m_lhs_gaps->reverse(); m_rhs_gaps->reverse(); }
 		
 		// Aligner delegate.
-		void finish(smith_waterman::aligner_base &aligner) { m_ctx.stop(); }
+		void finish(smith_waterman::aligner_base &aligner)
+		{
+			m_was_cancelled = (smith_waterman::aligner_base::STATUS_CANCELLED == aligner.status());
+			m_was_below_threshold = (smith_waterman::aligner_base::STATUS_BELOW_THRESHOLD == aligner.status());
+			m_ctx.stop();
+		}
 	};
 	
 	
@@ -21,6 +21,11 @@ cdef extern from "alignment_context.hh" namespace "text_align::python":
 		void restart() except +
 		bool stopped() except +
 		
+		uint32_t timeout() except +
+		void set_timeout(uint32_t) except +
+		bool was_cancelled() except +
+		bool was_below_threshold() except +
+		
 		const cxx.bit_vector_interface[uint64_t] &lhs_gaps() except +
 		const cxx.bit_vector_interface[uint64_t] &rhs_gaps() except +
 		
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_PYTHON_BINARY_FORMAT_HH
+#define TEXT_ALIGN_PYTHON_BINARY_FORMAT_HH
+
+#include <libbio/map_on_stack.hh>
+#include <Python.h>
+#include <text_align/binary_serialize.hh>
+#include <text_align/flat_alignment_graph.hh>
+#include <type_traits>
+#include "run_aligner.hh"
+
+
+namespace text_align { namespace detail {
+	
+	inline void run_flat_builder(
+		flat_alignment_graph_builder &builder,
+		PyObject *lhso,
+		PyObject *rhso,
+		libbio::bit_vector const &lhs_gaps,
+		libbio::bit_vector const &rhs_gaps
+	)
+	{
+		if (PyList_Check(lhso) && PyList_Check(rhso))
+		{
+			std::vector <long> lhs, rhs;
+			copy_long_list_to_vector(lhso, lhs);
+			copy_long_list_to_vector(rhso, rhs);
+			builder.build_graph(lhs, rhs, lhs_gaps, rhs_gaps);
+		}
+		else if (PyUnicode_Check(lhso) && PyUnicode_Check(rhso))
+		{
+			libbio::map_on_stack_fn <span_from_buffer>(
+				[&builder, &lhs_gaps, &rhs_gaps](auto const &lhss, auto const &rhss) {
+					builder.build_graph(lhss, rhss, lhs_gaps, rhs_gaps);
+				},
+				lhso, rhso
+			);
+		}
+		else
+		{
+			throw std::runtime_error("Unexpected Python object type");
+		}
+	}
+}}
+
+
+namespace text_align {
+	
+	// Encode the alignment in ctx to a bytes object. The score is included only if it is
+	// an integer. The graph section requires bit vectors.
+	template <typename t_aligner_context>
+	PyObject *encode_alignment(t_aligner_context &ctx, PyObject *lhso, PyObject *rhso, bool const should_include_graph)
+	{
+		typedef std::remove_cv_t <decltype(ctx.get_aligner().alignment_score())>	score_type;
+		
+		std::int64_t score(0);
+		std::int64_t const *score_ptr(nullptr);
+		if constexpr (std::is_integral_v <score_type>)
+		{
+			score = ctx.get_aligner().alignment_score();
+			score_ptr = &score;
+		}
+		
+		binary::buffer_type buffer;
+		auto const *lhs_bv(dynamic_cast <libbio::bit_vector const *>(&ctx.lhs_gaps()));
+		auto const *rhs_bv(dynamic_cast <libbio::bit_vector const *>(&ctx.rhs_gaps()));
+		if (lhs_bv && rhs_bv)
+		{
+			if (should_include_graph)
+			{
+				flat_alignment_graph_builder builder;
+				detail::run_flat_builder(builder, lhso, rhso, *lhs_bv, *rhs_bv);
+				binary::encode(buffer, *lhs_bv, *rhs_bv, score_ptr, &builder.segments());
+			}
+			else
+			{
+				binary::encode(buffer, *lhs_bv, *rhs_bv, score_ptr);
+			}
+		}
+		else
+		{
+			if (should_include_graph)
+				throw std::runtime_error("The alignment graph requires bit vectors");
+			
+			typedef libbio::rle_bit_vector <std::uint32_t> rle_type;
+			auto const &lhs_rle(dynamic_cast <rle_type const &>(ctx.lhs_gaps()));
+			auto const &rhs_rle(dynamic_cast <rle_type const &>(ctx.rhs_gaps()));
+			binary::encode(buffer, lhs_rle, rhs_rle, score_ptr);
+		}
+		
+		auto *retval(PyBytes_FromStringAndSize(reinterpret_cast <char const *>(buffer.data()), buffer.size()));
+		if (!retval)
+			throw std::runtime_error("Unable to create a Python bytes object");
+		return retval;
+	}
+}
+
+#endif
@@ -0,0 +1,10 @@
+# Copyright (c) 2019 Tuukka Norri
+# This code is licensed under MIT license (see LICENSE for details).
+
+# cython: language_level=3
+
+from libcpp cimport bool
+
+
+cdef extern from "binary_format.hh" namespace "text_align":
+	cdef object encode_alignment[t_context](t_context &, object, object, bool) except +
@@ -5,6 +5,7 @@
 
 # FIXME: should Cython options be changed in some way so that .interface would not be needed below?
 from .interface.alignment_graph_builder cimport node_type, node_base, alignment_graph_builder
+from .interface.binary_serialize cimport alignment_record, decode, gap_run_buffer
 from .interface.bit_vector_interface cimport bit_vector_interface
 from .interface.int_vector cimport bit_vector, int_vector
 from .interface.rle_bit_vector cimport rle_bit_vector
@@ -0,0 +1,42 @@
+# Copyright (c) 2019 Tuukka Norri
+# This code is licensed under MIT license (see LICENSE for details).
+
+# cython: language_level=3
+
+from libc.stdint cimport int64_t, uint8_t
+from libc.stddef cimport size_t
+from libcpp cimport bool
+from libcpp.vector cimport vector
+from .alignment_graph_builder cimport node_type
+
+
+cdef extern from "<text_align/gap_run_buffer.hh>" namespace "text_align":
+	cdef cppclass gap_run:
+		size_t length
+		bool flag
+	
+	cdef cppclass gap_run_buffer:
+		size_t size() except +
+		const vector[gap_run] &runs() except +
+
+
+cdef extern from "<text_align/flat_alignment_graph.hh>" namespace "text_align::alignment_graph":
+	cdef cppclass flat_segment:
+		size_t lhs_offset
+		size_t lhs_length
+		size_t rhs_offset
+		size_t rhs_length
+		node_type type
+
+
+cdef extern from "<text_align/binary_serialize.hh>" namespace "text_align::binary":
+	cdef cppclass alignment_record:
+		gap_run_buffer lhs_gaps
+		gap_run_buffer rhs_gaps
+		vector[flat_segment] segments
+		int64_t score
+		
+		bool has_score() except +
+		bool has_graph() except +
+	
+	void decode(const uint8_t *, size_t, alignment_record &) except +
@@ -21,6 +21,9 @@ cdef extern from "<text_align/smith_waterman/aligner.hh>" namespace "text_align:
 		t_score gap_start_penalty()
 		uint32_t segment_length()
 		bool prints_debugging_information()
+		bool trims_common_affixes()
+		bool has_min_score()
+		t_score min_score()
 		
 		void set_identity_score(t_score const)
 		void set_mismatch_penalty(t_score const)
@@ -29,6 +32,9 @@ cdef extern from "<text_align/smith_waterman/aligner.hh>" namespace "text_align:
 		void set_segment_length(uint32_t const)
 		void set_prints_debugging_information(bool const)
 		void set_prints_values_converted_to_utf8(bool const)
+		void set_trims_common_affixes(bool const)
+		void set_min_score(t_score const)
+		void clear_min_score()
 		
 		void align[t_string](const t_string &, const t_string &)
 		
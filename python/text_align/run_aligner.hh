@@ -140,6 +140,13 @@ namespace text_align { namespace detail {
 		// Reverse the texts in order to align gaps to the right.
 		auto &aligner(ctx.get_aligner());
 		aligner.set_reverses_texts(true);
+		
+		// Measure the timeout from the start of the alignment.
+		if (ctx.timeout())
+			aligner.set_deadline(std::chrono::steady_clock::now() + std::chrono::milliseconds(ctx.timeout()));
+		else
+			aligner.clear_deadline();
+		
 		aligner.align(ranges::view::reverse(lhs), ranges::view::reverse(rhs));
 		
 		ctx.run();
@@ -203,6 +210,36 @@ namespace text_align
 	}
 	
 	
+	template <typename t_aligner_context>
+	auto qgram_score_upper_bound(t_aligner_context &ctx, PyObject *lhso, PyObject *rhso, std::size_t const qgram_length)
+	{
+		auto const &aligner(ctx.get_aligner());
+		if (PyList_Check(lhso) && PyList_Check(rhso))
+		{
+			std::vector <long> lhs, rhs;
+			detail::copy_long_list_to_vector(lhso, lhs);
+			detail::copy_long_list_to_vector(rhso, rhs);
+			return aligner.qgram_score_upper_bound(lhs, rhs, qgram_length);
+		}
+		else if (PyUnicode_Check(lhso) && PyUnicode_Check(rhso))
+		{
+			typedef std::remove_cv_t <decltype(aligner.alignment_score())> score_type;
+			score_type retval{};
+			libbio::map_on_stack_fn <detail::span_from_buffer>(
+				[&aligner, &retval, qgram_length](auto const &lhss, auto const &rhss) {
+					retval = aligner.qgram_score_upper_bound(lhss, rhss, qgram_length);
+				},
+				lhso, rhso
+			);
+			return retval;
+		}
+		else
+		{
+			throw std::runtime_error("Unexpected Python object type");
+		}
+	}
+	
+	
 	template <typename t_character, typename t_aligner_context>
 	void run_builder(alignment_graph_builder <t_character> &builder, t_aligner_context &ctx, PyObject *lhso, PyObject *rhso)
 	{
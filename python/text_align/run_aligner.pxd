@@ -4,9 +4,12 @@
 # cython: language_level=3
 
 from . cimport interface as cxx
+from libc.stddef cimport size_t
+from libc.stdint cimport int32_t
 
 
 cdef extern from "run_aligner.hh" namespace "text_align":
 	cdef void run_aligner[t_context](t_context &, object, object) except +
+	cdef int32_t qgram_score_upper_bound[t_context](t_context &, object, object, size_t) except +
 	cdef void run_builder[t_character, t_aligner](cxx.alignment_graph_builder[t_character] &, const t_aligner &, object, object) except +
 	cdef void process_alignment_graph[t_character](cxx.alignment_graph_builder[t_character] &, object) except +
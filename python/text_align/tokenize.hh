@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2019 Tuukka Norri
+ * This code is licensed under MIT license (see LICENSE for details).
+ */
+
+#ifndef TEXT_ALIGN_PYTHON_TOKENIZE_HH
+#define TEXT_ALIGN_PYTHON_TOKENIZE_HH
+
+#include <libbio/map_on_stack.hh>
+#include <Python.h>
+#include <text_align/tokenizer.hh>
+#include "py_object_ptr.hh"
+#include "run_aligner.hh"
+
+
+namespace text_align { namespace detail {
+	
+	inline PyObject *copy_token_vector_to_list(std::vector <token_id_type> const &src)
+	{
+		auto *retval(PyList_New(src.size()));
+		if (!retval)
+			throw std::runtime_error("Unable to create a Python list");
+		
+		for (std::size_t i(0), count(src.size()); i < count; ++i)
+		{
+			auto *pyval(PyLong_FromUnsignedLong(src[i]));
+			if (!pyval)
+			{
+				Py_DECREF(retval);
+				throw std::runtime_error("Unable to create a Python long");
+			}
+			
+			PyList_SET_ITEM(retval, i, pyval); // Steals a reference to pyval.
+		}
+		
+		return retval;
+	}
+}}
+
+
+namespace text_align {
+	
+	// Split the strings to lines or to words, whitespace and punctuation and return a tuple
+	// of two lists of token identifiers. Equal tokens in either string get the same identifier.
+	inline PyObject *intern_tokens(PyObject *lhso, PyObject *rhso, bool const by_lines)
+	{
+		if (! (PyUnicode_Check(lhso) && PyUnicode_Check(rhso)))
+			throw std::runtime_error("Unexpected Python object type");
+		
+		std::vector <char32_t> lhs, rhs;
+		libbio::map_on_stack_fn <detail::span_from_buffer>(
+			[&lhs, &rhs](auto const &lhss, auto const &rhss) {
+				lhs.assign(lhss.begin(), lhss.end());
+				rhs.assign(rhss.begin(), rhss.end());
+			},
+			lhso, rhso
+		);
+		
+		token_interner <char32_t> interner;
+		std::vector <token_id_type> lhs_tokens, rhs_tokens;
+		std::vector <std::size_t> offsets;
+		auto const tokenize([&](std::vector <char32_t> const &text, std::vector <token_id_type> &dst){
+			if (by_lines)
+				tokenize_lines(text, interner, dst, offsets);
+			else
+				tokenize_words(text, interner, dst, offsets);
+		});
+		tokenize(lhs, lhs_tokens);
+		tokenize(rhs, rhs_tokens);
+		
+		py_object_ptr lhs_list(detail::copy_token_vector_to_list(lhs_tokens));
+		py_object_ptr rhs_list(detail::copy_token_vector_to_list(rhs_tokens));
+		auto *retval(PyTuple_Pack(2, lhs_list.get(), rhs_list.get())); // Increments the reference counts.
+		if (!retval)
+			throw std::runtime_error("Unable to create a Python tuple");
+		return retval;
+	}
+}
+
+#endif
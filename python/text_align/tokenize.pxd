@@ -0,0 +1,10 @@
+# Copyright (c) 2019 Tuukka Norri
+# This code is licensed under MIT license (see LICENSE for details).
+
+# cython: language_level=3
+
+from libcpp cimport bool
+
+
+cdef extern from "tokenize.hh" namespace "text_align":
+	cdef object intern_tokens(object, object, bool) except +
@@ -11,15 +11,33 @@
 #endif
 #include <boost/test/unit_test.hpp>
 
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
 #include <libbio/int_vector.hh>
+#include <sstream>
 #include <text_align/alignment_graph_builder.hh>
+#include <text_align/binary_serialize.hh>
 #include <text_align/code_point_range.hh>
+#include <text_align/flat_alignment_graph.hh>
+#include <text_align/gap_run_buffer.hh>
+#include <text_align/gap_runs.hh>
+#include <text_align/json_serialize.hh>
+#include <text_align/json_writer.hh>
+#include <text_align/multiple_alignment_graph_builder.hh>
+#include <text_align/qgram_filter.hh>
 #include <text_align/smith_waterman/aligner.hh>
 #include <text_align/smith_waterman/alignment_context.hh>
+#include <text_align/smith_waterman/all_pairs_aligner.hh>
+#include <text_align/smith_waterman/one_to_many_aligner.hh>
+#include <text_align/smith_waterman/partial_order_aligner.hh>
+#include <text_align/smith_waterman/piecewise_aligner.hh>
+#include <text_align/smith_waterman/progressive_aligner.hh>
 
+#include <thread>
 #include <tuple>
 #include <type_traits>
+#include <unistd.h>
 
 
 namespace ta = text_align;
@@ -32,19 +50,111 @@ template <typename t_block>
 using alignment_context_type = text_align::smith_waterman::alignment_context <score_type, t_block, libbio::bit_vector>;
 
 
+static std::string temporary_directory()
+{
+	auto const *tmpdir(std::getenv("TMPDIR"));
+	return std::string(tmpdir && *tmpdir ? tmpdir : "/tmp");
+}
+
+
+// Create an empty file with a unique name for the test to overwrite.
+static std::string make_temporary_file()
+{
+	std::string path(temporary_directory() + "/text_align_test.XXXXXX");
+	auto const fd(::mkstemp(path.data()));
+	BOOST_REQUIRE(-1 != fd);
+	::close(fd);
+	return path;
+}
+
+
+static std::string make_temporary_directory()
+{
+	std::string path(temporary_directory() + "/text_align_test.XXXXXX");
+	BOOST_REQUIRE(nullptr != ::mkdtemp(path.data()));
+	return path;
+}
+
+
+// Record the progress reports and the gaps.
+class progress_context final : public ta::smith_waterman::alignment_context_tpl <progress_context, score_type, std::uint16_t>
+{
+protected:
+	typedef ta::smith_waterman::alignment_context_tpl <progress_context, score_type, std::uint16_t>	superclass;
+	friend superclass::aligner_type;
+
+public:
+	std::vector <std::pair <std::size_t, std::size_t>>	block_progress;
+	std::vector <std::pair <std::size_t, std::size_t>>	traceback_progress;
+	libbio::bit_vector									lhs_gaps;
+	libbio::bit_vector									rhs_gaps;
+	std::size_t											calculated_scores{};	// When filling the blocks initially.
+	std::size_t											recalculated_scores{};	// When filling the blocks for the traceback.
+
+public:
+	using superclass::superclass;
+	
+	static constexpr bool uses_scoring_function() { return false; }
+	
+	void did_fill_block(ta::smith_waterman::aligner_base &, std::size_t filled, std::size_t total) { block_progress.emplace_back(filled, total); }
+	void did_advance_traceback(ta::smith_waterman::aligner_base &, std::size_t processed, std::size_t total) { traceback_progress.emplace_back(processed, total); }
+	
+	void did_calculate_score(ta::smith_waterman::aligner_base &, std::size_t, std::size_t, ta::smith_waterman::detail::score_result <score_type> const &, bool initial)
+	{
+		if (initial)
+			++calculated_scores;
+		else
+			++recalculated_scores;
+	}
+
+protected:
+	void push_lhs(bool flag, std::size_t count) { lhs_gaps.push_back(flag, count); }
+	void push_rhs(bool flag, std::size_t count) { rhs_gaps.push_back(flag, count); }
+	void clear_gaps() { lhs_gaps.clear(); rhs_gaps.clear(); }
+	void reverse_gaps() { lhs_gaps.reverse(); rhs_gaps.reverse(); }
+};
+
+
+// Collect the gaps from piecewise_aligner.
+struct piecewise_delegate
+{
+	libbio::bit_vector	lhs_gaps;
+	libbio::bit_vector	rhs_gaps;
+	bool				did_finish{};
+	
+	void push_lhs(bool flag, std::size_t count) { lhs_gaps.push_back(flag, count); }
+	void push_rhs(bool flag, std::size_t count) { rhs_gaps.push_back(flag, count); }
+	void clear_gaps() { lhs_gaps.clear(); rhs_gaps.clear(); did_finish = false; }
+	void finish(ta::smith_waterman::aligner_base &) { did_finish = true; }
+};
+
+
+// Collect the results from one_to_many_aligner.
+struct one_to_many_delegate
+{
+	typedef ta::smith_waterman::alignment_result <score_type, libbio::bit_vector>	result_type;
+	
+	std::vector <std::pair <std::size_t, result_type>>	results;
+	bool												did_finish{};
+	
+	void did_align_candidate(ta::smith_waterman::aligner_base &, std::size_t idx, result_type &&result) { results.emplace_back(idx, std::move(result)); }
+	void finish(ta::smith_waterman::aligner_base &) { did_finish = true; }
+};
+
+
 template <typename t_range>
 std::size_t copy_distance(t_range range)
 {
 	return ranges::distance(range);
 }
 
-template <typename t_block>
+template <typename t_context>
 void run_aligner(
-	alignment_context_type <t_block> &ctx,
+	t_context &ctx,
 	std::string const &lhs,
 	std::string const &rhs,
-	typename alignment_context_type <t_block>::bit_vector_type const &expected_lhs,
-	typename alignment_context_type <t_block>::bit_vector_type const &expected_rhs,
+	typename t_context::bit_vector_type const &expected_lhs,
+	typename t_context::bit_vector_type const &expected_rhs,
 	score_type const expected_score,
 	std::size_t const block_size,
 	score_type const match_score,
@@ -143,6 +253,453 @@ BOOST_AUTO_TEST_CASE(test_aligner_2_8)
 }
 
 
+BOOST_AUTO_TEST_CASE(test_aligner_traceback_both_directions)
+{
+	// The optimal alignment is unique, so the traceback stored in the blocks must reproduce it
+	// regardless of how the gaps fall on the block boundaries.
+	typedef alignment_context_type <std::uint16_t> alignment_context;
+	typedef typename alignment_context::bit_vector_type bit_vector;
+	
+	bit_vector lhs(25, 0x0);
+	bit_vector rhs(25, 0x0);
+	*lhs.word_begin() = 0x1c000;
+	*rhs.word_begin() = 0x300;
+	for (std::size_t const block_size : {3, 4, 8, 32})
+	{
+		alignment_context ctx;
+		run_aligner(ctx, "abcdefgh12ijklmnopqrst", "abcdefghijkl345mnopqrst", lhs, rhs, 31, block_size, 2, -2, -2, -1);
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE(test_qgram_score_upper_bound)
+{
+	typedef alignment_context_type <std::uint16_t> alignment_context;
+	
+	alignment_context ctx;
+	auto &aligner(ctx.get_aligner());
+	aligner.set_identity_score(2);
+	aligner.set_mismatch_penalty(-2);
+	aligner.set_gap_start_penalty(-2);
+	aligner.set_gap_penalty(-1);
+	
+	// The optimal score is 10 (see test_aligner_2_8).
+	std::string const lhs("xaasdxaasd");
+	std::string const rhs("xasdxasd");
+	BOOST_TEST(aligner.qgram_score_upper_bound(lhs, lhs, 2) == 20);
+	BOOST_TEST(aligner.qgram_score_upper_bound(lhs, rhs, 2) == 12);
+	
+	// No common q-grams.
+	std::string const unrelated("abcdefghijklmnopqrstuvwxyz");
+	std::string const reversed(unrelated.rbegin(), unrelated.rend());
+	BOOST_TEST(aligner.qgram_score_upper_bound(unrelated, reversed, 3) == 2 * 22 - 8);
+}
+
+
+BOOST_AUTO_TEST_CASE(test_aligner_min_score)
+{
+	typedef alignment_context_type <std::uint16_t> alignment_context;
+	typedef typename alignment_context::bit_vector_type bit_vector;
+	
+	{
+		// The optimal score is 10 (see test_aligner_2_8). Some of the blocks are skipped
+		// but the alignment should not change.
+		bit_vector const lhs(10, 0x0);
+		bit_vector rhs(10, 0x0);
+		*rhs.word_begin() = 0x84;
+		alignment_context ctx;
+		ctx.get_aligner().set_min_score(10);
+		run_aligner(ctx, "xaasdxaasd", "xasdxasd", lhs, rhs, 10, 2, 2, -2, -2, -1);
+		BOOST_TEST(ctx.get_aligner().status() == ta::smith_waterman::aligner_base::STATUS_FINISHED);
+	}
+	
+	{
+		bit_vector const lhs;
+		bit_vector const rhs;
+		alignment_context ctx;
+		ctx.get_aligner().set_min_score(11);
+		run_aligner(ctx, "xaasdxaasd", "xasdxasd", lhs, rhs, 0, 2, 2, -2, -2, -1);
+		BOOST_TEST(ctx.get_aligner().status() == ta::smith_waterman::aligner_base::STATUS_BELOW_THRESHOLD);
+	}
+	
+	{
+		// Check that some of the blocks were skipped by counting the calculated scores.
+		auto const count_scores([](bool const has_min_score){
+			progress_context ctx;
+			auto &aligner(ctx.get_aligner());
+			aligner.set_segment_length(2);
+			aligner.set_identity_score(2);
+			aligner.set_mismatch_penalty(-2);
+			aligner.set_gap_start_penalty(-2);
+			aligner.set_gap_penalty(-1);
+			if (has_min_score)
+				aligner.set_min_score(12);
+			
+			// No common prefix or suffix, so the texts are not trimmed. The optimal alignment
+			// follows the diagonal, and the blocks far from it cannot reach the minimum score.
+			std::string const lhs("pabcdefghq");
+			std::string const rhs("rabcdefghs");
+			aligner.align(lhs, rhs);
+			ctx.run();
+			BOOST_TEST(aligner.status() == ta::smith_waterman::aligner_base::STATUS_FINISHED);
+			BOOST_TEST(aligner.alignment_score() == 12);
+			return ctx.calculated_scores;
+		});
+		
+		auto const all_scores(count_scores(false));
+		BOOST_TEST(all_scores == 10 * 10);
+		BOOST_TEST(count_scores(true) < all_scores);
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE(test_aligner_mapped_samples)
+{
+	typedef alignment_context_type <std::uint16_t> alignment_context;
+	typedef typename alignment_context::bit_vector_type bit_vector;
+	
+	// Same as test_aligner_2_8 but with the samples stored in a file.
+	bit_vector const lhs(10, 0x0);
+	bit_vector rhs(10, 0x0);
+	*rhs.word_begin() = 0x84;
+	auto const directory(make_temporary_directory());
+	
+	{
+		alignment_context ctx;
+		ctx.get_aligner().set_sample_file_directory(directory);
+		run_aligner(ctx, "xaasdxaasd", "xasdxasd", lhs, rhs, 10, 2, 2, -2, -2, -1);
+		BOOST_TEST(ctx.get_aligner().status() == ta::smith_waterman::aligner_base::STATUS_FINISHED);
+	}
+	
+	// The sample files are removed immediately after creating them.
+	BOOST_TEST(0 == ::rmdir(directory.c_str()));
+}
+
+
+BOOST_AUTO_TEST_CASE(test_aligner_encoded_samples)
+{
+	typedef alignment_context_type <std::uint16_t> alignment_context;
+	typedef typename alignment_context::bit_vector_type bit_vector;
+	
+	// Same as test_aligner_2_8 but with the samples stored as differences. With the minimum score,
+	// the samples of the skipped blocks are stored with the reserved code.
+	bit_vector const lhs(10, 0x0);
+	bit_vector rhs(10, 0x0);
+	*rhs.word_begin() = 0x84;
+	for (auto const encoding : {ta::smith_waterman::sample_encoding::DELTA_8, ta::smith_waterman::sample_encoding::DELTA_16})
+	{
+		alignment_context ctx;
+		ctx.get_aligner().set_sample_encoding(encoding);
+		ctx.get_aligner().set_min_score(10);
+		run_aligner(ctx, "xaasdxaasd", "xasdxasd", lhs, rhs, 10, 2, 2, -2, -2, -1);
+		BOOST_TEST(ctx.get_aligner().status() == ta::smith_waterman::aligner_base::STATUS_FINISHED);
+		BOOST_TEST(0 == ctx.get_aligner().escaped_sample_count());
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE(test_aligner_encoded_samples_long_segments)
+{
+	typedef alignment_context_type <std::uint16_t> alignment_context;
+	
+	// With segments longer than the interval of the values stored as is, the differences should
+	// still fit the encoding, also next to the skipped blocks.
+	std::u32string lhs;
+	std::u32string rhs;
+	for (std::size_t i(0); i < 40; ++i)
+	{
+		lhs += U"abcde";
+		rhs += (i % 7 ? U"abcde" : U"abxde");
+		if (0 == i % 11)
+			rhs += U"qq";
+	}
+	
+	auto const align([&lhs, &rhs](alignment_context &ctx, ta::smith_waterman::sample_encoding const encoding, bool const has_min_score, score_type const min_score){
+		auto &aligner(ctx.get_aligner());
+		aligner.set_segment_length(64);
+		aligner.set_identity_score(2);
+		aligner.set_mismatch_penalty(-2);
+		aligner.set_gap_start_penalty(-2);
+		aligner.set_gap_penalty(-1);
+		aligner.set_sample_encoding(encoding);
+		if (has_min_score)
+			aligner.set_min_score(min_score);
+		aligner.align(lhs, rhs);
+		ctx.run();
+		BOOST_TEST(aligner.status() == ta::smith_waterman::aligner_base::STATUS_FINISHED);
+	});
+	
+	alignment_context expected_ctx;
+	align(expected_ctx, ta::smith_waterman::sample_encoding::PLAIN, false, 0);
+	auto const expected_score(expected_ctx.get_aligner().alignment_score());
+	for (auto const encoding : {ta::smith_waterman::sample_encoding::DELTA_8, ta::smith_waterman::sample_encoding::DELTA_16})
+	{
+		for (auto const has_min_score : {false, true})
+		{
+			alignment_context ctx;
+			align(ctx, encoding, has_min_score, expected_score);
+			BOOST_TEST(ctx.get_aligner().alignment_score() == expected_score);
+			BOOST_TEST(ctx.lhs_gaps() == expected_ctx.lhs_gaps());
+			BOOST_TEST(ctx.rhs_gaps() == expected_ctx.rhs_gaps());
+			BOOST_TEST(0 == ctx.get_aligner().escaped_sample_count());
+		}
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE(test_sample_matrix_escaped_values)
+{
+	// The differences that exceed the given bound are stored separately.
+	ta::smith_waterman::detail::sample_matrix <score_type> samples;
+	samples.set_encoding(ta::smith_waterman::sample_encoding::DELTA_8);
+	samples.set_max_step(2);
+	samples.resize(200, 2, 100);
+	samples.fill(0);
+	BOOST_TEST(63 == samples.anchor_interval());
+	
+	std::vector <score_type> expected(200);
+	score_type value(0);
+	for (std::size_t i(0); i < 200; ++i)
+	{
+		value += (0 == i % 50 ? 1000 : (i % 2 ? 2 : -1));
+		expected[i] = value;
+		samples.store(i, 1, value);
+	}
+	
+	BOOST_TEST(0 < samples.escaped_count());
+	for (std::size_t i(0); i < 200; ++i)
+	{
+		BOOST_TEST(0 == samples.load(i, 0));
+		BOOST_TEST(expected[i] == samples.load(i, 1));
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE(test_aligner_2_8_buffered)
+{
+	typedef ta::smith_waterman::buffered_alignment_context <score_type, std::uint16_t, libbio::bit_vector> alignment_context;
+	typedef typename alignment_context::bit_vector_type bit_vector;
+	
+	bit_vector const lhs(10, 0x0);
+	bit_vector rhs(10, 0x0);
+	*rhs.word_begin() = 0x84;
+	alignment_context ctx;
+	run_aligner(ctx, "xaasdxaasd", "xasdxasd", lhs, rhs, 10, 4, 2, -2, -2, -1);
+}
+
+
+BOOST_AUTO_TEST_CASE(test_aligner_2_8_trimmed)
+{
+	typedef alignment_context_type <std::uint16_t> alignment_context;
+	typedef typename alignment_context::bit_vector_type bit_vector;
+	
+	// The texts are reversed, so the common prefix is "dsa" and the common suffix "ax".
+	// The score is the same as without trimming but the gaps are placed differently.
+	bit_vector const lhs(10, 0x0);
+	bit_vector rhs(10, 0x0);
+	*rhs.word_begin() = 0x44;
+	alignment_context ctx;
+	auto &aligner(ctx.get_aligner());
+	aligner.set_trims_common_affixes(true);
+	run_aligner(ctx, "xaasdxaasd", "xasdxasd", lhs, rhs, 10, 4, 2, -2, -2, -1);
+	BOOST_TEST(aligner.trimmed_prefix_length() == 3);
+	BOOST_TEST(aligner.trimmed_suffix_length() == 2);
+}
+
+
+BOOST_AUTO_TEST_CASE(test_aligner_trimmed_trivial)
+{
+	typedef alignment_context_type <std::uint16_t> alignment_context;
+	typedef typename alignment_context::bit_vector_type bit_vector;
+	
+	{
+		bit_vector const lhs(4, 0x0);
+		bit_vector const rhs(4, 0x0);
+		alignment_context ctx;
+		ctx.get_aligner().set_trims_common_affixes(true);
+		run_aligner(ctx, "asdf", "asdf", lhs, rhs, 8, 8, 2, -2, -2, -1);
+	}
+	
+	{
+		// Only a gap remains after trimming.
+		bit_vector const lhs(4, 0x0);
+		bit_vector rhs(4, 0x0);
+		*rhs.word_begin() = 0x1;
+		alignment_context ctx;
+		ctx.get_aligner().set_trims_common_affixes(true);
+		run_aligner(ctx, "xasd", "asd", lhs, rhs, 3, 8, 2, -2, -2, -1);
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE(test_aligner_2_8_flat_graph)
+{
+	typedef alignment_context_type <std::uint16_t> alignment_context;
+	typedef typename alignment_context::bit_vector_type bit_vector;
+	
+	bit_vector const lhs(10, 0x0);
+	bit_vector rhs(10, 0x0);
+	*rhs.word_begin() = 0x84;
+	alignment_context ctx;
+	
+	std::string const lhss("xaasdxaasd");
+	std::string const rhss("xasdxasd");
+	run_aligner(ctx, lhss, rhss, lhs, rhs, 10, 4, 2, -2, -2, -1);
+	
+	ta::flat_alignment_graph_builder builder;
+	builder.build_graph(lhss, rhss, ctx.lhs_gaps(), ctx.rhs_gaps());
+	
+	auto const &segments(builder.segments());
+	BOOST_TEST_REQUIRE(segments.size() == 5);
+	BOOST_TEST((segments[1].type == ta::alignment_graph::node_type::DISTINCT));
+	BOOST_TEST(segments[1].lhs_offset == 2);
+	BOOST_TEST(segments[1].lhs_length == 1);
+	BOOST_TEST(segments[1].rhs_offset == 2);
+	BOOST_TEST(segments[1].rhs_length == 0);
+	BOOST_TEST((segments[4].type == ta::alignment_graph::node_type::COMMON));
+	BOOST_TEST(segments[4].lhs_offset == 8);
+	BOOST_TEST(segments[4].rhs_offset == 6);
+	
+	// The JSON output matches that of the node-based graph.
+	ta::alignment_graph_builder <char32_t> node_builder;
+	node_builder.build_graph(lhss, rhss, ctx.lhs_gaps(), ctx.rhs_gaps());
+	std::ostringstream expected, actual;
+	ta::json::to_json(expected, node_builder.text_segments());
+	ta::json::to_json(actual, segments, lhss, rhss);
+	BOOST_TEST(expected.str() == actual.str());
+	
+	// So does the buffer-based writer.
+	ta::json::writer writer;
+	ta::json::to_json(writer, node_builder.text_segments());
+	BOOST_TEST(expected.str() == writer.buffer());
+}
+
+
+BOOST_AUTO_TEST_CASE(test_aligner_2_8_binary)
+{
+	typedef alignment_context_type <std::uint16_t> alignment_context;
+	typedef typename alignment_context::bit_vector_type bit_vector;
+	
+	bit_vector const lhs(10, 0x0);
+	bit_vector rhs(10, 0x0);
+	*rhs.word_begin() = 0x84;
+	alignment_context ctx;
+	
+	std::string const lhss("xaasdxaasd");
+	std::string const rhss("xasdxasd");
+	run_aligner(ctx, lhss, rhss, lhs, rhs, 10, 4, 2, -2, -2, -1);
+	
+	ta::flat_alignment_graph_builder builder;
+	builder.build_graph(lhss, rhss, ctx.lhs_gaps(), ctx.rhs_gaps());
+	
+	std::int64_t const score(ctx.get_aligner().alignment_score());
+	ta::binary::buffer_type buffer;
+	ta::binary::encode(buffer, ctx.lhs_gaps(), ctx.rhs_gaps(), &score, &builder.segments());
+	
+	ta::binary::alignment_record record;
+	ta::binary::decode(buffer.data(), buffer.size(), record);
+	BOOST_TEST(record.has_score());
+	BOOST_TEST(record.has_graph());
+	BOOST_TEST(record.score == score);
+	
+	bit_vector lhs_gaps, rhs_gaps;
+	record.lhs_gaps.to_bit_vector(lhs_gaps);
+	record.rhs_gaps.to_bit_vector(rhs_gaps);
+	BOOST_TEST((lhs_gaps == lhs));
+	BOOST_TEST((rhs_gaps == rhs));
+	
+	auto const &segments(builder.segments());
+	BOOST_TEST_REQUIRE(record.segments.size() == segments.size());
+	for (std::size_t i(0); i < segments.size(); ++i)
+	{
+		BOOST_TEST((record.segments[i].type == segments[i].type));
+		BOOST_TEST(record.segments[i].lhs_offset == segments[i].lhs_offset);
+		BOOST_TEST(record.segments[i].lhs_length == segments[i].lhs_length);
+		BOOST_TEST(record.segments[i].rhs_offset == segments[i].rhs_offset);
+		BOOST_TEST(record.segments[i].rhs_length == segments[i].rhs_length);
+	}
+	
+	// Truncated input is rejected.
+	BOOST_CHECK_THROW(ta::binary::decode(buffer.data(), buffer.size() - 1, record), std::runtime_error);
+	
+	// So is a segment count whose size in bytes would overflow.
+	{
+		ta::alignment_graph::flat_segment_vector const no_segments;
+		ta::binary::buffer_type hostile;
+		ta::binary::encode(hostile, ctx.lhs_gaps(), ctx.rhs_gaps(), &score, &no_segments);
+		BOOST_TEST_REQUIRE(0 == hostile.back());
+		hostile.pop_back();
+		ta::binary::write_varint(hostile, 0x5555555555555556); // Three times the count is 2 modulo 2^64.
+		hostile.resize(hostile.size() + 2, 0);
+		BOOST_CHECK_THROW(ta::binary::decode(hostile.data(), hostile.size(), record), std::runtime_error);
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE(test_aligner_operations)
+{
+	typedef ta::smith_waterman::operation_alignment_context <score_type, std::uint16_t> alignment_context;
+	
+	alignment_context ctx;
+	auto &aligner(ctx.get_aligner());
+	aligner.set_segment_length(4);
+	aligner.set_identity_score(2);
+	aligner.set_mismatch_penalty(-2);
+	aligner.set_gap_start_penalty(-2);
+	aligner.set_gap_penalty(-1);
+	aligner.set_reverses_texts(true);
+	
+	std::string const lhs("xaasdxbasd");
+	std::string const rhs("xasdxasc");
+	auto const lhsr(ta::make_reversed_code_point_range(ranges::view::reverse(lhs)));
+	auto const rhsr(ta::make_reversed_code_point_range(ranges::view::reverse(rhs)));
+	aligner.align(lhsr, rhsr, copy_distance(lhsr), copy_distance(rhsr));
+	ctx.run();
+	
+	// The texts were reversed, so the runs are in the original order.
+	BOOST_TEST(aligner.alignment_score() == 6);
+	BOOST_TEST(ctx.operations().to_cigar() == "2=1D3=1D2=1X");
+	
+	std::ostringstream os;
+	ta::json::to_json(os, ctx.operations());
+	BOOST_TEST(os.str() == "\"2=1D3=1D2=1X\"");
+	
+	std::vector <std::uint32_t> bam_ops;
+	ctx.operations().to_bam_cigar(bam_ops);
+	BOOST_TEST(bam_ops.size() == 6);
+	BOOST_TEST(bam_ops[0] == (2 << 4 | 7));
+	BOOST_TEST(bam_ops[1] == (1 << 4 | 2));
+	BOOST_TEST(bam_ops[5] == (1 << 4 | 8));
+}
+
+
+BOOST_AUTO_TEST_CASE(test_gap_run_buffer)
+{
+	typedef libbio::bit_vector bit_vector;
+	
+	// Push the runs backwards as the traceback does.
+	ta::gap_run_buffer buffer;
+	buffer.push_back(0, 60);
+	buffer.push_back(1, 3);
+	buffer.push_back(1, 2);
+	buffer.push_back(0, 0);
+	buffer.push_back(0, 2);
+	buffer.push_back(1, 1);
+	buffer.reverse();
+	BOOST_TEST(buffer.size() == 68);
+	BOOST_TEST(buffer.run_count() == 4);
+	
+	bit_vector expected(68, 0x0);
+	auto const words(expected.word_begin());
+	words[0] = 0xf9;
+	words[1] = 0x0;
+	
+	bit_vector dst;
+	buffer.to_bit_vector(dst);
+	BOOST_TEST(dst == expected);
+}
+
+
 BOOST_AUTO_TEST_CASE(test_aligner_2_8_graph)
 {
 	typedef alignment_context_type <std::uint16_t> alignment_context;
@@ -160,3 +717,654 @@ BOOST_AUTO_TEST_CASE(test_aligner_2_8_graph)
 	ta::alignment_graph_builder <char32_t> builder;
 	builder.build_graph(std::string(lhss), std::string(rhss), ctx.lhs_gaps(), ctx.rhs_gaps());
 }
+
+
+BOOST_AUTO_TEST_CASE(test_aligner_async)
+{
+	typedef ta::smith_waterman::async_alignment_context <score_type, std::uint16_t, libbio::bit_vector> alignment_context;
+	typedef typename alignment_context::bit_vector_type bit_vector;
+	
+	bit_vector const expected_lhs(5, 0x0);
+	bit_vector expected_rhs(5, 0x0);
+	*expected_rhs.word_begin() = 0x4;
+	
+	// The IO context is run by the caller instead of the alignment context.
+	boost::asio::io_context io_ctx;
+	alignment_context ctx(io_ctx);
+	auto &aligner(ctx.get_aligner());
+	aligner.set_segment_length(8);
+	aligner.set_identity_score(2);
+	aligner.set_mismatch_penalty(-2);
+	aligner.set_gap_start_penalty(-2);
+	aligner.set_gap_penalty(-1);
+	aligner.set_reverses_texts(true);
+	
+	std::string const lhs("xaasd");
+	std::string const rhs("xasd");
+	auto const lhsr(ta::make_reversed_code_point_range(ranges::view::reverse(lhs)));
+	auto const rhsr(ta::make_reversed_code_point_range(ranges::view::reverse(rhs)));
+	auto const lhs_len(copy_distance(lhsr));
+	auto const rhs_len(copy_distance(rhsr));
+	
+	auto future(ctx.align_async(lhsr, rhsr, lhs_len, rhs_len));
+	io_ctx.run(); // Returns when there is no more work.
+	
+	auto const result(future.get());
+	BOOST_TEST(result.status == ta::smith_waterman::aligner_base::STATUS_FINISHED);
+	BOOST_TEST(result.score == 5);
+	BOOST_TEST(result.lhs_gaps == expected_lhs);
+	BOOST_TEST(result.rhs_gaps == expected_rhs);
+	
+	// The handler need not be copyable.
+	score_type handler_score(0);
+	auto handler_state(std::make_unique <score_type>(0));
+	ctx.align_async(lhsr, rhsr, lhs_len, rhs_len, [&handler_score, state = std::move(handler_state)](auto &&result){
+		*state = result.score;
+		handler_score = *state;
+	});
+	io_ctx.restart();
+	io_ctx.run();
+	BOOST_TEST(handler_score == 5);
+}
+
+
+BOOST_AUTO_TEST_CASE(test_one_to_many_aligner)
+{
+	typedef ta::smith_waterman::one_to_many_aligner <score_type, std::uint16_t, char, one_to_many_delegate> aligner_type;
+	
+	boost::asio::io_context io_ctx;
+	one_to_many_delegate delegate;
+	aligner_type aligner(io_ctx, delegate);
+	aligner.set_identity_score(2);
+	aligner.set_mismatch_penalty(-2);
+	aligner.set_gap_start_penalty(-2);
+	aligner.set_gap_penalty(-1);
+	aligner.set_max_concurrent_alignments(2);
+	aligner.set_min_score(5);
+	aligner.set_query(std::string("xaasdxaasd"));
+	
+	aligner.add_candidate(std::string("xasdxasd"));
+	aligner.add_candidate(std::string("xaasdxaasd"));
+	aligner.align_candidates();
+	io_ctx.run(); // Returns when the candidates added so far have been aligned.
+	BOOST_TEST(!delegate.did_finish);
+	
+	// The q-gram bound of the last candidate is less than the minimum score.
+	aligner.add_candidate(std::string("zz"));
+	aligner.end_candidates();
+	io_ctx.restart();
+	io_ctx.run();
+	
+	BOOST_TEST(delegate.did_finish);
+	BOOST_TEST(aligner.status() == ta::smith_waterman::aligner_base::STATUS_FINISHED);
+	BOOST_TEST(delegate.results.size() == 3);
+	for (std::size_t i(0); i < delegate.results.size(); ++i)
+		BOOST_TEST(delegate.results[i].first == i);
+	
+	BOOST_TEST(delegate.results[0].second.status == ta::smith_waterman::aligner_base::STATUS_FINISHED);
+	BOOST_TEST(delegate.results[0].second.score == 10);
+	BOOST_TEST(delegate.results[1].second.status == ta::smith_waterman::aligner_base::STATUS_FINISHED);
+	BOOST_TEST(delegate.results[1].second.score == 20);
+	BOOST_TEST(delegate.results[2].second.status == ta::smith_waterman::aligner_base::STATUS_BELOW_THRESHOLD);
+}
+
+
+BOOST_AUTO_TEST_CASE(test_all_pairs_aligner)
+{
+	typedef ta::smith_waterman::all_pairs_aligner <score_type, std::uint16_t, char, one_to_many_delegate> aligner_type;
+	
+	auto const path(make_temporary_file());
+	
+	std::vector <std::string> const texts{"xaasdxaasd", "xasdxasd", "zz", "xaasdxaasd"};
+	auto const run_round([&path, &texts](score_type const gap_penalty, std::size_t const expected_stored_pairs){
+		boost::asio::io_context io_ctx;
+		one_to_many_delegate delegate;
+		aligner_type aligner(io_ctx, delegate);
+		aligner.set_identity_score(2);
+		aligner.set_mismatch_penalty(-2);
+		aligner.set_gap_start_penalty(-2);
+		aligner.set_gap_penalty(gap_penalty);
+		aligner.set_max_concurrent_alignments(2);
+		for (auto const &text : texts)
+			aligner.add_text(text);
+		
+		aligner.align(path);
+		io_ctx.run();
+		
+		auto const &score_file(aligner.score_file());
+		BOOST_TEST(delegate.did_finish);
+		BOOST_TEST(aligner.status() == ta::smith_waterman::aligner_base::STATUS_FINISHED);
+		BOOST_TEST(aligner.stored_pair_count() == expected_stored_pairs);
+		BOOST_TEST(score_file.completed_count() == 6);
+		BOOST_TEST(score_file.score(0, 3) == 20);
+		return score_file.score(0, 1);
+	});
+	
+	BOOST_TEST(run_round(-1, 6) == 10);
+	
+	// The second round resumes the completed file.
+	BOOST_TEST(run_round(-1, 0) == 10);
+	
+	// The file made with different parameters is not resumed.
+	BOOST_TEST(run_round(-2, 6) == 8);
+	
+	std::remove(path.c_str());
+}
+
+
+BOOST_AUTO_TEST_CASE(test_progressive_aligner)
+{
+	typedef ta::smith_waterman::all_pairs_aligner <score_type, std::uint16_t, char, one_to_many_delegate> all_pairs_aligner_type;
+	typedef ta::smith_waterman::progressive_aligner <score_type, std::uint16_t, char, one_to_many_delegate> aligner_type;
+	
+	auto const path(make_temporary_file());
+	
+	std::vector <std::string> const texts{"xaasdxaasd", "xasdxasd", "xaasdxaasd", "xaasd"};
+	boost::asio::io_context io_ctx;
+	
+	// Calculate the pairwise scores.
+	one_to_many_delegate all_pairs_delegate;
+	all_pairs_aligner_type all_pairs_aligner(io_ctx, all_pairs_delegate);
+	all_pairs_aligner.set_identity_score(2);
+	all_pairs_aligner.set_mismatch_penalty(-2);
+	all_pairs_aligner.set_gap_start_penalty(-2);
+	all_pairs_aligner.set_gap_penalty(-1);
+	for (auto const &text : texts)
+		all_pairs_aligner.add_text(text);
+	all_pairs_aligner.align(path);
+	io_ctx.run();
+	BOOST_TEST(all_pairs_delegate.did_finish);
+	
+	one_to_many_delegate delegate;
+	aligner_type aligner(io_ctx, delegate);
+	aligner.set_identity_score(2);
+	aligner.set_mismatch_penalty(-2);
+	aligner.set_gap_start_penalty(-2);
+	aligner.set_gap_penalty(-1);
+	aligner.set_max_concurrent_alignments(2);
+	for (auto const &text : texts)
+		aligner.add_text(text);
+	aligner.align(all_pairs_aligner.score_file());
+	io_ctx.restart();
+	io_ctx.run();
+	
+	BOOST_TEST(delegate.did_finish);
+	BOOST_TEST(aligner.status() == ta::smith_waterman::aligner_base::STATUS_FINISHED);
+	
+	// Each row of the alignment consists of its text and gaps.
+	auto const &gaps(aligner.gaps());
+	BOOST_TEST(gaps.size() == texts.size());
+	BOOST_TEST(gaps[0] == gaps[2]);
+	for (std::size_t i(0); i < texts.size(); ++i)
+	{
+		BOOST_TEST(gaps[i].size() == gaps[0].size());
+		std::size_t character_count(0);
+		ta::for_each_bit_run(gaps[i], [&character_count](bool const is_gap, std::size_t const length){
+			if (!is_gap)
+				character_count += length;
+		});
+		BOOST_TEST(character_count == texts[i].size());
+	}
+	
+	// The texts begin with the same character.
+	ta::multiple_alignment_graph_builder <char> builder;
+	builder.build_graph(aligner.texts(), gaps);
+	auto const &segments(builder.text_segments());
+	BOOST_TEST(!segments.empty());
+	BOOST_TEST((segments.front()->type() == ta::alignment_graph::node_type::COMMON));
+	
+	std::remove(path.c_str());
+}
+
+
+BOOST_AUTO_TEST_CASE(test_partial_order_aligner)
+{
+	typedef ta::smith_waterman::partial_order_aligner <score_type, char> aligner_type;
+	typedef ta::alignment_graph::multiple_distinct_node <char> distinct_node_type;
+	
+	aligner_type aligner;
+	aligner.set_identity_score(2);
+	aligner.set_mismatch_penalty(-2);
+	aligner.set_gap_start_penalty(-2);
+	aligner.set_gap_penalty(-1);
+	
+	BOOST_TEST(aligner.add_text(std::string("xaasdxaasd")) == 0);
+	BOOST_TEST(aligner.add_text(std::string("xasdxasd")) == 10);
+	
+	// The third text matches the branches of the first one.
+	BOOST_TEST(aligner.add_text(std::string("xaasdxaasd")) == 20);
+	BOOST_TEST(aligner.text_count() == 3);
+	
+	auto const &segments(aligner.text_segments());
+	BOOST_TEST(segments.size() == 5);
+	BOOST_TEST((segments[0]->type() == ta::alignment_graph::node_type::COMMON));
+	BOOST_TEST((segments[1]->type() == ta::alignment_graph::node_type::MULTIPLE_DISTINCT));
+	
+	auto const &texts(static_cast <distinct_node_type const &>(*segments[1]).texts());
+	BOOST_TEST(texts.size() == 3);
+	BOOST_TEST(texts[0] == texts[2]);
+	BOOST_TEST(texts[1].empty());
+}
+
+
+// Realigning after an edit should give the same result as aligning the edited texts.
+BOOST_AUTO_TEST_CASE(test_aligner_realign)
+{
+	typedef alignment_context_type <std::uint16_t> alignment_context;
+	
+	auto const set_parameters([](auto &aligner){
+		aligner.set_segment_length(2);
+		aligner.set_identity_score(2);
+		aligner.set_mismatch_penalty(-2);
+		aligner.set_gap_start_penalty(-2);
+		aligner.set_gap_penalty(-1);
+	});
+	
+	auto const check_realignment([&set_parameters](alignment_context const &ctx, std::u32string const &lhs, std::u32string const &rhs){
+		alignment_context expected_ctx;
+		set_parameters(expected_ctx.get_aligner());
+		expected_ctx.get_aligner().align(lhs, rhs);
+		expected_ctx.run();
+		
+		BOOST_TEST(ctx.get_aligner().status() == ta::smith_waterman::aligner_base::STATUS_FINISHED);
+		BOOST_TEST(ctx.get_aligner().alignment_score() == expected_ctx.get_aligner().alignment_score());
+		BOOST_TEST(ctx.lhs_gaps() == expected_ctx.lhs_gaps());
+		BOOST_TEST(ctx.rhs_gaps() == expected_ctx.rhs_gaps());
+	});
+	
+	std::u32string lhs(U"xaasdxaasdxaasd");
+	std::u32string rhs(U"xasdxasdxasd");
+	
+	alignment_context ctx;
+	auto &aligner(ctx.get_aligner());
+	set_parameters(aligner);
+	aligner.align(lhs, rhs);
+	ctx.run();
+	BOOST_TEST(aligner.has_retained_samples());
+	
+	{
+		ta::smith_waterman::text_edit edit;
+		edit.position = 10;
+		edit.removed_length = 2;
+		edit.inserted_length = 3;
+		edit.is_lhs = true;
+		lhs.replace(10, 2, U"qqq");
+		
+		ctx.restart();
+		aligner.realign(lhs, rhs, edit);
+		ctx.run();
+		check_realignment(ctx, lhs, rhs);
+	}
+	
+	{
+		ta::smith_waterman::text_edit edit;
+		edit.position = 5;
+		edit.removed_length = 1;
+		edit.is_lhs = false;
+		rhs.erase(5, 1);
+		
+		ctx.restart();
+		aligner.realign(lhs, rhs, edit);
+		ctx.run();
+		check_realignment(ctx, lhs, rhs);
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE(test_aligner_gap_start_records)
+{
+	// The gaps span several blocks in both directions. With the records, the traceback skips
+	// the blocks in which the gap does not start instead of filling them again.
+	std::string const lhs("xasd0123456789abcdefxasd");
+	std::string const rhs("xasdxasd");
+	for (auto const &[first, second] : {std::make_pair(lhs, rhs), std::make_pair(rhs, lhs)})
+	{
+		progress_context expected_ctx;
+		progress_context ctx;
+		for (auto *context : {&expected_ctx, &ctx})
+		{
+			auto &aligner(context->get_aligner());
+			aligner.set_segment_length(2);
+			aligner.set_identity_score(2);
+			aligner.set_mismatch_penalty(-2);
+			aligner.set_gap_start_penalty(-2);
+			aligner.set_gap_penalty(-1);
+			aligner.set_records_gap_starts(context == &ctx);
+			aligner.align(first, second);
+			context->run();
+			BOOST_TEST(aligner.status() == ta::smith_waterman::aligner_base::STATUS_FINISHED);
+		}
+
+		BOOST_TEST(ctx.get_aligner().alignment_score() == expected_ctx.get_aligner().alignment_score());
+		BOOST_TEST(ctx.lhs_gaps == expected_ctx.lhs_gaps);
+		BOOST_TEST(ctx.rhs_gaps == expected_ctx.rhs_gaps);
+		BOOST_TEST(ctx.calculated_scores == expected_ctx.calculated_scores);
+		BOOST_TEST(ctx.recalculated_scores < expected_ctx.recalculated_scores);
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE(test_aligner_threads_odd_segment_length)
+{
+	// With an odd segment length, the block boundaries fall in the middle of the bytes of the traceback
+	// samples, so blocks that may be filled concurrently write to the same bytes without atomic operations.
+	typedef alignment_context_type <std::uint16_t> alignment_context;
+	
+	std::u32string lhs;
+	std::u32string rhs;
+	for (std::size_t i(0); i < 12; ++i)
+	{
+		lhs += U"abcde";
+		rhs += (i % 5 == 2 ? U"abde" : U"abcde");
+		if (1 == i % 4)
+			lhs += U"xy";
+		if (3 == i % 4)
+			rhs += U"qqq";
+	}
+	
+	auto const align([&lhs, &rhs](alignment_context &ctx, std::size_t const segment_length, std::size_t const thread_count){
+		auto &aligner(ctx.get_aligner());
+		aligner.set_segment_length(segment_length);
+		aligner.set_identity_score(2);
+		aligner.set_mismatch_penalty(-2);
+		aligner.set_gap_start_penalty(-2);
+		aligner.set_gap_penalty(-1);
+		aligner.align(lhs, rhs);
+		
+		std::vector <std::thread> threads;
+		for (std::size_t i(1); i < thread_count; ++i)
+			threads.emplace_back([&ctx](){ ctx.run(); });
+		ctx.run();
+		for (auto &thread : threads)
+			thread.join();
+		
+		BOOST_TEST(aligner.status() == ta::smith_waterman::aligner_base::STATUS_FINISHED);
+	});
+	
+	// Compare to one block.
+	alignment_context expected_ctx;
+	align(expected_ctx, 128, 1);
+	BOOST_TEST(expected_ctx.lhs_gaps().size() == expected_ctx.rhs_gaps().size());
+	BOOST_TEST(0 < expected_ctx.lhs_gaps().size());
+	
+	// Repeat to have the blocks finish in different orders.
+	for (std::size_t i(0); i < 20; ++i)
+	{
+		alignment_context ctx(4);
+		align(ctx, 3, 4);
+		BOOST_TEST(ctx.get_aligner().alignment_score() == expected_ctx.get_aligner().alignment_score());
+		BOOST_TEST(ctx.lhs_gaps() == expected_ctx.lhs_gaps());
+		BOOST_TEST(ctx.rhs_gaps() == expected_ctx.rhs_gaps());
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE(test_piecewise_aligner_anchored)
+{
+	typedef ta::smith_waterman::piecewise_aligner <score_type, std::uint16_t, char32_t, piecewise_delegate> aligner_type;
+	
+	// Non-repetitive text with one substitution in the middle.
+	std::u32string lhs;
+	std::uint32_t state(1);
+	for (std::size_t i(0); i < 200; ++i)
+	{
+		state = 1664525 * state + 1013904223;
+		lhs.push_back(U'a' + (state >> 24) % 26);
+	}
+	std::u32string rhs(lhs);
+	rhs[100] = (U'a' == lhs[100] ? U'b' : U'a');
+	
+	boost::asio::io_context io_ctx;
+	piecewise_delegate delegate;
+	aligner_type aligner(io_ctx, delegate);
+	aligner.set_identity_score(2);
+	aligner.set_mismatch_penalty(-2);
+	aligner.set_gap_start_penalty(-2);
+	aligner.set_gap_penalty(-1);
+	aligner.set_max_concurrent_alignments(2);
+	
+	ta::anchor_parameters parameters;
+	parameters.kmer_length = 8;
+	parameters.window_length = 4;
+	aligner.align_anchored(lhs, rhs, parameters);
+	io_ctx.run();
+	
+	BOOST_TEST(delegate.did_finish);
+	BOOST_TEST(aligner.status() == ta::smith_waterman::aligner_base::STATUS_FINISHED);
+	BOOST_TEST(aligner.alignment_score() == 2 * 199 - 2);
+	BOOST_TEST(delegate.lhs_gaps == libbio::bit_vector(200, 0x0));
+	BOOST_TEST(delegate.rhs_gaps == libbio::bit_vector(200, 0x0));
+	
+	auto const &pieces(aligner.pieces());
+	BOOST_TEST_REQUIRE(pieces.size() == 3);
+	BOOST_TEST(pieces[0].is_common);
+	BOOST_TEST(pieces[0].lhs_length == 100);
+	BOOST_TEST(!pieces[1].is_common);
+	BOOST_TEST(pieces[1].lhs_offset == 100);
+	BOOST_TEST(pieces[1].lhs_length == 1);
+	BOOST_TEST(pieces[2].is_common);
+	BOOST_TEST(pieces[2].lhs_length == 99);
+}
+
+
+BOOST_AUTO_TEST_CASE(test_piecewise_aligner_lines)
+{
+	typedef ta::smith_waterman::piecewise_aligner <score_type, std::uint16_t, char32_t, piecewise_delegate> aligner_type;
+	
+	std::u32string const lhs(U"abc\ndef\nghi\n");
+	std::u32string const rhs(U"abc\ndxf\nghi\n");
+	
+	boost::asio::io_context io_ctx;
+	piecewise_delegate delegate;
+	aligner_type aligner(io_ctx, delegate);
+	aligner.set_identity_score(2);
+	aligner.set_mismatch_penalty(-2);
+	aligner.set_gap_start_penalty(-2);
+	aligner.set_gap_penalty(-1);
+	aligner.align_lines(lhs, rhs);
+	io_ctx.run();
+	
+	BOOST_TEST(delegate.did_finish);
+	BOOST_TEST(aligner.status() == ta::smith_waterman::aligner_base::STATUS_FINISHED);
+	BOOST_TEST(aligner.alignment_score() == 2 * 11 - 2);
+	BOOST_TEST(delegate.lhs_gaps == libbio::bit_vector(12, 0x0));
+	BOOST_TEST(delegate.rhs_gaps == libbio::bit_vector(12, 0x0));
+	
+	// Only the second line is aligned character by character.
+	auto const &pieces(aligner.pieces());
+	BOOST_TEST_REQUIRE(pieces.size() == 3);
+	BOOST_TEST(pieces[0].is_common);
+	BOOST_TEST(!pieces[1].is_common);
+	BOOST_TEST(pieces[1].lhs_offset == 4);
+	BOOST_TEST(pieces[1].lhs_length == 4);
+	BOOST_TEST(pieces[2].is_common);
+}
+
+
+BOOST_AUTO_TEST_CASE(test_piecewise_aligner_words)
+{
+	typedef ta::smith_waterman::piecewise_aligner <score_type, std::uint16_t, char32_t, piecewise_delegate> aligner_type;
+	
+	std::u32string const lhs(U"the quick brown fox");
+	std::u32string const rhs(U"the quack brown fox");
+	
+	boost::asio::io_context io_ctx;
+	piecewise_delegate delegate;
+	aligner_type aligner(io_ctx, delegate);
+	aligner.set_identity_score(2);
+	aligner.set_mismatch_penalty(-2);
+	aligner.set_gap_start_penalty(-2);
+	aligner.set_gap_penalty(-1);
+	
+	aligner.align_words(lhs, rhs);
+	io_ctx.run();
+	
+	BOOST_TEST(aligner.status() == ta::smith_waterman::aligner_base::STATUS_FINISHED);
+	BOOST_TEST(aligner.alignment_score() == 2 * 18 - 2);
+	BOOST_TEST(delegate.lhs_gaps == libbio::bit_vector(19, 0x0));
+	BOOST_TEST(delegate.rhs_gaps == libbio::bit_vector(19, 0x0));
+	BOOST_TEST_REQUIRE(aligner.pieces().size() == 3);
+	
+	// Replace the distinct words without aligning them.
+	libbio::bit_vector expected_lhs(24, 0x0);
+	libbio::bit_vector expected_rhs(24, 0x0);
+	*expected_lhs.word_begin() = 0x3e00;
+	*expected_rhs.word_begin() = 0x1f0;
+	
+	aligner.set_refines_tokens(false);
+	aligner.align_words(lhs, rhs);
+	io_ctx.restart();
+	io_ctx.run();
+	
+	BOOST_TEST(aligner.status() == ta::smith_waterman::aligner_base::STATUS_FINISHED);
+	BOOST_TEST(aligner.alignment_score() == 2 * 14 - 2 * 2 - 10);
+	BOOST_TEST(delegate.lhs_gaps == expected_lhs);
+	BOOST_TEST(delegate.rhs_gaps == expected_rhs);
+	
+	// The flag does not affect the other modes.
+	aligner.set_refines_tokens(true);
+	aligner.align_lines(lhs, rhs);
+	io_ctx.restart();
+	io_ctx.run();
+	auto const line_score(aligner.alignment_score());
+	auto const line_lhs_gaps(delegate.lhs_gaps);
+	auto const line_rhs_gaps(delegate.rhs_gaps);
+	
+	aligner.set_refines_tokens(false);
+	aligner.align_lines(lhs, rhs);
+	io_ctx.restart();
+	io_ctx.run();
+	BOOST_TEST(aligner.alignment_score() == line_score);
+	BOOST_TEST(delegate.lhs_gaps == line_lhs_gaps);
+	BOOST_TEST(delegate.rhs_gaps == line_rhs_gaps);
+}
+
+
+BOOST_AUTO_TEST_CASE(test_aligner_cancel)
+{
+	typedef ta::smith_waterman::async_alignment_context <score_type, std::uint16_t, libbio::bit_vector> alignment_context;
+	
+	boost::asio::io_context io_ctx;
+	alignment_context ctx(io_ctx);
+	auto &aligner(ctx.get_aligner());
+	aligner.set_segment_length(2);
+	aligner.set_identity_score(2);
+	aligner.set_mismatch_penalty(-2);
+	aligner.set_gap_start_penalty(-2);
+	aligner.set_gap_penalty(-1);
+	aligner.set_reverses_texts(true);
+	
+	// Cancel before starting; the first block should not post any others.
+	ta::cancellation_token token;
+	aligner.set_cancellation_token(token);
+	token.cancel();
+	
+	std::string const lhs("xaasd");
+	std::string const rhs("xasd");
+	auto const lhsr(ta::make_reversed_code_point_range(ranges::view::reverse(lhs)));
+	auto const rhsr(ta::make_reversed_code_point_range(ranges::view::reverse(rhs)));
+	auto const lhs_len(copy_distance(lhsr));
+	auto const rhs_len(copy_distance(rhsr));
+	
+	auto future(ctx.align_async(lhsr, rhsr, lhs_len, rhs_len));
+	io_ctx.run();
+	
+	{
+		auto const result(future.get());
+		BOOST_TEST(result.status == ta::smith_waterman::aligner_base::STATUS_CANCELLED);
+		BOOST_TEST(result.lhs_gaps.size() == 0);
+		BOOST_TEST(result.rhs_gaps.size() == 0);
+	}
+	
+	// A deadline that has passed stops the alignment in the same way.
+	aligner.set_cancellation_token(ta::cancellation_token());
+	aligner.set_deadline(alignment_context::aligner_type::clock_type::now() - std::chrono::seconds(1));
+	future = ctx.align_async(lhsr, rhsr, lhs_len, rhs_len);
+	io_ctx.restart();
+	io_ctx.run();
+	BOOST_TEST(future.get().status == ta::smith_waterman::aligner_base::STATUS_CANCELLED);
+	
+	// cancel() only affects the alignment in progress.
+	aligner.clear_deadline();
+	aligner.cancel();
+	future = ctx.align_async(lhsr, rhsr, lhs_len, rhs_len);
+	io_ctx.restart();
+	io_ctx.run();
+	{
+		auto const result(future.get());
+		BOOST_TEST(result.status == ta::smith_waterman::aligner_base::STATUS_FINISHED);
+		BOOST_TEST(result.score == 5);
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE(test_aligner_progress)
+{
+	progress_context ctx;
+	auto &aligner(ctx.get_aligner());
+	aligner.set_segment_length(2);
+	aligner.set_identity_score(2);
+	aligner.set_mismatch_penalty(-2);
+	aligner.set_gap_start_penalty(-2);
+	aligner.set_gap_penalty(-1);
+	aligner.set_reverses_texts(true);
+	
+	std::string const lhs("xaasd");
+	std::string const rhs("xasd");
+	auto const lhsr(ta::make_reversed_code_point_range(ranges::view::reverse(lhs)));
+	auto const rhsr(ta::make_reversed_code_point_range(ranges::view::reverse(rhs)));
+	aligner.align(lhsr, rhsr, copy_distance(lhsr), copy_distance(rhsr));
+	ctx.run();
+	
+	// One report per block; the IO context is run by one thread.
+	BOOST_TEST_REQUIRE(!ctx.block_progress.empty());
+	auto const total_blocks(ctx.block_progress.front().second);
+	BOOST_TEST(ctx.block_progress.size() == total_blocks);
+	for (std::size_t i(0); i < ctx.block_progress.size(); ++i)
+		BOOST_TEST(ctx.block_progress[i].first == 1 + i);
+	
+	// Traceback progress is monotonic and ends with completion.
+	BOOST_TEST_REQUIRE(!ctx.traceback_progress.empty());
+	for (std::size_t i(1); i < ctx.traceback_progress.size(); ++i)
+		BOOST_TEST(ctx.traceback_progress[i - 1].first <= ctx.traceback_progress[i].first);
+	BOOST_TEST(ctx.traceback_progress.back().first == 9);
+	BOOST_TEST(ctx.traceback_progress.back().second == 9);
+}
+
+
+BOOST_AUTO_TEST_CASE(test_gap_runs)
+{
+	typedef libbio::bit_vector bit_vector;
+	
+	// Runs that cross a word boundary.
+	bit_vector lhs_gaps(130, 0x0);
+	bit_vector rhs_gaps(130, 0x0);
+	auto const lhs_words(lhs_gaps.word_begin());
+	auto const rhs_words(rhs_gaps.word_begin());
+	lhs_words[0] = 0xc000000000000000;
+	lhs_words[1] = 0x1;
+	rhs_words[1] = 0x6;
+	
+	std::vector <std::pair <ta::gap_run_type, std::size_t>> runs;
+	ta::for_each_gap_run(lhs_gaps, rhs_gaps, [&runs](ta::gap_run_type const run_type, std::size_t const length){
+		runs.emplace_back(run_type, length);
+	});
+	
+	BOOST_TEST_REQUIRE(runs.size() == 4);
+	BOOST_TEST((runs[0] == std::make_pair(ta::gap_run_type::NONE, std::size_t(62))));
+	BOOST_TEST((runs[1] == std::make_pair(ta::gap_run_type::LHS, std::size_t(3))));
+	BOOST_TEST((runs[2] == std::make_pair(ta::gap_run_type::RHS, std::size_t(2))));
+	BOOST_TEST((runs[3] == std::make_pair(ta::gap_run_type::NONE, std::size_t(63))));
+}
+
+
+BOOST_AUTO_TEST_CASE(test_json_writer)
+{
+	ta::json::writer writer;
+	writer.write_string(std::string("long enough to be scanned in blocks \"quoted\"\\\n\x01"));
+	writer.put(' ');
+	writer.write_string(std::u32string(U"a\u00e4\u20ac\U0001f600\""));
+	writer.put(' ');
+	writer.write_integer(-1234567);
+	BOOST_TEST(writer.buffer() == "\"long enough to be scanned in blocks \\\"quoted\\\"\\\\\\n\\u0001\" \"a\xc3\xa4\xe2\x82\xac\xf0\x9f\x98\x80\\\"\" -1234567");
+}
@@ -3,6 +3,7 @@
 
 from flask import Flask, request, jsonify, abort
 import json
+import os
 import re
 from werkzeug.exceptions import HTTPException
 
@@ -12,6 +13,9 @@ import text_align
 
 
 app = Flask(__name__, static_folder = 'site', static_url_path = '')
+# Milliseconds, zero for none. When set, the alignments that do not finish in time are
+# cancelled and reported with status 503.
+alignment_timeout = int(os.environ.get('ALIGNMENT_TIMEOUT_MS', '0'))
 
 
 def abort_on_exception(code, message):
@@ -82,6 +86,11 @@ def custom400(error):
 	return json.dumps(error.description), 400, {'Content-Type': 'application/json'}
 
 
+@app.errorhandler(503)
+def custom503(error):
+	return json.dumps(error.description), 503, {'Content-Type': 'application/json'}
+
+
 @app.route('/')
 def root():
 	return app.send_static_file('index.html')
@@ -92,6 +101,7 @@ def align():
 	# Convert the files’ contents to Unicode strings.
 	try:
 		ctx = text_align.SmithWatermanAligner()
+		ctx.timeout = alignment_timeout
 		shouldCreateAlignmentGraph = processAlignerInput(request, ctx)
 		
 		# Run the aligner.
@@ -115,6 +125,9 @@ def align():
 	except HTTPException as error:
 		# abort() already called.
 		raise error
+	
+	except text_align.AlignmentCancelledError as error:
+		abort_with_message(503, "Alignment did not finish in %d ms" % alignment_timeout)
 		
 	except Exception as error:
 		abort_on_exception(400, str(error))